@@ -214,7 +214,7 @@ template <class T>
 void debugPrintList(ASTList<T> const &list, char const *name,
                     std::ostream &os, int indent)
 {
-  os << fmt::format("{: {}}:\n", name, indent);
+  ind(os, indent) << name << ":\n";
   int ct=0;
   {
     FOREACH_ASTLIST(T, list, iter) {
@@ -238,7 +238,7 @@ template <class T>
 void debugPrintFakeList(FakeList<T> const *list, char const *name,
                         std::ostream &os, int indent)
 {
-  os << fmt::format("{: {}}:\n", name, indent);
+  ind(os, indent) << name << ":\n";
   int ct=0;
   {
     FAKELIST_FOREACH(T, list, iter) {
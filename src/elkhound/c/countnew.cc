@@ -0,0 +1,31 @@
+// countnew.cc            see license.txt for copyright and terms of use
+// code for countnew.h
+
+#include "countnew.h"     // this module
+
+#include <new>            // std::bad_alloc
+#include <stdlib.h>       // malloc, free
+
+
+// per thread, so concurrent parsers don't contend for it
+static thread_local long numAllocations = 0;
+
+long threadAllocations()
+{
+  return numAllocations;
+}
+
+
+void *operator new(size_t size)
+{
+  numAllocations++;
+  if (void *p = malloc(size? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
@@ -0,0 +1,14 @@
+// countnew.h            see license.txt for copyright and terms of use
+// an operator new that counts the allocations each thread makes
+
+// replacing operator new affects the whole program, so countnew.cc
+// is compiled only into the benchmark programs (cparsemt and cc2mt),
+// never into a library
+
+#ifndef COUNTNEW_H
+#define COUNTNEW_H
+
+// number of trips the calling thread has made to operator new
+long threadAllocations();
+
+#endif // COUNTNEW_H
@@ -5,6 +5,7 @@
 #include "macros.h"       // TABLESIZE
 #include "trace.h"        // tracing stuff
 #include "strutil.h"      // encodeWithEscapes
+#include "xassert.h"      // xassertdb
 
 #include <stdio.h>        // printf
 #include <assert.h>       // assert
@@ -15,9 +16,21 @@
 Lexer1Token::Lexer1Token(Lexer1TokenType aType, char const *aText,
                	         int aLength, SourceLoc aLoc)
   : type(aType),
-    text(aText, aLength),           // makes a copy
+    text(),                         // set below, to the copy
     length(aLength),
-    loc(aLoc)
+    loc(aLoc),
+    copy(aText, aLength)
+{
+  text = copy;
+}
+
+Lexer1Token::Lexer1Token(Lexer1TokenType aType, string_view aText,
+                         SourceLoc aLoc)
+  : type(aType),
+    text(aText),                    // no copy
+    length(aText.length()),
+    loc(aLoc),
+    copy()
 {}
 
 Lexer1Token::~Lexer1Token()
@@ -55,7 +68,7 @@ void Lexer1Token::print() const
 
   printf("[L1] Token at line %d, col %d: %s \"%s\"\n",
          line, col, l1Tok2String(type),
-         encodeWithEscapes(string_view(text).substr(0, length)).c_str());
+         encodeWithEscapes(text.substr(0, length)).c_str());
 }
 
 
@@ -63,7 +76,10 @@ void Lexer1Token::print() const
 Lexer1::Lexer1(char const *fname)
   : allowMultilineStrings(true),    // GNU extension
     loc(SourceLocManager::instance()->encodeBegin(fname)),
-    errors(0)
+    errors(0),
+    mapped(false),
+    input(),
+    offset(0)
 {}
 
 Lexer1::~Lexer1()
@@ -95,7 +111,17 @@ void Lexer1::emit(Lexer1TokenType toktype, char const *tokenText, int length)
 {
   // construct object to represent this token
   // at the end of our running list of tokens
-  tokens.emplace_back(toktype, tokenText, length, loc);
+  if (mapped) {
+    // every byte of the input is in some token, in order, so the
+    // token is at 'offset'
+    string_view text = input.substr(offset, length);
+    xassertdb(text == string_view(tokenText, length));
+    tokens.emplace_back(toktype, text, loc);
+    offset += length;
+  }
+  else {
+    tokens.emplace_back(toktype, tokenText, length, loc);
+  }
 
   // (debugging) print it
   if (tracingSys("lexer1")) {
@@ -31,15 +31,27 @@ enum Lexer1TokenType {
 class Lexer1Token {
 public:
   Lexer1TokenType type;         // kind of token
-  string text;                  // token's text, null-terminated
+  string_view text;             // token's text, in 'copy' or the mapped input
   int length;                   // length of text (somewhat redundant, but whatever)
   SourceLoc loc;                // location in input stream
 
+private:
+  string copy;                  // the text, unless the input was mapped
+
 public:
+  // copy the text
   Lexer1Token(Lexer1TokenType aType, char const *aText, int aLength,
               SourceLoc aLoc);
+
+  // refer to the text, which is in the mapped input
+  Lexer1Token(Lexer1TokenType aType, string_view aText, SourceLoc aLoc);
+
   ~Lexer1Token();
 
+  // 'text' may point into 'copy'
+  Lexer1Token(Lexer1Token const &) = delete;
+  Lexer1Token &operator=(Lexer1Token const &) = delete;
+
   // debugging
   void print() const;
 };
@@ -55,6 +67,14 @@ public:
   SourceLoc loc;                          // current location
   int errors;	                          // # of errors encountered so far
 
+  // when the input is a mapped file (see the string_view
+  // 'lexer1_lex'), the whole of it, and the offset in it of the next
+  // token; the tokens' text then points into it rather than being
+  // copied, so it must outlive them
+  bool mapped;
+  string_view input;
+  size_t offset;
+
   // lexing results
   std::deque<Lexer1Token> tokens;         // list of tokens produced
 
@@ -75,6 +95,20 @@ private:
 // stream into 'lexer' object
 int lexer1_lex(Lexer1 &lexer, FILE *inputFile);
 
+// the same, reading 'input', which is typically a MappedFile's text;
+// the tokens' text then points into 'input' (see Lexer1::mapped)
+int lexer1_lex(Lexer1 &lexer, string_view input);
+
+// incremental interface: after 'lexer1_beginStream', each call to
+// 'lexer1_lexMore' appends at least one token to 'lexer.tokens', or
+// returns false at the end of the input; the consumer may remove
+// tokens from the front as it goes.  The scanner's state is global
+// (it's flex), so only one stream can be read at a time, and
+// 'lexer1_lex' ends it.
+void lexer1_beginStream(Lexer1 &lexer, FILE *inputFile);
+void lexer1_beginStream(Lexer1 &lexer, string_view input);
+bool lexer1_lexMore(Lexer1 &lexer);
+
 
 // utilites
 void printEscaped(char const *p, int len);
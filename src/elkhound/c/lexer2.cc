@@ -6,9 +6,11 @@
 #include "strutil.h"     // encodeWithEscapes
 #include "exc.h"         // xformat
 #include "cc_lang.h"     // CCLang
-#include "glrconfig.h"   // SOURCELOC
 
 #include <stdlib.h>      // strtoul
+#include <string.h>      // memcpy
+#include <stdio.h>       // printf
+#include <algorithm>     // std::min
 
 // ------------------ token type descriptions ----------------------
 struct Lexer2TokenTypeDesc
@@ -255,7 +257,9 @@ KeywordMap c_KeywordMap[] = {
 };
 
 
-Lexer2TokenType lookupKeyword(CCLang &lang, rostring keyword)
+// classify by scanning the tables; Lexer2::classify gives the same
+// answers by one hash lookup on the interned spelling
+static Lexer2TokenType lookupKeyword(CCLang &lang, string_view keyword)
 {
   // works?
   static_assert(TABLESIZE(l2TokTypes) == L2_NUM_TYPES,
@@ -434,6 +438,31 @@ void Lexer2Token::print() const
 }
 
 
+// a null-terminated copy of a token's text, for strtoul and atof; on
+// the stack, since numeric literals are short
+class TerminatedText {
+  char buf[64];
+  string big;                  // if it didn't fit
+  char const *str;
+
+public:
+  explicit TerminatedText(string_view text)
+  {
+    if (text.length() < sizeof(buf)) {
+      memcpy(buf, text.data(), text.length());
+      buf[text.length()] = 0;
+      str = buf;
+    }
+    else {
+      big = string(text);
+      str = big.c_str();
+    }
+  }
+
+  char const *c_str() const { return str; }
+};
+
+
 static string quotedUnescape(string_view src, char delim, bool allowNewlines)
 {
   // strip quotes or ticks
@@ -451,137 +480,166 @@ static string quotedUnescape(string_view src, char delim, bool allowNewlines)
 void lexer2_lex(Lexer2 &dest, Lexer1 const &src, char const *fname)
 {
   (void)fname;
+  dest.beginLexing();
+
+  // iterate over all the L1 tokens
+  for (Lexer1Token const &L1 : src.tokens) {
+    dest.lexToken(L1, src.allowMultilineStrings);
+  }
+
+  // final token
+  dest.addEOFToken();
+}
+
+
+void Lexer2::beginLexing()
+{
   // keep track of previous L2 token emitted so we can do token
   // collapsing for string juxtaposition
-  Lexer2Token *prevToken = NULL;
+  prevToken = NULL;
 
   #ifndef USE_RECLASSIFY
     #define USE_RECLASSIFY 1    // if nobody tells me, it's probably enabled
   #endif
-  bool const yieldVarName = !USE_RECLASSIFY || tracingSys("yieldVariableName");
-  bool const debugLexer2 = tracingSys("lexer2");
+  yieldVarName = !USE_RECLASSIFY || tracingSys("yieldVariableName");
+  debugLexer2 = tracingSys("lexer2");
+  prepareKeywords();
+}
 
-  // iterate over all the L1 tokens
-  for (auto const& L1ref : src.tokens) {
-    // convenient renaming
-    Lexer1Token const * const L1 = &L1ref;
-
-    if (L1->type == L1_PREPROCESSOR ||     // for now
-        L1->type == L1_WHITESPACE   ||
-        L1->type == L1_COMMENT      ||
-        L1->type == L1_ILLEGAL) {
-      continue;    // filter it out entirely
-    }
 
-    if (L1->type == L1_STRING_LITERAL         &&
-        prevToken != NULL                     &&
-        prevToken->type == L2_STRING_LITERAL) {
-      // coalesce adjacent strings (this is not efficient code..)
-      stringBuilder sb;
-      sb << prevToken->strValue;
+void Lexer2::lexToken(Lexer1Token const &L1ref, bool allowMultilineStrings)
+{
+  // convenient renaming
+  Lexer1Token const * const L1 = &L1ref;
+
+  if (L1->type == L1_PREPROCESSOR ||     // for now
+      L1->type == L1_WHITESPACE   ||
+      L1->type == L1_COMMENT      ||
+      L1->type == L1_ILLEGAL) {
+    return;    // filter it out entirely
+  }
+
+  if (L1->type == L1_STRING_LITERAL         &&
+      prevToken != NULL                     &&
+      prevToken->type == L2_STRING_LITERAL) {
+    // coalesce adjacent strings (this is not efficient code..)
+    stringBuilder sb;
+    sb << prevToken->strValue;
 
-      string tmp = quotedUnescape(L1->text, '"', src.allowMultilineStrings);
-      sb.append(tmp);
+    string tmp = quotedUnescape(L1->text, '"', allowMultilineStrings);
+    sb.append(tmp);
 
-      prevToken->strValue = dest.idTable.add(sb);
-      continue;
-    }
+    prevToken->strValue = idTable.add(sb);
+    return;
+  }
 
-    // create the object for the yielded token; don't know the type
-    // yet at this point, so I use L2_NAME as a placeholder
-    Lexer2Token *L2 = dest.addToken(L2_NAME, L1->loc);
+  // create the object for the yielded token; don't know the type
+  // yet at this point, so I use L2_NAME as a placeholder
+  Lexer2Token *L2 = addToken(L2_NAME, L1->loc);
 
-    try {
-      switch (L1->type) {
-        case L1_IDENTIFIER:
+  try {
+    switch (L1->type) {
+      case L1_IDENTIFIER:
+        if (scanKeywords) {
           // get either keyword's type, or L2_NAME
-          L2->type = lookupKeyword(dest.lang, L1->text);
+          L2->type = lookupKeyword(lang, L1->text);
           if (L2->type == L2_NAME) {
             // save name's text
-            L2->strValue = dest.idTable.add(L1->text.c_str());
+            L2->strValue = idTable.add(L1->text);
           }
-          break;
-
-        case L1_INT_LITERAL:
-          L2->type = L2_INT_LITERAL;
-          L2->intValue = strtoul(L1->text.c_str(), NULL /*endptr*/, 0 /*radix*/);
-          break;
+        }
+        else {
+          // the keywords are in the table too, so interning the
+          // name first costs nothing, and makes classifying it a
+          // pointer lookup; only identifiers and $qualifiers go into
+          // the table straight from the L1 token's text
+          StringRef name = idTable.add(L1->text);
+          L2->type = classify(name);
+          if (L2->type == L2_NAME) {
+            L2->strValue = name;
+          }
+        }
+        break;
 
-        case L1_FLOAT_LITERAL:
-          L2->type = L2_FLOAT_LITERAL;
-          L2->floatValue = new float(atof(L1->text.c_str()));
-          break;
+      case L1_INT_LITERAL:
+        L2->type = L2_INT_LITERAL;
+        L2->intValue = strtoul(TerminatedText(L1->text).c_str(),
+                               NULL /*endptr*/, 0 /*radix*/);
+        break;
 
-        case L1_STRING_LITERAL: {
-          L2->type = L2_STRING_LITERAL;
+      case L1_FLOAT_LITERAL:
+        L2->type = L2_FLOAT_LITERAL;
+        L2->floatValue = new float(atof(TerminatedText(L1->text).c_str()));
+        break;
 
-          char const *srcText = L1->text.c_str();
-          if (*srcText == 'L') srcText++;
+      case L1_STRING_LITERAL: {
+        L2->type = L2_STRING_LITERAL;
 
-          string tmp = quotedUnescape(srcText, '"', src.allowMultilineStrings);
+        string_view srcText = L1->text;
+        if (srcText[0] == 'L') srcText.remove_prefix(1);
 
-          if (tmp.find('\0') != string::npos) {
-            std::cout << "warning: literal string with embedded nulls not handled properly\n";
-          }
+        string tmp = quotedUnescape(srcText, '"', allowMultilineStrings);
 
-          L2->strValue = dest.idTable.add(tmp);
-          break;
+        if (tmp.find('\0') != string::npos) {
+          std::cout << "warning: literal string with embedded nulls not handled properly\n";
         }
 
-        case L1_UDEF_QUAL: {
-          L2->type = L2_UDEF_QUAL;
-          L2->strValue = dest.idTable.add(L1->text.c_str());
-          break;
-        }
+        L2->strValue = idTable.add(tmp);
+        break;
+      }
 
-        case L1_CHAR_LITERAL: {
-          L2->type = L2_CHAR_LITERAL;
+      case L1_UDEF_QUAL: {
+        L2->type = L2_UDEF_QUAL;
+        L2->strValue = idTable.add(L1->text);
+        break;
+      }
 
-          char const *srcText = L1->text.c_str();
-          if (*srcText == 'L') srcText++;
+      case L1_CHAR_LITERAL: {
+        L2->type = L2_CHAR_LITERAL;
 
-          string tmp = quotedUnescape(srcText, '\'', false /*allowNewlines*/);
+        string_view srcText = L1->text;
+        if (srcText[0] == 'L') srcText.remove_prefix(1);
 
-          if (tmp.length() != 1) {
-            xformat("character literal must have 1 char");
-          }
+        string tmp = quotedUnescape(srcText, '\'', false /*allowNewlines*/);
 
-          L2->charValue = tmp[0];
-          break;
+        if (tmp.length() != 1) {
+          xformat("character literal must have 1 char");
         }
 
-        case L1_OPERATOR:
-          L2->type = lookupKeyword(dest.lang, L1->text);      // operator's type
-          xassert(L2->type != L2_NAME);            // otherwise invalid operator text..
-          break;
-
-        default:
-          xfailure("unknown L1 type");
+        L2->charValue = tmp[0];
+        break;
       }
-    }
-    catch (xFormat &x) {
-      std::cout << toString(L1->loc) << ": " << x.cond() << std::endl;
-      continue;
-    }
 
-    // for testing the performance of the C parser against Bison, I
-    // want to disable the reclassifier, so I need to yield
-    // L2_VARIABLE_NAME directly
-    if (yieldVarName && (L2->type == L2_NAME)) {
-      L2->type = L2_VARIABLE_NAME;
-    }
-
-    // append this token to the running list
-    prevToken = L2;
+      case L1_OPERATOR:
+        L2->type = scanKeywords?                   // operator's type
+          lookupKeyword(lang, L1->text) :
+          classify(idTable.get(L1->text));         // spellings are all there
+        xassert(L2->type != L2_NAME);            // otherwise invalid operator text..
+        break;
 
-    // (debugging) print it
-    if (debugLexer2) {
-      L2->print();
+      default:
+        xfailure("unknown L1 type");
     }
   }
+  catch (xFormat &x) {
+    std::cout << toString(L1->loc) << ": " << x.cond() << std::endl;
+    return;
+  }
 
-  // final token
-  dest.addEOFToken();
+  // for testing the performance of the C parser against Bison, I
+  // want to disable the reclassifier, so I need to yield
+  // L2_VARIABLE_NAME directly
+  if (yieldVarName && (L2->type == L2_NAME)) {
+    L2->type = L2_VARIABLE_NAME;
+  }
+
+  // append this token to the running list
+  prevToken = L2;
+
+  // (debugging) print it
+  if (debugLexer2) {
+    L2->print();
+  }
 }
 
 
@@ -590,7 +648,16 @@ Lexer2::Lexer2(CCLang &L)
   : myIdTable(new StringTable()),
     lang(L),
     idTable(*myIdTable),      // hope this works..
-    currentToken(tokens.end())
+    batchSize(MAX_BATCH),
+    sourceErrors(0),
+    scanKeywords(false),
+    keywordsForCpp(false),
+    batchStart(0),
+    prevToken(NULL),
+    yieldVarName(false),
+    debugLexer2(false),
+    source(NULL),
+    tokensDropped(0)
 {
   init();
 }
@@ -599,7 +666,16 @@ Lexer2::Lexer2(CCLang &L, StringTable &extTable)
   : myIdTable(NULL),
     lang(L),
     idTable(extTable),
-    currentToken(tokens.end())
+    batchSize(MAX_BATCH),
+    sourceErrors(0),
+    scanKeywords(false),
+    keywordsForCpp(false),
+    batchStart(0),
+    prevToken(NULL),
+    yieldVarName(false),
+    debugLexer2(false),
+    source(NULL),
+    tokensDropped(0)
 {
   init();
 }
@@ -621,6 +697,34 @@ Lexer2::~Lexer2()
 }
 
 
+void Lexer2::prepareKeywords()
+{
+  if (!keywords.empty() && keywordsForCpp == lang.recognizeCppKeywords) {
+    return;
+  }
+  keywords.clear();
+
+  // later entries replace earlier ones, so these go in the reverse
+  // of the order 'lookupKeyword' searches them: the first of equal
+  // spellings in l2TokTypes wins, then the C map, then the GNU map
+  for (int i = L2_NUM_TYPES-1; i >= 0; i--) {
+    if (l2TokTypes[i].bisonSpelling) {
+      keywords[idTable.add(l2TokTypes[i].spelling)] = l2TokTypes[i].tokType;
+    }
+  }
+  if (!lang.recognizeCppKeywords) {
+    for (KeywordMap const &k : c_KeywordMap) {
+      keywords[idTable.add(k.spelling)] = k.tokType;
+    }
+  }
+  for (KeywordMap const &k : gnuKeywordMap) {
+    keywords[idTable.add(k.spelling)] = k.tokType;
+  }
+
+  keywordsForCpp = lang.recognizeCppKeywords;
+}
+
+
 SourceLoc Lexer2::startLoc() const
 {
   if (!tokens.empty()) {
@@ -632,25 +736,106 @@ SourceLoc Lexer2::startLoc() const
 }
 
 
-inline void Lexer2::copyFields()
+void Lexer2::fillBatch(size_t start)
+{
+  xassert(1 <= batchSize && batchSize <= MAX_BATCH);
+
+  if (source) {
+    // the parser is done with the tokens before the current one,
+    // which 'tokenDesc' may yet describe
+    for (; start > 1; start--) {
+      if (prevToken == &tokens.front()) {
+        prevToken = NULL;
+      }
+      tokens.pop_front();
+      tokensDropped++;
+    }
+    produce(start + batchSize);
+  }
+  xassert(start < readyEnd());        // no reading past EOF
+
+  size_t len = std::min(readyEnd() - start, (size_t)batchSize);
+  std::deque<Lexer2Token>::const_iterator iter = tokens.cbegin() + start;
+  for (size_t i=0; i < len; i++, ++iter) {
+    batch[i].type = iter->type;
+    batch[i].sval = iter->sval;
+    batch[i].loc = iter->loc;
+  }
+
+  batchStart = start;
+  bufNext = batch;
+  bufEnd = batch + len;
+}
+
+
+size_t Lexer2::readyEnd() const
+{
+  if (source &&
+      !tokens.empty() && tokens.back().type == L2_STRING_LITERAL) {
+    return tokens.size() - 1;
+  }
+  return tokens.size();
+}
+
+
+void Lexer2::produce(size_t want)
+{
+  while (source && readyEnd() < want) {
+    if (source->tokens.empty() && !lexer1_lexMore(*source)) {
+      addEOFToken();
+
+      // the first phase is finished, so report its errors now rather
+      // than when the parse is, and don't hold on to it
+      sourceErrors = source->errors;
+      if (sourceErrors > 0) {
+        printf("L1: %d error(s)\n", sourceErrors);
+      }
+      source = NULL;
+      break;
+    }
+
+    // 'prevToken' is in 'tokens', not 'source', so the L1 token can
+    // go as soon as it's converted
+    lexToken(source->tokens.front(), source->allowMultilineStrings);
+    source->tokens.pop_front();
+  }
+}
+
+
+inline Lexer2Token const &Lexer2::currentToken() const
 {
-  type = currentToken->type;
-  sval = currentToken->sval;
-  SOURCELOC( loc = currentToken->loc; )
+  // the current token is the one just before 'bufNext'
+  return tokens[batchStart + (bufNext - batch) - 1];
 }
 
 
 void Lexer2::beginReading()
 {
-  currentToken = tokens.begin();
-  copyFields();
+  fillBatch(0);
+  takePending();
+}
+
+
+void Lexer2::beginStreaming(Lexer1 &src)
+{
+  xassert(tokens.empty());
+  source = &src;
+  sourceErrors = 0;
+  tokensDropped = 0;
+
+  beginLexing();
+  fillBatch(0);
+  takePending();
 }
 
 
 STATICDEF void Lexer2::nextToken(Lexer2 *ths)
 {
-  std::advance(ths->currentToken, 1);
-  ths->copyFields();
+  if (!ths->takePending()) {
+    // batch is used up; stage the next one
+    ths->fillBatch(ths->batchStart + (ths->bufEnd - ths->batch));
+    ths->takePending();
+  }
 }
 
 LexerInterface::NextTokenFunc Lexer2::getTokenFunc() const
@@ -661,7 +846,7 @@ LexerInterface::NextTokenFunc Lexer2::getTokenFunc() const
 
 string Lexer2::tokenDesc() const
 {
-  return currentToken->toStringType(false /*asSexp*/,
+  return currentToken().toStringType(false /*asSexp*/,
                                     (Lexer2TokenType)LexerInterface::type);
 }
 
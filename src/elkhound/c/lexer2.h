@@ -11,6 +11,7 @@
 #include "lexerint.h"     // LexerInterface
 
 #include <deque>          // std::deque
+#include <unordered_map>  // std::unordered_map
 
 class CCLang;             // cc_lang.h
 
@@ -251,12 +252,67 @@ public:
   // output token stream
   std::deque<Lexer2Token> tokens;
 
-  // for reading the token stream
-  std::deque<Lexer2Token>::const_iterator currentToken;
+  // # of tokens handed to the parser per batch (see
+  // LexerInterface::bufNext), at most MAX_BATCH; with 1, every
+  // token goes through 'nextToken'
+  enum { MAX_BATCH = 256 };
+  int batchSize;
+
+  // when streaming, the # of errors the first phase reported; it is
+  // known (and printed) as soon as that phase reaches the end of its
+  // input
+  int sourceErrors;
+
+  // when true, 'lexer2_lex' classifies identifiers and operators by
+  // scanning the spelling tables, as it used to, instead of with
+  // 'classify' (for the -lexbench comparison)
+  bool scanKeywords;
+
+private:
+  // the keyword and operator spellings, interned in 'idTable', with
+  // their token types under 'lang'; see 'prepareKeywords'
+  std::unordered_map<StringRef, Lexer2TokenType> keywords;
+
+  // lang.recognizeCppKeywords when 'keywords' was filled
+  bool keywordsForCpp;
+
+  // the batch being read: copies of the (type, sval, loc) of the
+  // tokens starting at 'batchStart', since 'tokens' isn't contiguous;
+  // it is refilled from the front once the parser has used it up
+  BufferedToken batch[MAX_BATCH];
+
+  // index in 'tokens' of batch[0]
+  size_t batchStart;
+
+  // conversion state of 'lexToken': the last token added, for
+  // joining adjacent string literals, and options read from tracing
+  Lexer2Token *prevToken;      // (serf)
+  bool yieldVarName;
+  bool debugLexer2;
+
+  // when streaming (see 'beginStreaming'), the first phase being
+  // read on demand, until it is used up and L2_EOF has been added;
+  // else NULL
+  Lexer1 *source;              // (serf)
+
+  // # of tokens removed from the front of 'tokens' while streaming
+  size_t tokensDropped;
 
 private:
-  // copy from currentToken to LexerInterface fields
-  void copyFields();
+  // stage the tokens starting at index 'start'
+  void fillBatch(size_t start);
+
+  // index in 'tokens' just past the last one the parser may read; a
+  // trailing string literal is held back while streaming, since the
+  // next L1 token could still be joined to it
+  size_t readyEnd() const;
+
+  // while streaming, convert L1 tokens until 'readyEnd' reaches 'want'
+  // or the input is used up
+  void produce(size_t want);
+
+  // the token the LexerInterface fields describe
+  Lexer2Token const &currentToken() const;
 
   // shared piece of ctor
   void init();
@@ -266,16 +322,56 @@ public:
   Lexer2(CCLang &lang, StringTable &externalTable);    // table given externally
   ~Lexer2();
 
+  // 'bufNext' points into this object
+  Lexer2(Lexer2 const &) = delete;
+  Lexer2 &operator=(Lexer2 const &) = delete;
+
   SourceLoc startLoc() const;
 
+  // fill 'keywords' for the current 'lang', unless that's done
+  void prepareKeywords();
+
+  // the token type of an identifier or operator spelling interned in
+  // 'idTable': the keyword's or operator's, or L2_NAME; needs
+  // 'prepareKeywords' first
+  Lexer2TokenType classify(StringRef spelling) const
+  {
+    auto it = keywords.find(spelling);
+    return it == keywords.end()? L2_NAME : it->second;
+  }
+
   Lexer2Token* addToken(Lexer2TokenType type, SourceLoc loc)
     { tokens.emplace_back(type, loc); return &tokens.back(); }
   void addEOFToken()
     { addToken(L2_EOF, SL_UNKNOWN); }
 
-  // reset the 'currentToken' so the parser can begin reading tokens
+  // convert L1 tokens one at a time: 'beginLexing', then 'lexToken'
+  // for each, then 'addEOFToken' ('lexer2_lex' does this for a whole
+  // Lexer1)
+  void beginLexing();
+  void lexToken(Lexer1Token const &L1, bool allowMultilineStrings);
+
+  // position at the first token so the parser can begin reading;
+  // all the tokens must have been added by now
   void beginReading();
 
+  // instead of 'lexer2_lex' and 'beginReading', read 'src', which
+  // has been given its input with 'lexer1_beginStream', as the parser
+  // asks for tokens: each batch is converted just before the parser
+  // reads it, and the tokens it has moved past are dropped, along
+  // with the L1 tokens, so memory doesn't grow with the input
+  void beginStreaming(Lexer1 &src);
+
+  // stop reading the source given to 'beginStreaming', if it hasn't
+  // been used up already; call this before the source goes away
+  void endStreaming()
+    { source = NULL; }
+
+  // # of tokens produced so far, including those dropped while
+  // streaming
+  size_t numTokens() const
+    { return tokensDropped + tokens.size(); }
+
   // get next token
   static void nextToken(Lexer2 *ths);
 
@@ -0,0 +1,1223 @@
+// mtbench.cc            see license.txt for copyright and terms of use
+// code for mtbench.h
+
+#include "mtbench.h"      // this module
+#include "parssppt.h"     // lexNamedFile, glrParseStreamedFile
+#include "countnew.h"     // threadAllocations
+#include "glr.h"          // GLR
+#include "mtparse.h"      // parallelGlrParse
+#include "cyctimer.h"     // CycleTimer
+#include "cc_lang.h"      // CCLang
+#include "trace.h"        // traceProcessArg
+#include "syserr.h"       // xsyserror
+#include "parsetables.h"  // ParseTables
+#include "parseprof.h"    // ParseProfile
+#include "crc.h"          // crc32
+#include "srcloc.h"       // SourceLocManager
+
+#include <fmt/core.h>     // fmt::format
+#include <algorithm>      // std::min
+#include <chrono>         // std::chrono
+#include <functional>     // std::function
+#include <memory>         // std::unique_ptr
+#include <sstream>        // std::ostringstream
+#include <vector>         // std::vector
+#include <stdlib.h>       // atoi
+#include <string.h>       // strcmp
+#include <stdio.h>        // fopen, fscanf
+#include <unistd.h>       // fork, sysconf, _exit, pipe
+#include <sys/resource.h> // getrusage
+#include <sys/stat.h>     // stat
+#include <sys/wait.h>     // waitpid
+
+
+typedef std::chrono::steady_clock Clock;
+
+
+// ----------------- concurrent parsing stress test ---------------
+MTStressClient::~MTStressClient()
+{}
+
+
+// one input file, lexed up front, so that it can be parsed any
+// number of times (though by only one thread at a time)
+class StressJob {
+public:
+  char const *fname;
+  StringTable strTable;       // each parse gets its own identifiers
+  Lexer2 lexer2;
+  SemanticValue treeTop;      // result of the most recent parse
+
+public:
+  StressJob(char const *f, CCLang &lang)
+    : fname(f), strTable(), lexer2(lang, strTable), treeTop(NULL_SVAL) {}
+};
+
+
+class StressJobs : public ParallelParseJobs {
+public:
+  MTStressClient &client;
+  CCLang &lang;
+  std::vector<std::unique_ptr<StressJob>> &jobs;
+
+public:
+  StressJobs(MTStressClient &c, CCLang &L,
+             std::vector<std::unique_ptr<StressJob>> &j)
+    : client(c), lang(L), jobs(j) {}
+
+  virtual bool parseJob(GLR &glr, int i);
+};
+
+bool StressJobs::parseJob(GLR &glr, int i)
+{
+  StressJob &job = *jobs[i];
+  std::unique_ptr<UserActions> user(client.makeUserActions(job.strTable, lang));
+  glr.userAct = user.get();
+
+  job.lexer2.beginReading();
+  return glr.glrParse(job.lexer2, job.treeTop);
+}
+
+
+static void benchList(std::ostream &os);
+
+static int mtStressMain(MTStressClient &client, ParseTables const *tables,
+                        int argc, char **argv)
+{
+  char const *progName = argv[0];
+  int numThreads = 4;
+  int repeat = 1;
+
+  while (argc >= 2) {
+    if (traceProcessArg(argc, argv)) {
+      continue;
+    }
+    else if (0==strcmp(argv[1], "-threads") && argc >= 3) {
+      numThreads = atoi(argv[2]);
+      argc -= 2;
+      argv += 2;
+    }
+    else if (0==strcmp(argv[1], "-repeat") && argc >= 3) {
+      repeat = atoi(argv[2]);
+      argc -= 2;
+      argv += 2;
+    }
+    else {
+      break;     // didn't find any more options
+    }
+  }
+
+  if (argc < 2 || numThreads < 1 || repeat < 1) {
+    std::cout << "usage: " << progName << " [options] input-file...\n"
+      "  options:\n"
+      "    -tr <sys>:      turn on tracing for the named subsystem\n"
+      "    -threads <n>:   number of parsing threads (default 4)\n"
+      "    -repeat <n>:    parse each input <n> times (default 1)\n"
+      "   or: " << progName << " benchmark [options] input-file...\n";
+    benchList(std::cout);
+    return 2;
+  }
+
+  CCLang lang;
+  lang.ANSI_Cplusplus();
+
+  // the lexers are not reentrant (Lexer1 is a flex scanner), so all
+  // the lexing happens here, before any threads start
+  std::vector<std::unique_ptr<StressJob>> jobs;
+  for (int r=0; r < repeat; r++) {
+    for (int i=1; i < argc; i++) {
+      jobs.emplace_back(new StressJob(argv[i], lang));
+      if (!lexNamedFile(jobs.back()->lexer2, argv[i])) {
+        return 2;
+      }
+    }
+  }
+  int numJobs = jobs.size();
+  StressJobs stress(client, lang, jobs);
+
+  // reference results
+  std::vector<string> expect;
+  {
+    CycleTimer timer;
+    if (parallelGlrParse(tables, stress, numJobs, 1 /*numThreads*/) != 0) {
+      std::cout << "reference parse failed\n";
+      return 2;
+    }
+    std::cout << numJobs << " parses on 1 thread: " << timer.elapsed() << "\n";
+  }
+  for (auto &job : jobs) {
+    std::ostringstream os;
+    client.printResult(os, job->treeTop);
+    expect.push_back(os.str());
+    job->treeTop = NULL_SVAL;
+  }
+
+  // the same parses, concurrently
+  {
+    CycleTimer timer;
+    int failures = parallelGlrParse(tables, stress, numJobs, numThreads);
+    std::cout << numJobs << " parses on " << numThreads << " threads: "
+              << timer.elapsed() << "\n";
+    if (failures) {
+      std::cout << failures << " concurrent parse(s) failed\n";
+      return 4;
+    }
+  }
+
+  int mismatches = 0;
+  for (int i=0; i < numJobs; i++) {
+    std::ostringstream os;
+    client.printResult(os, jobs[i]->treeTop);
+    if (os.str() != expect[i]) {
+      std::cout << jobs[i]->fname << ": concurrent parse differs\n";
+      mismatches++;
+    }
+  }
+
+  return mismatches? 4 : 0;
+}
+
+
+// ----------------------- benchmark driver -----------------------
+// what a benchmark has to work with
+class BenchContext {
+public:
+  MTStressClient &client;
+  ParseTables const *tables;          // the compiled-in tables
+  char const *arg;                    // the benchmark's own argument, or NULL
+  int iters;                          // process each input this many times
+  std::vector<char const*> fnames;    // the input files
+  CCLang lang;                        // C++
+
+  // the input files lexed up front, for the benchmarks that parse
+  std::vector<std::unique_ptr<StressJob>> jobs;
+
+public:
+  BenchContext(MTStressClient &c, ParseTables const *t)
+    : client(c), tables(t), arg(NULL), iters(10), fnames(), lang(), jobs()
+    { lang.ANSI_Cplusplus(); }
+};
+
+
+// one way of processing the inputs; 'runModes' times a benchmark's
+// modes over the same inputs and checks that they agree
+class BenchMode {
+public:
+  string name;
+
+public:
+  explicit BenchMode(string n) : name(n) {}
+  virtual ~BenchMode() {}
+
+  // get ready, untimed, to process input 'i'
+  virtual void prepare(BenchContext &ctx, int i) {}
+
+  // process input 'i' once, adding the tokens seen to 'tokens';
+  // false on error
+  virtual bool runOne(BenchContext &ctx, int i, long &tokens) = 0;
+
+  // render the result of the 'runOne' just done; modes agree iff
+  // their renderings are identical
+  virtual string result(BenchContext &ctx, int i) = 0;
+
+  // anything to report after the throughput, such as ", 5 widgets"
+  virtual string stats(long tokens, double secs) { return ""; }
+};
+
+typedef std::vector<std::unique_ptr<BenchMode>> BenchModes;
+
+
+// run each mode over every input 'ctx.iters' times, report its
+// throughput, and check that each input's result is the same in
+// every mode as in the first; returns a process exit code
+static int runModes(BenchContext &ctx, BenchModes const &modes)
+{
+  std::vector<string> expect;
+  int mismatches = 0;
+  for (auto const &mode : modes) {
+    long tokens = 0;
+    Clock::duration elapsed(0);
+    for (int iter=0; iter < ctx.iters; iter++) {
+      for (size_t i=0; i < ctx.fnames.size(); i++) {
+        mode->prepare(ctx, i);
+        Clock::time_point start = Clock::now();
+        bool ok = mode->runOne(ctx, i, tokens);
+        elapsed += Clock::now() - start;
+        if (!ok) {
+          std::cout << ctx.fnames[i] << ": " << mode->name << ": failed\n";
+          return 4;
+        }
+
+        if (iter == ctx.iters-1) {
+          string r = mode->result(ctx, i);
+          if (mode == modes.front()) {
+            expect.push_back(r);
+          }
+          else if (r != expect[i]) {
+            std::cout << ctx.fnames[i] << ": " << mode->name
+                      << " differs from " << modes.front()->name << "\n";
+            mismatches++;
+          }
+        }
+      }
+    }
+    double secs = std::chrono::duration<double>(elapsed).count();
+
+    std::cout << mode->name << ": " << tokens << " tokens in "
+              << (long)(secs * 1000) << " ms, "
+              << (long)(tokens / secs) << " tokens/s"
+              << mode->stats(tokens, secs) << "\n";
+  }
+  return mismatches? 4 : 0;
+}
+
+
+// parse the lexed inputs (BenchContext::jobs) with a GLR over
+// 'tables'; whoever makes the mode can configure 'glr', and have
+// 'describe' add to the report
+class ParseMode : public BenchMode {
+public:
+  GLR glr;
+  std::unique_ptr<UserActions> user;   // for the next parse
+  int batchSize;                       // Lexer2::batchSize to parse with
+  std::function<string(GLR &glr, long tokens)> describe;
+
+public:
+  ParseMode(string n, ParseTables const *tables)
+    : BenchMode(n), glr(NULL /*userAct*/, tables), user(),
+      batchSize(Lexer2::MAX_BATCH), describe() {}
+
+  virtual void prepare(BenchContext &ctx, int i);
+  virtual bool runOne(BenchContext &ctx, int i, long &tokens);
+  virtual string result(BenchContext &ctx, int i);
+  virtual string stats(long tokens, double secs);
+};
+
+void ParseMode::prepare(BenchContext &ctx, int i)
+{
+  StressJob &job = *ctx.jobs[i];
+  user.reset(ctx.client.makeUserActions(job.strTable, ctx.lang));
+  glr.userAct = user.get();
+  job.lexer2.batchSize = batchSize;
+}
+
+bool ParseMode::runOne(BenchContext &ctx, int i, long &tokens)
+{
+  StressJob &job = *ctx.jobs[i];
+  job.lexer2.beginReading();
+  if (!glr.glrParse(job.lexer2, job.treeTop)) {
+    return false;
+  }
+  tokens += job.lexer2.tokens.size();
+  return true;
+}
+
+string ParseMode::result(BenchContext &ctx, int i)
+{
+  StressJob &job = *ctx.jobs[i];
+  std::ostringstream os;
+  ctx.client.printResult(os, job.treeTop);
+  job.treeTop = NULL_SVAL;
+  return os.str();
+}
+
+string ParseMode::stats(long tokens, double)
+{
+  return describe? describe(glr, tokens) : string();
+}
+
+
+// a new ParseMode, as a BenchModes element
+static ParseMode *addParseMode(BenchModes &modes, string name,
+                               ParseTables const *tables)
+{
+  ParseMode *mode = new ParseMode(name, tables);
+  modes.emplace_back(mode);
+  return mode;
+}
+
+
+// the rendering of every token 'lexer2' holds
+static string renderTokens(Lexer2 const &lexer2)
+{
+  std::ostringstream os;
+  for (Lexer2Token const &tok : lexer2.tokens) {
+    os << tok.toString() << "\n";
+  }
+  return os.str();
+}
+
+
+// in a child process, so that it starts from this process's memory
+// footprint and leaves nothing behind in it, run 'body', which fills
+// in 'result' and returns false on error; 'result' is copied back,
+// so it must be plain data; false if the child fails
+template <class RESULT, class BODY>
+static bool inChild(RESULT &result, BODY body)
+{
+  int fds[2];
+  if (pipe(fds) < 0) {
+    xsyserror("pipe");
+  }
+
+  std::cout << std::flush;
+  pid_t pid = fork();
+  if (pid < 0) {
+    xsyserror("fork");
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    bool ok = body(result);
+    std::cout << std::flush;
+    bool wrote = write(fds[1], &result, sizeof(result)) == sizeof(result);
+    _exit(ok && wrote? 0 : 4);
+  }
+
+  close(fds[1]);
+  bool got = read(fds[0], &result, sizeof(result)) == sizeof(result);
+  close(fds[0]);
+
+  int status;
+  waitpid(pid, &status, 0);
+  return got && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+// resident and shared memory of this process, in kB
+static void memoryKB(long &resident, long &shared)
+{
+  long size;
+  resident = shared = 0;
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if (fp) {
+    if (fscanf(fp, "%ld %ld %ld", &size, &resident, &shared) != 3) {
+      resident = shared = 0;
+    }
+    fclose(fp);
+  }
+  long pageKB = sysconf(_SC_PAGESIZE) / 1024;
+  resident *= pageKB;
+  shared *= pageKB;
+}
+
+
+// ------------------- GSS allocation benchmark -----------------
+// where the extra sibling links of the GSS come from
+// (GLR::useLinkArena): heap-allocated links, then the slab arena
+static int gssBench(BenchContext &ctx)
+{
+  BenchModes modes;
+  for (int arena=0; arena < 2; arena++) {
+    ParseMode *mode = addParseMode(modes, arena? "arena" : "heap", ctx.tables);
+    mode->glr.useLinkArena = arena;
+
+    // with the arena, the only trips to the allocator are for slabs
+    mode->describe = [](GLR &glr, long tokens) {
+      long allocs = glr.useLinkArena? glr.linkArena.numSlabs() : glr.numExtraLinks;
+      return fmt::format(", {} extra links, {} link allocations ({:.4g} per token)",
+                         glr.numExtraLinks, allocs, (double)allocs / tokens);
+    };
+  }
+  return runModes(ctx, modes);
+}
+
+
+// ------------------- token delivery benchmark -----------------
+// the lexer handing over one token per 'nextToken' call, then in
+// batches (Lexer2::batchSize)
+static int tokenBench(BenchContext &ctx)
+{
+  BenchModes modes;
+  addParseMode(modes, "single", ctx.tables)->batchSize = 1;
+  addParseMode(modes, "batched", ctx.tables);
+  return runModes(ctx, modes);
+}
+
+
+// ---------------- directly-coded parser benchmark ---------------
+// the tables alone, then with the parser elkhound emitted for the
+// grammar (GLR::useDirectParser)
+static int directBench(BenchContext &ctx)
+{
+  BenchModes modes;
+  addParseMode(modes, "tables", ctx.tables)->glr.useDirectParser = false;
+  addParseMode(modes, "direct", ctx.tables);
+  return runModes(ctx, modes);
+}
+
+
+// ------------------- table loading benchmark ------------------
+// true if 'a' and 'b' answer every query the same way
+static bool sameTables(ParseTables const &a, ParseTables const &b)
+{
+  if (a.getNumTerms() != b.getNumTerms() ||
+      a.getNumNonterms() != b.getNumNonterms() ||
+      a.getNumStates() != b.getNumStates() ||
+      a.getNumProds() != b.getNumProds() ||
+      a.startState != b.startState ||
+      a.finalProductionIndex != b.finalProductionIndex ||
+      a.getChecksum() != b.getChecksum()) {
+    return false;
+  }
+
+  for (int s=0; s < a.getNumStates(); s++) {
+    StateId state = (StateId)s;
+    if (a.getStateSymbol(state) != b.getStateSymbol(state)) {
+      return false;
+    }
+    for (int t=0; t < a.getNumTerms(); t++) {
+      if (a.getActionEntry(state, t) != b.getActionEntry(state, t)) {
+        return false;
+      }
+    }
+    for (int nt=0; nt < a.getNumNonterms(); nt++) {
+      if (a.getGotoEntry(state, nt) != b.getGotoEntry(state, nt)) {
+        return false;
+      }
+    }
+  }
+
+  for (int p=0; p < a.getNumProds(); p++) {
+    if (a.getProdInfo(p).rhsLen != b.getProdInfo(p).rhsLen ||
+        a.getProdInfo(p).lhsIndex != b.getProdInfo(p).lhsIndex) {
+      return false;
+    }
+  }
+  for (int nt=0; nt < a.nontermOrderSize(); nt++) {
+    if (a.getNontermOrdinal(nt) != b.getNontermOrdinal(nt)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// time 'loads' calls to 'load'
+template <class LOAD>
+static void tableStartupMode(char const *name, LOAD load, int loads)
+{
+  Clock::time_point start = Clock::now();
+  for (int i=0; i < loads; i++) {
+    delete load();
+  }
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::cout << name << ": " << loads << " loads, "
+            << secs * 1e6 / loads << " us per load\n";
+}
+
+
+// in a child process, get the tables with 'load', parse every input
+// once, and report how much the resident set grew
+template <class LOAD>
+static void tableMemoryMode(char const *name, LOAD load, BenchContext &ctx)
+{
+  struct Growth {
+    long resident, shared;       // kB
+  } growth;
+
+  bool ok = inChild(growth, [&](Growth &g) {
+    long resident0, shared0;
+    memoryKB(resident0, shared0);
+
+    std::unique_ptr<ParseTables> tables(load());
+    ParseMode mode(name, tables.get());
+    long tokens = 0;
+    for (size_t i=0; i < ctx.jobs.size(); i++) {
+      mode.prepare(ctx, i);
+      if (!mode.runOne(ctx, i, tokens)) {
+        return false;
+      }
+    }
+
+    memoryKB(g.resident, g.shared);
+    g.resident -= resident0;
+    g.shared -= shared0;
+    return true;
+  });
+
+  if (ok) {
+    std::cout << name << ": resident +" << growth.resident
+              << " kB, of which shared +" << growth.shared << " kB\n";
+  }
+  else {
+    std::cout << name << ": parse error\n";
+  }
+}
+
+
+// where the tables come from: check that the tables file named by
+// the argument (see ParseTables::loadBinary) matches the compiled-in
+// tables and parses the inputs the same way, then report the time to
+// get the tables from the compiled-in data and from the file, and
+// the growth of the resident set for each while parsing the inputs
+static int tableBench(BenchContext &ctx)
+{
+  // the compiled-in tables, the way the program made 'tables'
+  StringTable strTable;
+  std::unique_ptr<UserActions> user(ctx.client.makeUserActions(strTable, ctx.lang));
+  auto compiled = [&]() { return user->makeTables(); };
+  auto mapped = [&]() { return ParseTables::loadBinary(ctx.arg); };
+
+  std::unique_ptr<ParseTables> loaded(mapped());
+  if (!sameTables(*ctx.tables, *loaded)) {
+    std::cout << ctx.arg << ": tables differ from the compiled-in ones\n";
+    return 4;
+  }
+
+  BenchModes modes;
+  addParseMode(modes, "compiled", ctx.tables);
+  addParseMode(modes, "mapped", loaded.get());
+  if (int code = runModes(ctx, modes)) {
+    return code;
+  }
+
+  tableStartupMode("compiled", compiled, ctx.iters * 100);
+  tableStartupMode("mapped", mapped, ctx.iters * 100);
+
+  tableMemoryMode("compiled", compiled, ctx);
+  tableMemoryMode("mapped", mapped, ctx);
+  return 0;
+}
+
+
+// ------------------ alternative tables benchmark ----------------
+// other tables for the same grammar, such as those from 'elkhound
+// -lr1', from the file named by the argument: the compiled-in tables,
+// then those, reporting how many parser actions were deterministic
+static int altTablesBench(BenchContext &ctx)
+{
+  std::unique_ptr<ParseTables> alt(ParseTables::loadBinary(ctx.arg));
+  if (alt->getNumTerms() != ctx.tables->getNumTerms() ||
+      alt->getNumNonterms() != ctx.tables->getNumNonterms() ||
+      alt->getNumProds() != ctx.tables->getNumProds()) {
+    std::cout << ctx.arg << ": tables are for a different grammar\n";
+    return 4;
+  }
+
+  // the directly-coded parser is only good for the compiled-in
+  // tables, which it recognizes by their checksum, since tables such
+  // as those renumbered by a profile have all the same sizes; a copy
+  // of the compiled-in tables has their checksum too, of course
+  StringTable strTable;
+  std::unique_ptr<UserActions> user(ctx.client.makeUserActions(strTable, ctx.lang));
+  if (alt->getChecksum() != ctx.tables->getChecksum() &&
+      user->getDirectParser(ctx.tables) && user->getDirectParser(alt.get())) {
+    std::cout << ctx.arg << ": the directly-coded parser accepts these tables\n";
+    return 4;
+  }
+
+  BenchModes modes;
+  for (ParseTables const *tables : { ctx.tables, (ParseTables const*)alt.get() }) {
+    ParseMode *mode = addParseMode(modes, tables == ctx.tables? "compiled" : ctx.arg,
+                                   tables);
+
+    // the directly-coded parser only goes with the compiled-in
+    // tables, and does not count its actions
+    mode->glr.useDirectParser = false;
+    mode->describe = [tables](GLR &glr, long) {
+      return fmt::format("; {} states, shifts {} det + {} nondet, "
+                         "reductions {} det + {} nondet",
+                         tables->getNumStates(),
+                         glr.detShift, glr.nondetShift,
+                         glr.detReduce, glr.nondetReduce);
+    };
+  }
+  return runModes(ctx, modes);
+}
+
+
+// ------------------------ parse profile ------------------------
+// parse the inputs once each, counting the table lookups in a
+// ParseProfile, and write it to the file named by the argument, for
+// 'elkhound -profile'
+static int profileBench(BenchContext &ctx)
+{
+  ParseProfile profile(*ctx.tables);
+
+  BenchModes modes;
+  addParseMode(modes, "profile", ctx.tables)->glr.profile = &profile;
+
+  // the counts only need to be in proportion, so each input is
+  // parsed once regardless of -iters
+  ctx.iters = 1;
+  if (int code = runModes(ctx, modes)) {
+    return code;
+  }
+
+  profile.writeFile(ctx.arg);
+  std::cout << ctx.arg << ": " << ctx.tables->getNumStates() << " states\n";
+  return 0;
+}
+
+
+// ------------------ keyword classification benchmark ----------------
+// run lexer2 over the first phase's tokens, with Lexer2::scanKeywords
+// set to 'scanKeywords'
+class LexMode : public BenchMode {
+public:
+  CCLang &lang;
+  bool scanKeywords;
+  std::vector<std::unique_ptr<Lexer1>> const &inputs;
+
+  // the second phase of the input being lexed
+  std::unique_ptr<StringTable> strTable;
+  std::unique_ptr<Lexer2> lexer2;
+
+public:
+  LexMode(string n, CCLang &L, bool scan,
+          std::vector<std::unique_ptr<Lexer1>> const &in)
+    : BenchMode(n), lang(L), scanKeywords(scan), inputs(in),
+      strTable(), lexer2() {}
+
+  virtual void prepare(BenchContext &ctx, int i)
+  {
+    lexer2.reset();
+    strTable.reset(new StringTable);
+    lexer2.reset(new Lexer2(lang, *strTable));
+    lexer2->scanKeywords = scanKeywords;
+  }
+
+  virtual bool runOne(BenchContext &ctx, int i, long &tokens)
+  {
+    lexer2_lex(*lexer2, *inputs[i], NULL /*fname*/);
+    tokens += lexer2->tokens.size();
+    return true;
+  }
+
+  virtual string result(BenchContext &ctx, int i)
+    { return renderTokens(*lexer2); }
+};
+
+
+// the second lexer phase's classification of identifiers and
+// operators, in C and in C++: scanning the spelling tables
+// (Lexer2::scanKeywords), then with the interned spellings
+static int lexBench(BenchContext &ctx)
+{
+  // the first phase doesn't classify anything, so it runs once
+  std::vector<std::unique_ptr<Lexer1>> inputs;
+  for (char const *fname : ctx.fnames) {
+    inputs.emplace_back(new Lexer1(fname));
+    FILE *input = fopen(fname, "r");
+    if (!input) {
+      xsyserror("fopen", fname);
+    }
+    lexer1_lex(*inputs.back(), input);
+    fclose(input);
+
+    if (inputs.back()->errors > 0) {
+      std::cout << fname << ": " << inputs.back()->errors << " L1 error(s)\n";
+      return 2;
+    }
+  }
+
+  // the dialects differ in which spellings are keywords, so each is
+  // compared only with itself
+  int ret = 0;
+  for (int dialect=0; dialect < 2; dialect++) {
+    CCLang lang;
+    if (dialect == 0) {
+      lang.ANSI_C();
+    }
+    else {
+      lang.ANSI_Cplusplus();
+    }
+    char const *dialectName = dialect==0? "C" : "C++";
+
+    BenchModes modes;
+    modes.emplace_back(new LexMode(fmt::format("scan ({})", dialectName),
+                                   lang, true /*scan*/, inputs));
+    modes.emplace_back(new LexMode(fmt::format("interned ({})", dialectName),
+                                   lang, false /*scan*/, inputs));
+    ret = std::max(ret, runModes(ctx, modes));
+  }
+  return ret;
+}
+
+
+// ------------------- mapped input benchmark -------------------
+// run both lexer phases over an input, reading it or, with
+// 'mapInput', mapping it (see lexNamedFile)
+class MapMode : public BenchMode {
+public:
+  bool mapInput;
+
+  // the input being lexed
+  std::unique_ptr<StringTable> strTable;
+  std::unique_ptr<Lexer2> lexer2;
+
+  // totals over all the runs
+  long allocs;
+  double bytes;
+
+public:
+  MapMode(string n, bool m)
+    : BenchMode(n), mapInput(m), strTable(), lexer2(), allocs(0), bytes(0) {}
+
+  virtual void prepare(BenchContext &ctx, int i)
+  {
+    lexer2.reset();
+    strTable.reset(new StringTable);
+    lexer2.reset(new Lexer2(ctx.lang, *strTable));
+
+    struct stat st;
+    if (stat(ctx.fnames[i], &st) == 0) {
+      bytes += st.st_size;
+    }
+  }
+
+  virtual bool runOne(BenchContext &ctx, int i, long &tokens)
+  {
+    long allocs0 = threadAllocations();
+    bool ok = lexNamedFile(*lexer2, ctx.fnames[i], mapInput);
+    allocs += threadAllocations() - allocs0;
+    tokens += lexer2->tokens.size();
+    return ok;
+  }
+
+  virtual string result(BenchContext &ctx, int i)
+    { return renderTokens(*lexer2); }
+
+  virtual string stats(long tokens, double secs)
+  {
+    return fmt::format(", {} allocations ({:.4g} per token), {:.3g} MB/s",
+                       allocs, (double)allocs / tokens,
+                       bytes / (1024 * 1024) / secs);
+  }
+};
+
+
+// reading the inputs, then mapping them, reporting heap allocations
+static int mapBench(BenchContext &ctx)
+{
+  BenchModes modes;
+  modes.emplace_back(new MapMode("read", false /*mapInput*/));
+  modes.emplace_back(new MapMode("mapped", true /*mapInput*/));
+  return runModes(ctx, modes);
+}
+
+
+// ------------------ streaming lexer benchmark ----------------
+// user actions that pass everything on to 'inner', noting when the
+// first reduction action runs
+class FirstReductionActions : public UserActions {
+public:
+  UserActions *inner;                       // (serf)
+  ReductionActionFunc innerReduce;
+  ReclassifyFunc innerReclassify;
+
+  // whether, and when, a reduction action has run
+  bool reduced;
+  Clock::time_point firstReduction;
+
+public:
+  explicit FirstReductionActions(UserActions *i)
+    : inner(i),
+      innerReduce(i->getReductionAction()),
+      innerReclassify(i->getReclassifier()),
+      reduced(false),
+      firstReduction() {}
+
+  USER_ACTION_FUNCTIONS
+
+  static SemanticValue doReductionAction(
+    UserActions *ths,
+    int productionId, SemanticValue const *svals
+    SOURCELOCARG( SourceLoc loc ) );
+
+  static int reclassifyToken(UserActions *ths,
+    int oldTokenType, SemanticValue sval);
+};
+
+STATICDEF SemanticValue FirstReductionActions::doReductionAction(
+  UserActions *ths, int productionId, SemanticValue const *svals
+  SOURCELOCARG( SourceLoc loc ) )
+{
+  FirstReductionActions *a = static_cast<FirstReductionActions*>(ths);
+  if (!a->reduced) {
+    a->reduced = true;
+    a->firstReduction = Clock::now();
+  }
+  return a->innerReduce(a->inner, productionId, svals SOURCELOCARG(loc));
+}
+
+STATICDEF int FirstReductionActions::reclassifyToken(UserActions *ths,
+  int oldTokenType, SemanticValue sval)
+{
+  FirstReductionActions *a = static_cast<FirstReductionActions*>(ths);
+  return a->innerReclassify(a->inner, oldTokenType, sval);
+}
+
+UserActions::ReductionActionFunc FirstReductionActions::getReductionAction()
+  { return &FirstReductionActions::doReductionAction; }
+SemanticValue FirstReductionActions::duplicateTerminalValue(int termId, SemanticValue sval)
+  { return inner->duplicateTerminalValue(termId, sval); }
+SemanticValue FirstReductionActions::duplicateNontermValue(int nontermId, SemanticValue sval)
+  { return inner->duplicateNontermValue(nontermId, sval); }
+void FirstReductionActions::deallocateTerminalValue(int termId, SemanticValue sval)
+  { inner->deallocateTerminalValue(termId, sval); }
+void FirstReductionActions::deallocateNontermValue(int nontermId, SemanticValue sval)
+  { inner->deallocateNontermValue(nontermId, sval); }
+SemanticValue FirstReductionActions::mergeAlternativeParses(
+  int ntIndex, SemanticValue left, SemanticValue right SOURCELOCARG( SourceLoc loc ) )
+  { return inner->mergeAlternativeParses(ntIndex, left, right SOURCELOCARG(loc)); }
+bool FirstReductionActions::keepNontermValue(int nontermId, SemanticValue sval)
+  { return inner->keepNontermValue(nontermId, sval); }
+UserActions::ReclassifyFunc FirstReductionActions::getReclassifier()
+  { return &FirstReductionActions::reclassifyToken; }
+string FirstReductionActions::terminalDescription(int termId, SemanticValue sval)
+  { return inner->terminalDescription(termId, sval); }
+string FirstReductionActions::nonterminalDescription(int nontermId, SemanticValue sval)
+  { return inner->nonterminalDescription(nontermId, sval); }
+char const *FirstReductionActions::terminalName(int termId)
+  { return inner->terminalName(termId); }
+char const *FirstReductionActions::nonterminalName(int nontermId)
+  { return inner->nonterminalName(nontermId); }
+
+
+// what a child of 'streamBenchMode' sends back
+struct StreamBenchResult {
+  size_t tokens;
+  double firstSecs;     // best time to the first reduction
+  double totalSecs;     // best time to parse
+  long peakKB;          // resident set growth during the first parse
+  uint32_t crc;         // of the result's rendering
+};
+
+// in a child process, so that both ways of lexing start from the
+// same memory footprint, parse 'fname' 'iters' times, lexing it all
+// first or, with 'streaming', as the parser reads
+static bool streamBenchMode(bool streaming, BenchContext &ctx,
+                            char const *fname, StreamBenchResult &result)
+{
+  return inChild(result, [&](StreamBenchResult &r) {
+    long resident0, shared0;
+    memoryKB(resident0, shared0);
+
+    for (int i=0; i < ctx.iters; i++) {
+      StringTable strTable;
+      Lexer2 lexer2(ctx.lang, strTable);
+      std::unique_ptr<UserActions> user(ctx.client.makeUserActions(strTable, ctx.lang));
+      FirstReductionActions actions(user.get());
+      GLR glr(&actions, ctx.tables);
+      SemanticValue treeTop = NULL_SVAL;
+
+      Clock::time_point start = Clock::now();
+      bool ok;
+      if (streaming) {
+        ok = glrParseStreamedFile(glr, lexer2, treeTop, fname);
+      }
+      else {
+        ok = lexNamedFile(lexer2, fname);
+        if (ok) {
+          lexer2.beginReading();
+          ok = glr.glrParse(lexer2, treeTop);
+        }
+      }
+      Clock::time_point end = Clock::now();
+      if (!ok || !actions.reduced) {
+        return false;
+      }
+
+      double first = std::chrono::duration<double>(actions.firstReduction - start).count();
+      double total = std::chrono::duration<double>(end - start).count();
+      if (i == 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        r.peakKB = usage.ru_maxrss - resident0;     // ru_maxrss is in kB
+        r.tokens = lexer2.numTokens();
+        r.firstSecs = first;
+        r.totalSecs = total;
+
+        std::ostringstream os;
+        ctx.client.printResult(os, treeTop);
+        string text = os.str();
+        r.crc = crc32((unsigned char const*)text.data(), text.length());
+      }
+      else {
+        r.firstSecs = std::min(r.firstSecs, first);
+        r.totalSecs = std::min(r.totalSecs, total);
+      }
+    }
+    return true;
+  });
+}
+
+
+// lexing as the parser reads (Lexer2::beginStreaming) against lexing
+// each file whole before parsing it: parse each input both ways,
+// reporting the best times to the first reduction action and to the
+// end of the parse, and the peak growth of the resident set
+static int streamBench(BenchContext &ctx)
+{
+  int mismatches = 0;
+  for (char const *fname : ctx.fnames) {
+    StreamBenchResult r[2];
+    for (int streaming=0; streaming < 2; streaming++) {
+      if (!streamBenchMode(streaming, ctx, fname, r[streaming])) {
+        std::cout << fname << ": parse error\n";
+        return 4;
+      }
+      std::cout << fname << ": " << (streaming? "streaming" : "whole file")
+                << ": " << r[streaming].tokens << " tokens, "
+                << "first reduction after " << r[streaming].firstSecs * 1000 << " ms, "
+                << "parsed in " << r[streaming].totalSecs * 1000 << " ms, "
+                << "peak resident +" << r[streaming].peakKB << " kB\n";
+    }
+    if (r[0].crc != r[1].crc) {
+      std::cout << fname << ": streaming parse differs\n";
+      mismatches++;
+    }
+  }
+  return mismatches? 4 : 0;
+}
+
+
+// ------------------ source location index benchmark ----------------
+// bytes read and read calls made by this process so far, according to
+// Linux's /proc/self/io; zeroes where that isn't available
+static void readCounts(long &bytes, long &calls)
+{
+  bytes = calls = 0;
+  FILE *fp = fopen("/proc/self/io", "r");
+  if (fp) {
+    char name[32];
+    long value;
+    while (fscanf(fp, "%31s %ld", name, &value) == 2) {
+      if (0==strcmp(name, "rchar:")) {
+        bytes = value;
+      }
+      else if (0==strcmp(name, "syscr:")) {
+        calls = value;
+      }
+    }
+    fclose(fp);
+  }
+}
+
+
+// what a child of 'srclocBenchMode' sends back
+struct SrclocBenchResult {
+  double secs;          // lexing and decoding
+  long bytes, calls;    // read by then
+  uint32_t crc;         // of every token's decoded location
+};
+
+// in a child process, so that SourceLocManager starts with no files,
+// lex each input with the manager taking the lexer's line scans or,
+// without 'scanned', not, then decode the last token's location, as
+// a report of an error at the end of the file would, which has the
+// manager build the file's line index
+static bool srclocBenchMode(bool scanned, BenchContext &ctx,
+                            SrclocBenchResult &result)
+{
+  return inChild(result, [&](SrclocBenchResult &r) {
+    SourceLocManager *mgr = SourceLocManager::instance();
+    mgr->acceptLineScans = scanned;
+
+    std::vector<std::unique_ptr<StringTable>> strTables;
+    std::vector<std::unique_ptr<Lexer2>> lexers;
+
+    long bytes0, calls0;
+    readCounts(bytes0, calls0);
+    Clock::time_point start = Clock::now();
+    for (char const *fname : ctx.fnames) {
+      strTables.emplace_back(new StringTable);
+      lexers.emplace_back(new Lexer2(ctx.lang, *strTables.back()));
+      if (!lexNamedFile(*lexers.back(), fname)) {
+        std::cout << fname << ": lexical error\n";
+        return false;
+      }
+
+      // the EOF token's location is static, so the last location in
+      // the file is the one before it
+      std::deque<Lexer2Token> const &tokens = lexers.back()->tokens;
+      for (auto it = tokens.rbegin(); it != tokens.rend(); ++it) {
+        if (!SourceLocManager::isStatic(it->loc)) {
+          mgr->getLine(it->loc);
+          break;
+        }
+      }
+    }
+    r.secs = std::chrono::duration<double>(Clock::now() - start).count();
+    readCounts(r.bytes, r.calls);
+    r.bytes -= bytes0;
+    r.calls -= calls0;
+
+    string text;
+    for (auto &lexer : lexers) {
+      for (Lexer2Token const &tok : lexer->tokens) {
+        text += mgr->getString(tok.loc);
+      }
+    }
+    r.crc = crc32((unsigned char const*)text.data(), text.length());
+    return true;
+  });
+}
+
+
+// building SourceLocManager's line index from the text the lexer
+// reads (SourceLocManager::scanLines) against reading each file
+// again for it, reporting the bytes read and read calls made
+static int srclocBench(BenchContext &ctx)
+{
+  int files = ctx.fnames.size();
+
+  // read each file again for its index, then index it as it's lexed
+  char const *names[2] = { "reread", "scanned" };
+  SrclocBenchResult best[2];
+  for (int i=0; i < ctx.iters; i++) {
+    for (int m=0; m < 2; m++) {
+      SrclocBenchResult r;
+      if (!srclocBenchMode(m == 1 /*scanned*/, ctx, r)) {
+        return 4;
+      }
+      if (i == 0 || r.secs < best[m].secs) {
+        best[m] = r;
+      }
+    }
+  }
+
+  for (int m=0; m < 2; m++) {
+    std::cout << names[m] << ": " << files << " file(s), "
+              << best[m].secs * 1000 << " ms, "
+              << best[m].bytes << " bytes in "
+              << best[m].calls << " read calls; per file "
+              << best[m].secs * 1000 / files << " ms, "
+              << best[m].bytes / files << " bytes, "
+              << best[m].calls / files << " read calls\n";
+  }
+  std::cout << "saved per file: "
+            << (best[0].secs - best[1].secs) * 1000 / files << " ms, "
+            << (best[0].bytes - best[1].bytes) / files << " bytes, "
+            << (best[0].calls - best[1].calls) / files << " read calls\n";
+
+  if (best[0].crc != best[1].crc) {
+    std::cout << "locations decode differently when scanned\n";
+    return 4;
+  }
+  return 0;
+}
+
+
+// ------------------------ benchmark table ------------------------
+struct Benchmark {
+  char const *flag;
+  char const *arg;              // argument taken before the options, or NULL
+  bool parses;                  // lex the inputs up front, into 'jobs'
+  int (*run)(BenchContext &ctx);
+  char const *description;
+};
+
+static Benchmark const benchmarks[] = {
+  { "-gssbench", NULL, true, gssBench,
+    "GSS sibling links from the heap, then from a slab arena" },
+  { "-tokbench", NULL, true, tokenBench,
+    "tokens handed to the parser one at a time, then in batches" },
+  { "-dirbench", NULL, true, directBench,
+    "parse with the tables, then with the directly-coded parser" },
+  { "-tabbench", "tables-file", true, tableBench,
+    "compiled-in tables against the same tables mapped from a file" },
+  { "-altbench", "tables-file", true, altTablesBench,
+    "compiled-in tables against other tables for the grammar" },
+  { "-profile", "profile-file", true, profileBench,
+    "count table lookups, for elkhound -profile" },
+  { "-lexbench", NULL, false, lexBench,
+    "keyword classification by scanning, then by interned spelling" },
+  { "-mapbench", NULL, false, mapBench,
+    "lexing read inputs, then mapped inputs" },
+  { "-streambench", NULL, false, streamBench,
+    "lexing whole files before parsing, then as the parser reads" },
+  { "-srclocbench", NULL, false, srclocBench,
+    "line indexes built by reading files again, then while lexing" },
+};
+
+
+static void benchList(std::ostream &os)
+{
+  os << "  benchmarks:\n";
+  for (Benchmark const &b : benchmarks) {
+    os << fmt::format("    {:<13} {:<13} {}\n",
+                      b.flag, b.arg? b.arg : "", b.description);
+  }
+}
+
+
+// run 'b', given the program name and then the arguments after its
+// flag; returns a process exit code
+static int runBenchmark(Benchmark const &b, MTStressClient &client,
+                        ParseTables const *tables, int argc, char **argv)
+{
+  char const *progName = argv[0];
+  BenchContext ctx(client, tables);
+
+  bool usable = true;
+  if (b.arg) {
+    if (argc >= 2) {
+      ctx.arg = argv[1];
+      argv[1] = argv[0];
+      argc--;
+      argv++;
+    }
+    else {
+      usable = false;
+    }
+  }
+
+  while (usable && argc >= 2) {
+    if (traceProcessArg(argc, argv)) {
+      continue;
+    }
+    else if (0==strcmp(argv[1], "-iters") && argc >= 3) {
+      ctx.iters = atoi(argv[2]);
+      argc -= 2;
+      argv += 2;
+    }
+    else {
+      break;     // didn't find any more options
+    }
+  }
+  for (int i=1; i < argc; i++) {
+    ctx.fnames.push_back(argv[i]);
+  }
+
+  if (!usable || ctx.fnames.empty() || ctx.iters < 1) {
+    std::cout << "usage: " << progName << " " << b.flag
+              << (b.arg? " " : "") << (b.arg? b.arg : "")
+              << " [options] input-file...\n"
+      "  " << b.description << "\n"
+      "  options:\n"
+      "    -tr <sys>:      turn on tracing for the named subsystem\n"
+      "    -iters <n>:     process each input <n> times per mode (default 10)\n";
+    return 2;
+  }
+
+  // lex everything up front, so only the parser is measured
+  if (b.parses) {
+    for (char const *fname : ctx.fnames) {
+      ctx.jobs.emplace_back(new StressJob(fname, ctx.lang));
+      if (!lexNamedFile(ctx.jobs.back()->lexer2, fname)) {
+        return 2;
+      }
+    }
+  }
+
+  return b.run(ctx);
+}
+
+
+int mtBenchMain(MTStressClient &client, ParseTables const *tables,
+                int argc, char **argv)
+{
+  if (argc >= 2) {
+    for (Benchmark const &b : benchmarks) {
+      if (0==strcmp(argv[1], b.flag)) {
+        // drop the flag, keeping the program name
+        argv[1] = argv[0];
+        return runBenchmark(b, client, tables, argc-1, argv+1);
+      }
+    }
+  }
+  return mtStressMain(client, tables, argc, argv);
+}
@@ -0,0 +1,41 @@
+// mtbench.h            see license.txt for copyright and terms of use
+// concurrent parsing stress test and parser benchmarks for the C
+// and C++ grammars, shared by cparsemt and cc2mt
+
+#ifndef MTBENCH_H
+#define MTBENCH_H
+
+#include "useract.h"      // SemanticValue, UserActions
+
+#include <iostream>       // std::ostream
+
+class ParseTables;        // parsetables.h
+class StringTable;        // strtable.h
+class CCLang;             // cc_lang.h
+
+
+// the grammar-specific half of the stress test and the benchmarks
+class MTStressClient {
+public:
+  virtual ~MTStressClient();
+
+  // make fresh user actions for one parse; this is called on the
+  // parsing thread, and the result is deleted when the parse is done
+  virtual UserActions *makeUserActions(StringTable &strTable, CCLang &lang) = 0;
+
+  // render a parse result; two parses are deemed to agree iff their
+  // renderings are identical; this is only called on the main thread
+  virtual void printResult(std::ostream &os, SemanticValue treeTop) = 0;
+};
+
+
+// when argv[1] names a benchmark (run with no arguments for the
+// list), run that benchmark on the remaining arguments; otherwise,
+// lex every input file, parse each once on a single thread to get
+// reference results, then parse them all again on several threads
+// sharing 'tables', and compare; returns a process exit code
+int mtBenchMain(MTStressClient &client, ParseTables const *tables,
+                int argc, char **argv);
+
+
+#endif // MTBENCH_H
@@ -0,0 +1,39 @@
+// mtmain.cc            see license.txt for copyright and terms of use
+// stress test: the C parser running on several threads at once;
+// or, with a benchmark flag, one of the benchmarks (see mtbench.h)
+
+#include "mtbench.h"      // mtBenchMain, MTStressClient
+#include "lexer2.h"       // Lexer2Token
+#include "cc_lang.h"      // CCLang
+#include "c.ast.gen.h"    // TranslationUnit
+#include "parsetables.h"  // ParseTables
+#include "c.gr.gen.h"     // CParse
+
+#include <memory>         // std::unique_ptr
+
+
+// no bison-parser present, so need to define this
+Lexer2Token const *yylval = NULL;
+
+
+class CParseStress : public MTStressClient {
+public:
+  virtual UserActions *makeUserActions(StringTable &strTable, CCLang &lang)
+    { return new CParse(strTable, lang); }
+
+  virtual void printResult(std::ostream &os, SemanticValue treeTop)
+    { ((TranslationUnit*)treeTop)->debugPrint(os, 0); }
+};
+
+
+int main(int argc, char **argv)
+{
+  // the tables don't depend on the context object they're made from
+  StringTable strTable;
+  CCLang lang;
+  std::unique_ptr<UserActions> user(new CParse(strTable, lang));
+  std::unique_ptr<ParseTables> tables(user->makeTables());
+
+  CParseStress client;
+  return mtBenchMain(client, tables.get(), argc, argv);
+}
@@ -5,8 +5,12 @@
 #include "glr.h"          // toplevelParse
 #include "trace.h"        // traceProcessArg
 #include "syserr.h"       // xsyserror
+#include "autofile.h"     // MappedFile
 
+#include <memory>         // std::unique_ptr
 #include <stdlib.h>       // exit
+#include <string.h>       // strcmp
+#include <stdio.h>        // fopen
 
 
 // ---------------------- ParseTree --------------------
@@ -30,15 +34,28 @@ ParseTreeAndTokens::~ParseTreeAndTokens()
 
 
 // ---------------------- other support funcs ------------------
-// process the input file, and yield a parse graph
-bool glrParseNamedFile(GLR &glr, Lexer2 &lexer2, SemanticValue &treeTop,
-                       char const *inputFname)
+// run both lexer phases over the input file, leaving the tokens
+// in 'lexer2'; false on error
+bool lexNamedFile(Lexer2 &lexer2, char const *inputFname)
+{
+  return lexNamedFile(lexer2, inputFname, tracingSys("mapInput"));
+}
+
+bool lexNamedFile(Lexer2 &lexer2, char const *inputFname, bool mapInput)
 {
   // do first phase lexer
   traceProgress() << "lexical analysis...\n";
   traceProgress(2) << "lexical analysis stage 1...\n";
   Lexer1 lexer1(inputFname);
-  {
+
+  // the L1 tokens point into this, so it has to last until the
+  // second phase is done with them
+  std::unique_ptr<MappedFile> mapping;
+  if (mapInput) {
+    mapping.reset(new MappedFile(inputFname));
+    lexer1_lex(lexer1, mapping->text());
+  }
+  else {
     FILE *input = fopen(inputFname, "r");
     if (!input) {
       xsyserror("fopen", inputFname);
@@ -46,16 +63,74 @@ bool glrParseNamedFile(GLR &glr, Lexer2 &lexer2, SemanticValue &treeTop,
 
     lexer1_lex(lexer1, input);
     fclose(input);
+  }
 
-    if (lexer1.errors > 0) {
-      printf("L1: %d error(s)\n", lexer1.errors);
-      return false;
-    }
+  if (lexer1.errors > 0) {
+    printf("L1: %d error(s)\n", lexer1.errors);
+    return false;
   }
 
   // do second phase lexer
   traceProgress(2) << "lexical analysis stage 2...\n";
   lexer2_lex(lexer2, lexer1, inputFname);
+  return true;
+}
+
+
+// parse the input file while lexing it (see Lexer2::beginStreaming),
+// so only a batch or so of tokens is in memory at once
+bool glrParseStreamedFile(GLR &glr, Lexer2 &lexer2, SemanticValue &treeTop,
+                          char const *inputFname)
+{
+  Lexer1 lexer1(inputFname);
+  std::unique_ptr<MappedFile> mapping;
+  FILE *input = NULL;
+  if (tracingSys("mapInput")) {
+    mapping.reset(new MappedFile(inputFname));
+    lexer1_beginStream(lexer1, mapping->text());
+  }
+  else {
+    input = fopen(inputFname, "r");
+    if (!input) {
+      xsyserror("fopen", inputFname);
+    }
+    lexer1_beginStream(lexer1, input);
+  }
+
+  // 'lexer1' goes away on return, so 'lexer2' has to let go of it
+  // even if the parse stops early or throws
+  struct StreamScope {
+    Lexer2 &lexer2;
+    ~StreamScope() { lexer2.endStreaming(); }
+  } streamScope = { lexer2 };
+
+  traceProgress() << "lexical analysis and parsing...\n";
+  lexer2.beginStreaming(lexer1);
+  bool ret = glr.glrParse(lexer2, treeTop);
+  if (input) {
+    fclose(input);
+  }
+
+  // 'lexer2' has already reported these, when 'lexer1' reached the
+  // end of its input
+  if (lexer2.sourceErrors > 0) {
+    return false;
+  }
+  return ret;
+}
+
+
+// process the input file, and yield a parse graph
+bool glrParseNamedFile(GLR &glr, Lexer2 &lexer2, SemanticValue &treeTop,
+                       char const *inputFname)
+{
+  if (tracingSys("stream")) {
+    return glrParseStreamedFile(glr, lexer2, treeTop, inputFname);
+  }
+
+  if (!lexNamedFile(lexer2, inputFname)) {
+    return false;
+  }
 
   // parsing itself
   lexer2.beginReading();
@@ -141,6 +216,8 @@ char *processArgs(int argc, char **argv, char const *additionalInfo) {
       "    ambiguities     print ambiguities encountered during parsing\n"
       "    conflict        SLR(1) shift/reduce conflicts (fork points)\n"
       "    itemsets        print the sets-of-items DFA\n"
+      "    stream          lex the input as the parser reads it\n"
+      "    mapInput        map the input into memory instead of reading it\n"
       "    ... the complete list is in parsgen.txt ...\n"
          << (additionalInfo? additionalInfo : "");
     exit(argc==1? 0 : 2);    // error if any args supplied
@@ -13,6 +13,7 @@
 #include "useract.h"      // SemanticValue, UserAction
 
 class ParseTables;
+class GLR;
 
 
 // ----------------- helpers for analysis drivers ---------------
@@ -46,6 +47,19 @@ public:
 
 bool toplevelParse(ParseTreeAndTokens &ptree, char const *inputFname);
 
+// parse the named file with 'glr', lexing it as the parser reads
+// rather than all first (the 'stream' tracing flag makes
+// 'toplevelParse' do this); false on error
+bool glrParseStreamedFile(GLR &glr, Lexer2 &lexer2, SemanticValue &treeTop,
+                          char const *inputFname);
+
+// run both lexer phases over the named file, leaving the tokens in
+// 'lexer2' for a later parse; false on error; with 'mapInput' (by
+// default, the 'mapInput' tracing flag), the file is mapped rather
+// than read, and the first phase's tokens aren't copied
+bool lexNamedFile(Lexer2 &lexer2, char const *inputFname);
+bool lexNamedFile(Lexer2 &lexer2, char const *inputFname, bool mapInput);
+
 char *processArgs(int argc, char **argv, char const *additionalInfo = NULL);
 
 void maybeUseTrivialActions(ParseTreeAndTokens &ptree);
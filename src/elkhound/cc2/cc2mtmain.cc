@@ -0,0 +1,39 @@
+// cc2mtmain.cc            see license.txt for copyright and terms of use
+// stress test: cc2 running on several threads at once;
+// or, with a benchmark flag, one of the benchmarks (see mtbench.h)
+
+#include "mtbench.h"      // mtBenchMain, MTStressClient
+#include "lexer2.h"       // Lexer2Token
+#include "ptreenode.h"    // PTreeNode
+#include "parsetables.h"  // ParseTables
+#include "cc2.gr.gen.h"   // CC2
+
+#include <memory>         // std::unique_ptr
+
+
+// no bison-parser present, so need to define this
+Lexer2Token const *yylval = NULL;
+
+
+class CC2Stress : public MTStressClient {
+public:
+  virtual UserActions *makeUserActions(StringTable &, CCLang &)
+    { return new CC2; }
+
+  virtual void printResult(std::ostream &os, SemanticValue treeTop)
+  {
+    PTreeNode *node = (PTreeNode*)treeTop;
+    os << "number of parses: " << node->countTrees() << std::endl;
+    node->printTree(os);
+  }
+};
+
+
+int main(int argc, char **argv)
+{
+  std::unique_ptr<UserActions> user(new CC2);
+  std::unique_ptr<ParseTables> tables(user->makeTables());
+
+  CC2Stress client;
+  return mtBenchMain(client, tables.get(), argc, argv);
+}
@@ -0,0 +1,52 @@
+// directlr.cc            see license.txt for copyright and terms of use
+// code for directlr.h
+
+#include "directlr.h"      // this module
+
+#include <string.h>        // memcpy
+
+
+DirectLRStack::DirectLRStack()
+  : entries(new Entry[64]),
+    length(0),
+    capacity(64),
+    column(0)
+{}
+
+DirectLRStack::~DirectLRStack()
+{
+  delete[] entries;
+}
+
+
+void DirectLRStack::reset(StateId startState)
+{
+  length = 0;
+  column = 0;
+  push(startState, NULL_SVAL, SL_UNKNOWN);
+}
+
+
+void DirectLRStack::grow()
+{
+  int n = length;
+  resize(capacity * 2);
+  length = n;
+}
+
+
+void DirectLRStack::resize(int n)
+{
+  if (n > capacity) {
+    int newCapacity = capacity;
+    while (newCapacity < n) {
+      newCapacity *= 2;
+    }
+    Entry *newEntries = new Entry[newCapacity];
+    memcpy(newEntries, entries, length * sizeof(Entry));
+    delete[] entries;
+    entries = newEntries;
+    capacity = newCapacity;
+  }
+  length = n;
+}
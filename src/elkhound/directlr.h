@@ -0,0 +1,118 @@
+// directlr.h            see license.txt for copyright and terms of use
+// runtime support for the directly-coded LR parsers that elkhound
+// emits with -direct
+
+// A directly-coded parser is an ordinary deterministic LR parser
+// whose states are compiled into a 'switch' instead of being looked
+// up in the ParseTables, and whose reduction actions are inlined
+// rather than dispatched through 'doReductionAction'.  It keeps its
+// parse stack in a DirectLRStack.  When it reaches a state where the
+// lookahead has no single action (a conflict, or an error), it
+// returns DP_STUCK, and GLR::glrParse turns the stack into a GSS and
+// carries on with the GLR algorithm.  Once the GLR algorithm is down
+// to one parser whose stack is linear again, the stack is turned
+// back into a DirectLRStack and the directly-coded parser resumes.
+
+#ifndef DIRECTLR_H
+#define DIRECTLR_H
+
+#include "parsetables.h"   // StateId
+#include "useract.h"       // SemanticValue
+#include "srcloc.h"        // SourceLoc
+
+
+// result of a UserActions::DirectParseFunc
+enum DirectParseResult {
+  DP_DONE,                 // parse finished; 'treeTop' has the result
+  DP_STUCK,                // current token has no unique action
+  DP_CANCELLED,            // a 'keep' function rejected a reduction
+};
+
+
+// the parse stack of a directly-coded parser
+class DirectLRStack {
+public:      // types
+  // one stack entry; these correspond to the stack nodes and their
+  // 'firstSib' links in the GSS
+  struct Entry {
+    // LR state after the symbol was shifted
+    StateId state;
+
+    // token column when the symbol was shifted or reduced to; the
+    // GLR algorithm needs this when it takes over (see
+    // StackNode::column)
+    int column;
+
+    // semantic value of the symbol (owner), and the location of its
+    // left edge; unused in the bottom entry
+    SemanticValue sval;
+    SourceLoc loc;
+  };
+
+private:     // data
+  Entry *entries;          // (owner) array of 'capacity' entries
+  int length;              // # of entries in use
+  int capacity;
+
+public:      // data
+  // column of the most recently shifted token
+  int column;
+
+private:     // funcs
+  void grow();
+
+public:      // funcs
+  DirectLRStack();
+  ~DirectLRStack();
+
+  DirectLRStack(DirectLRStack const &) = delete;
+  DirectLRStack &operator=(DirectLRStack const &) = delete;
+
+  // start over with just the start state
+  void reset(StateId startState);
+
+  int size() const { return length; }
+  Entry const &operator[] (int i) const { return entries[i]; }
+  Entry &operator[] (int i) { return entries[i]; }
+
+  StateId topState() const { return entries[length-1].state; }
+
+  void push(StateId state, SemanticValue sval, SourceLoc loc)
+  {
+    if (length == capacity) {
+      grow();
+    }
+    Entry &e = entries[length++];
+    e.state = state;
+    e.column = column;
+    e.sval = sval;
+    e.loc = loc;
+  }
+
+  // pop 'n' entries, returning a pointer to the first (deepest) of
+  // them; it stays valid until the next 'push'
+  Entry *pop(int n)
+  {
+    length -= n;
+    return entries + length;
+  }
+
+  // location of the left edge of the 'n' entries at 'rhs': that of
+  // the leftmost one which has a location, or else 'dflt'
+  static SourceLoc leftEdge(Entry const *rhs, int n, SourceLoc dflt)
+  {
+    for (int i = n-1; i >= 0; i--) {
+      if (rhs[i].loc != SL_UNKNOWN) {
+        dflt = rhs[i].loc;
+      }
+    }
+    return dflt;
+  }
+
+  // set the length to 'n', growing the array if necessary; new
+  // entries are uninitialized
+  void resize(int n);
+};
+
+
+#endif // DIRECTLR_H
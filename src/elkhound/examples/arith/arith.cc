@@ -8,6 +8,10 @@
 #include "trace.h"     // traceAddSys
 
 #include <assert.h>    // assert
+#include <stdlib.h>    // atoi
+#include <string.h>    // strcmp
+#include <chrono>      // std::chrono
+#include <vector>      // std::vector
 #include <fmt/core.h>  // fmt::format
 
 
@@ -57,13 +61,104 @@ string ArithLexer::tokenKindDesc(int kind) const
 }
 
 
+// ------------------ ReplayLexer ------------------
+// plays back a token sequence recorded from 'lexer', so the same
+// input can be parsed again and again
+class ReplayLexer : public LexerInterface {
+public:
+  std::vector<int> types;
+  std::vector<SemanticValue> svals;
+  size_t next = 0;
+
+public:
+  // record tokens from 'lexer' through EOF
+  void record();
+
+  // position at the first token, ready for another parse
+  void rewind() { next = 0; nextToken(this); }
+
+  static void nextToken(ReplayLexer *ths);
+
+  // LexerInterface functions
+  virtual NextTokenFunc getTokenFunc() const
+    { return (NextTokenFunc)&ReplayLexer::nextToken; }
+  virtual string tokenDesc() const
+    { return toString((ArithTokenCodes)type); }
+  virtual string tokenKindDesc(int kind) const
+    { return toString((ArithTokenCodes)kind); }
+};
+
+void ReplayLexer::record()
+{
+  for (;;) {
+    types.push_back(lexer.type);
+    svals.push_back(lexer.sval);
+    if (lexer.type == TOK_EOF) {
+      break;
+    }
+    lexer.nextToken(&lexer);
+  }
+}
+
+/*static*/ void ReplayLexer::nextToken(ReplayLexer *ths)
+{
+  // the EOF token repeats if the parser asks for more
+  size_t i = ths->next < ths->types.size()? ths->next++ : ths->types.size()-1;
+  ths->type = ths->types[i];
+  ths->sval = ths->svals[i];
+}
+
+
+// ------------------ benchmark ------------------
+// per-parse cost of a tiny input, with and without reusing the
+// GLR object (the parse session) from one parse to the next
+static int benchmark(Arith *arith, ParseTables *tables, int iters)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  ReplayLexer replay;
+  replay.record();
+  printf("input: %d tokens, %d parses each\n",
+         (int)replay.types.size(), iters);
+
+  SemanticValue result = 0;
+  bool ok = true;
+
+  Clock::time_point start = Clock::now();
+  for (int i=0; i < iters; i++) {
+    GLR glr(arith, tables);
+    replay.rewind();
+    ok = glr.glrParse(replay, result) && ok;
+  }
+  double fresh = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+  start = Clock::now();
+  {
+    GLR glr(arith, tables);
+    for (int i=0; i < iters; i++) {
+      replay.rewind();
+      ok = glr.glrParse(replay, result) && ok;
+    }
+  }
+  double session = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+  if (!ok) {
+    printf("parse error\n");
+    return 2;
+  }
+
+  printf("result: %d\n", (int)result);
+  printf("new GLR per parse: %8.3f us/parse\n", fresh / iters);
+  printf("one GLR session:   %8.3f us/parse\n", session / iters);
+  return 0;
+}
+
+
 // --------------------- main ----------------------
 ArithLexer lexer;
 
 int main(int argc, char *argv[])
 {
-  (void)argv;
-
   // initialize lexer by grabbing first token
   lexer.nextToken(&lexer);
 
@@ -77,6 +172,10 @@ int main(int argc, char *argv[])
   // get tracing info from environment variable TRACE
   traceAddFromEnvVar();
 
+  if (argc == 3 && 0==strcmp(argv[1], "-bench")) {
+    return benchmark(arith, tables, atoi(argv[2]));
+  }
+
   if (argc == 1) {
     // start parsing
     GLR glr(arith, tables);
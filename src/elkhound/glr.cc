@@ -113,7 +113,9 @@
 #include "lexerint.h"    // LexerInterface
 #include "test.h"        // PVAL
 #include "cyctimer.h"    // CycleTimer
+#include "parseprof.h"   // ParseProfile
 
+#include <algorithm>     // std::fill_n, std::copy_n, std::push_heap
 #include <deque>         // std::deque
 #include <unordered_set> // std::unordered_set
 #include <stdio.h>       // FILE
@@ -134,7 +136,7 @@
 // TRSPARSE(stuff) traces <stuff> during debugging with -tr parse
 #if !defined(NDEBUG)
   #define IF_NDEBUG(stuff)
-  #define TRSPARSE(stuff) if (trParse) { trsParse << stuff << std::endl; }
+  #define TRSPARSE(stuff) if (trParse) { *trsParse << stuff << std::endl; }
   #define TRSPARSE_DECL(stuff) stuff
 #else
   #define IF_NDEBUG(stuff) stuff
@@ -168,16 +170,21 @@
   #define ACCOUNTING(stuff)
 #endif
 
-// some things we track..
-int parserMerges = 0;
-int computeDepthIters = 0;
-int totalExtracts = 0;
-int multipleDelayedExtracts = 0;
-
-// can turn this on to experiment.. but right now it
-// actually makes things slower.. (!)
-//#define USE_PARSER_INDEX
+// count a table lookup in the parse profile, if one is being made
+// (the mini-LR loop in 'innerGlrParse' decides this at compile time)
+static inline void profileAction(ParseProfile *profile, StateId state, int termId)
+{
+  if (profile) {
+    profile->countAction(state, termId);
+  }
+}
 
+static inline void profileGoto(ParseProfile *profile, StateId state, int nontermId)
+{
+  if (profile) {
+    profile->countGoto(state, nontermId);
+  }
+}
 
 // Note on inlining generally: Inlining functions is a very important
 // way to improve performance, in inner loops.  However it's easy to
@@ -195,22 +202,14 @@ int multipleDelayedExtracts = 0;
 
 
 // the transition to array-based implementations requires I specify
-// initial sizes
+// initial sizes (MAX_RHSLEN, which does *not* grow, is in glr.h)
 enum {
-  // this one does *not* grow as needed (at least not in the mini-LR core)
-  MAX_RHSLEN = 30,
-
-  // ----------
   // the settings below here are for initial sizes of growable arrays,
   // and it should be ok in terms of correctness to set them all to 1,
   // which may be a useful thing during debugging to verify
 
   // this one grows as needed
   TYPICAL_MAX_REDUCTION_PATHS = 5,
-
-  // this is the length to make arrays which hold rhsLen many items
-  // typically, but are growable
-  INITIAL_RHSLEN_SIZE = 10,
 };
 
 
@@ -281,7 +280,8 @@ void GLR::deallocateSemanticValue(SymbolId sym, SemanticValue sval)
 inline SiblingLink::SiblingLink(RCPtr<StackNode> s, SemanticValue sv
                                 SOURCELOCARG( SourceLoc L ) )
   : sib(std::move(s)), sval(sv)
-    SOURCELOCARG( loc(L) )
+    SOURCELOCARG( loc(L) ),
+    next(NULL)
 {
   YIELD_COUNT( yieldCount = 0; )
 }
@@ -291,12 +291,10 @@ SiblingLink::~SiblingLink()
 
 
 // ----------------------- StackNode -----------------------
-int StackNode::numStackNodesAllocd=0;
-int StackNode::maxStackNodesAllocd=0;
-
 
 StackNode::StackNode()
   : state(STATE_INVALID),
+    leftSiblings(NULL),
     firstSib(NULL, NULL_SVAL  SOURCELOCARG( SL_UNKNOWN ) ),
     referenceCount(0),
     determinDepth(0),
@@ -307,23 +305,29 @@ StackNode::StackNode()
 
 StackNode::~StackNode()
 {
-  // the interesting stuff happens in deinit()
+  // the interesting stuff happens in deinit(); but a node can be
+  // destroyed while still linked, when its pool is torn down
+  while (leftSiblings) {
+    SiblingLink *link = leftSiblings;
+    leftSiblings = link->next;
+    glr->freeSiblingLink(link);
+  }
 }
 
 
 inline void StackNode::init(StateId st, GLR *g)
 {
   state = st;
-  xassertdb(leftSiblings.empty());
+  xassertdb(!leftSiblings);
   xassertdb(hasZeroSiblings());
   referenceCount = 1;   // the node is going to be used somewhere!
   determinDepth = 1;    // 0 siblings now, so this node is unambiguous
   glr = g;
 
   #if DO_ACCOUNTING
-    numStackNodesAllocd++;
-    if (numStackNodesAllocd > maxStackNodesAllocd) {
-      maxStackNodesAllocd = numStackNodesAllocd;
+    g->numStackNodesAllocd++;
+    if (g->numStackNodesAllocd > g->maxStackNodesAllocd) {
+      g->maxStackNodesAllocd = g->numStackNodesAllocd;
     };
     //TRACE("nodes", "(!!!) init stack node: num=" << numStackNodesAllocd
     //            << ", max=" << maxStackNodesAllocd);
@@ -333,7 +337,7 @@ inline void StackNode::init(StateId st, GLR *g)
 inline void StackNode::decrementAllocCounter()
 {
   #if DO_ACCOUNTING
-    numStackNodesAllocd--;
+    glr->numStackNodesAllocd--;
     //TRACE("nodes", "(...) deinit stack node: num=" << numStackNodesAllocd
     //            << ", max=" << maxStackNodesAllocd);
   #endif
@@ -344,7 +348,7 @@ inline void StackNode::deinit()
   decrementAllocCounter();
 
   if (!unwinding()) {
-    xassert(numStackNodesAllocd >= 0);
+    xassert(glr->numStackNodesAllocd >= 0);
     xassert(referenceCount == 0);
   }
 
@@ -368,24 +372,22 @@ void StackNode::deallocSemanticValues()
     deallocateSemanticValue(getSymbolC(), glr->userAct, firstSib.sval);
     firstSib.sib.reset();
 
-    if (!leftSiblings.empty()) {
-      // the locally moved list ensures that if we ever recurse,
-      // the leftSiblings list won't be corrupted (this is not
-      // necessary, just a precaution);
-      // this can also be used to splice the entire list back
-      // into a list forming a pool of objects to reuse for
-      // memory locality
-      std::forward_list<SiblingLink> siblings = std::move(leftSiblings);
-      while (!siblings.empty()) {
-        deallocateSemanticValue(getSymbolC(), glr->userAct, siblings.front().sval);
-        siblings.pop_front();
-      }
+    // detaching the list first ensures that if we ever recurse,
+    // the leftSiblings list won't be corrupted (this is not
+    // necessary, just a precaution)
+    SiblingLink *siblings = leftSiblings;
+    leftSiblings = NULL;
+    while (siblings) {
+      SiblingLink *link = siblings;
+      siblings = link->next;
+      deallocateSemanticValue(getSymbolC(), glr->userAct, link->sval);
+      glr->freeSiblingLink(link);
     }
   }
   else {
     // firstSib should have held the first value, otherwise we
     // should have no other left siblings
-    xassertdb(leftSiblings.empty());
+    xassertdb(!leftSiblings);
   }
 }
 
@@ -445,8 +447,10 @@ SiblingLink *StackNode::
   // most likely will catch that when we use the stale info)
   determinDepth = 0;
 
-  leftSiblings.emplace_front(std::move(leftSib), sval  SOURCELOCARG(loc));
-  return &leftSiblings.front();
+  SiblingLink *link = glr->allocSiblingLink(std::move(leftSib), sval  SOURCELOCARG(loc));
+  link->next = leftSiblings;
+  leftSiblings = link;
+  return link;
 }
 
 
@@ -480,23 +484,15 @@ SiblingLink *StackNode::getLinkTo(StackNode *another)
   }
 
   // check rest
-  for (auto& candidate : leftSiblings) {
-    if (candidate.sib == another) {
-      return &candidate;
+  for (SiblingLink *candidate = leftSiblings; candidate; candidate = candidate->next) {
+    if (candidate->sib == another) {
+      return candidate;
     }
   }
   return NULL;
 }
 
 
-STATICDEF void StackNode::printAllocStats()
-{
-  std::cout << "stack nodes: " << numStackNodesAllocd
-            << ", max stack nodes: " << maxStackNodesAllocd
-            << std::endl;
-}
-
-
 int StackNode::computeDeterminDepth() const
 {
   if (hasZeroSiblings()) {
@@ -522,7 +518,7 @@ inline void StackNode::checkLocalInvariants() const
 
 
 // ------------------------- GLR ---------------------------
-GLR::GLR(UserActions *user, ParseTables *t)
+GLR::GLR(UserActions *user, ParseTables const *t)
   : userAct(user),
     tables(t),
     lexerPtr(NULL),
@@ -530,18 +526,29 @@ GLR::GLR(UserActions *user, ParseTables *t)
     parserIndex(NULL),
     toPass(MAX_RHSLEN),
     prevTopmost(),
-    stackNodePool(NULL),
+    stackNodePool(new ObjectPool<StackNode>(30)),
+    linkArena(64),
     pathQueue(t),
     noisyFailedParse(true),
+    useLinkArena(true),
+    useDirectParser(true),
+    profile(NULL),
     trParse(tracingSys("parse")),
-    trsParse(trace("parse") << "parse tracing enabled\n"),
+    trsParse(NULL),
     detShift(0),
     detReduce(0),
     nondetShift(0),
     nondetReduce(0),
-    yieldThenMergeCt(0)
+    yieldThenMergeCt(0),
+    numStackNodesAllocd(0),
+    maxStackNodesAllocd(0),
+    parserMerges(0),
+    computeDepthIters(0),
+    numExtraLinks(0)
   // some fields (re-)initialized by 'clearAllStackNodes'
 {
+  trace("parse") << "parse tracing enabled\n";
+
   // originally I had this inside glrParse() itself, but that
   // made it 25% slower!  gcc register allocator again!
   if (tracingSys("glrConfig")) {
@@ -566,25 +573,6 @@ GLR::GLR(UserActions *user, ParseTables *t)
       }
     }
   #endif // USE_MINI_LR
-
-  // check that the parse tables' compression (if any) is the same
-  // as this core expects
-  configCheck("EEF compression", ENABLE_EEF_COMPRESSION, tables->eef_enabled());
-  configCheck("GCS compression", ENABLE_GCS_COMPRESSION, tables->gcs_enabled());
-  configCheck("GCS column compression", ENABLE_GCS_COLUMN_COMPRESSION, tables->gcsc_enabled());
-  configCheck("CRS compression", ENABLE_CRS_COMPRESSION, tables->crs_enabled());
-}
-
-void GLR::configCheck(char const *option, bool core, bool table)
-{
-  if (core != table) {
-    xfailure(fmt::format(
-      "The GLR parser core was compiled with {} {}, "
-      "but the parse tables generated by Elkhound have it {}",
-      option,
-      (core ? "enabled" : "disabled"),
-      (table ? "enabled" : "disabled")).c_str());
-  }
 }
 
 GLR::~GLR()
@@ -593,6 +581,11 @@ GLR::~GLR()
     delete[] parserIndex;
   }
 
+  // these hold nodes that belong to the pool
+  topmostParsers.clear();
+  prevTopmost.clear();
+  delete stackNodePool;
+
   // NOTE: must not delete 'tables' until after the 'decParserList'
   // calls above, because they refer to the tables!
 }
@@ -652,13 +645,6 @@ void GLR::printConfig() const
   printf("  allocated-node and parse action accounting: \t%s\n",
          ACCOUNTING(1+)0? "enabled" : "disabled *");
 
-  printf("  parser index: \t\t\t\t%s\n",
-         #ifdef USE_PARSER_INDEX
-           "enabled"
-         #else
-           "disabled *"
-         #endif
-         );
 
   // checking __OPTIMIZE__ is misleading if preprocessing is entirely
   // divorced from compilation proper, but I still think this printout
@@ -672,15 +658,31 @@ void GLR::printConfig() const
          #endif
          );
 
-  // at the moment, disabling compression makes it fastest
-  printf("  Error Entry Factoring (EEF): \t\t\t%s\n",
-         ENABLE_EEF_COMPRESSION? "enabled" : "disabled *");
-  printf("  Graph Coloring Scheme (GCS): \t\t\t%s\n",
-         ENABLE_GCS_COMPRESSION? "enabled" : "disabled *");
-  printf("  GCS for columns (GCSC): \t\t\t%s\n",
-         ENABLE_GCS_COLUMN_COMPRESSION? "enabled" : "disabled *");
-  printf("  Code Reduction Scheme (CRS): \t\t\t%s\n",
-         ENABLE_CRS_COMPRESSION? "enabled" : "disabled *");
+  // the compression is read from the tables, not compiled in
+  printf("  parse table compression (EEF, GCS, CRS, RDS): \t%s\n",
+         "per tables");
+}
+
+
+// the counters are per-GLR (not static) so that concurrent
+// parsers don't race on them
+void GLR::printAllocStats() const
+{
+  std::cout << "stack nodes: " << numStackNodesAllocd
+            << ", max stack nodes: " << maxStackNodesAllocd
+            << std::endl;
+  std::cout << "detShift=" << detShift
+            << ", detReduce=" << detReduce
+            << ", nondetShift=" << nondetShift
+            << ", nondetReduce=" << nondetReduce
+            << std::endl;
+  PVAL(parserMerges);
+  PVAL(computeDepthIters);
+  PVAL(yieldThenMergeCt);
+  std::cout << "extra sibling links: " << numExtraLinks
+            << ", link slabs: " << linkArena.numSlabs()
+            << ", slabs reclaimed: " << linkArena.reclaimedSlabs()
+            << std::endl;
 }
 
 
@@ -698,6 +700,29 @@ SemanticValue GLR::grabTopSval(StackNode *node)
 }
 
 
+inline SiblingLink *GLR::allocSiblingLink(RCPtr<StackNode> sib, SemanticValue sval
+                                          SOURCELOCARG( SourceLoc loc ) )
+{
+  ACCOUNTING( numExtraLinks++; )
+  if (useLinkArena) {
+    return linkArena.alloc(std::move(sib), sval  SOURCELOCARG(loc));
+  }
+  else {
+    return new SiblingLink(std::move(sib), sval  SOURCELOCARG(loc));
+  }
+}
+
+inline void GLR::freeSiblingLink(SiblingLink *link)
+{
+  if (useLinkArena) {
+    linkArena.dealloc(link);
+  }
+  else {
+    delete link;
+  }
+}
+
+
 inline RCPtr<StackNode> GLR::makeStackNode(StateId state)
 {
   StackNode* snRaw = stackNodePool->alloc();
@@ -714,41 +739,69 @@ inline void GLR::addTopmostParser(RCPtr<StackNode> parser)
 {
   parser->checkLocalInvariants();
 
-  topmostParsers.push_back(std::move(parser));
-
-  // I implemented this index, and then discovered it made no difference
-  // (actually, slight degradation) in performance; so for now it will
-  // be an optional design choice, off by default
-  #ifdef USE_PARSER_INDEX
-    // fill in the state id index; if the assertion here ever fails, it
-    // means there are more than 255 active parsers; either the grammer
-    // is highly ambiguous by mistake, or else ParserIndexEntry needs to
-    // be re-typedef'd to something bigger than 'char'
-    int index = topmostParsers.length()-1;   // index just used
-    xassert(index < INDEX_NO_PARSER);
+  // at most one topmost parser per state
+  xassertdb(!findTopmostParser(parser->state));
 
-    xassert(parserIndex[parser->state] == INDEX_NO_PARSER);
-    parserIndex[parser->state] = index;
-  #endif // USE_PARSER_INDEX
+  parserIndex[parser->state] = topmostParsers.size();
+  topmostParsers.push_back(std::move(parser));
 }
 
 
 void GLR::buildParserIndex()
 {
-  if (parserIndex) {
-    delete[] parserIndex;
-  }
-  parserIndex = new ParserIndexEntry[tables->getNumStates()];
-  {
-    for (int i=0; i < tables->getNumStates(); i++) {
-      parserIndex[i] = INDEX_NO_PARSER;
-    }
+  // the number of states never changes, so the index is allocated
+  // once per session; entries left over from a previous parse (or
+  // token) are harmless, since findTopmostParser checks them, but
+  // start out with defined values anyway
+  if (!parserIndex) {
+    parserIndex = new ParserIndexEntry[tables->getNumStates()];
+    std::fill_n(parserIndex, tables->getNumStates(), 0);
   }
 }
 
 
+// throw away the stack node pool, along with any nodes still in it,
+// and start a new one
+void GLR::resetStackNodePool()
+{
+  // the pool's dtor destroys its nodes without going through
+  // 'dealloc', so it's fine for leftover nodes to refer to each other
+  delete stackNodePool;
+  stackNodePool = new ObjectPool<StackNode>(30);
+}
+
+
+void GLR::releaseSessionStorage()
+{
+  resetStackNodePool();
+
+  delete[] parserIndex;
+  parserIndex = NULL;
+
+  topmostParsers.shrink_to_fit();
+  prevTopmost.shrink_to_fit();
+}
+
+
+// points 'trsParse' at this thread's trace("parse") stream for as
+// long as it's in scope, and on the way out, whether the parse
+// returns or throws, clears whatever error state the parse left on
+// the stream and puts the previous pointer back
+class TraceStreamScope {
+  std::ostream *&slot;
+  std::ostream *prev;
+
+public:
+  explicit TraceStreamScope(std::ostream *&s)
+    : slot(s), prev(s) { slot = &trace("parse"); }
+  ~TraceStreamScope() { slot->clear(); slot = prev; }
+};
+
+
 bool GLR::glrParse(LexerInterface &lexer, SemanticValue &treeTop)
 {
+  TraceStreamScope traceScope(trsParse);
+
   #if !ACTION_TRACE
     // tell the user why "-tr action" doesn't do anything, if
     // they specified that
@@ -773,17 +826,37 @@ bool GLR::glrParse(LexerInterface &lexer, SemanticValue &treeTop)
   // and I'd like as little code as possible being #ifdef'd)
   buildParserIndex();
 
+  // use the directly-coded parser if there is one; it doesn't
+  // produce any of the trace output
+  UserActions::DirectParseFunc directParse = NULL;
+  if (useDirectParser && !profile && !trParse &&
+      !(ACTION_TRACE && tracingSys("action"))) {
+    directParse = userAct->getDirectParser(tables);
+  }
+
   // call the inner parser core, which is a static member function
   bool ret;
   {
     //CycleTimer timer;
-    ret = innerGlrParse(*this, lexer, treeTop);
+    if (directParse) {
+      ret = directGlrParse(directParse, lexer, treeTop);
+    }
+    else {
+      ret = innerGlrParseForTables(lexer, treeTop, NULL /*direct*/) == IR_DONE;
+    }
     //traceProgress() << "done parsing (" << timer.elapsed() << ")\n";
   }
 
-  stackNodePool = NULL;
-  // At this point, smart pointers can't do much.
-  // The stack node pool pointer is gone now.
+  // a successful parse has already let go of its stack nodes; after a
+  // parse error, the surviving parsers are released here
+  topmostParsers.clear();
+  prevTopmost.clear();
+
+  // any nodes still allocated now are on reference cycles (see
+  // 'clearAllStackNodes'), so the pool can't be reused as is
+  if (stackNodePool->size() != 0) {
+    resetStackNodePool();
+  }
 
   if (!ret) {
     lexerPtr = NULL;
@@ -794,18 +867,7 @@ bool GLR::glrParse(LexerInterface &lexer, SemanticValue &treeTop)
   // so I'll just set ELKHOUND_DEBUG in my .bashrc
   if (getenv("ELKHOUND_DEBUG")) {
     #if DO_ACCOUNTING
-      StackNode::printAllocStats();
-      std::cout << "detShift=" << detShift
-                << ", detReduce=" << detReduce
-                << ", nondetShift=" << nondetShift
-                << ", nondetReduce=" << nondetReduce
-                << std::endl;
-      //PVAL(parserMerges);
-      PVAL(computeDepthIters);
-
-      PVAL(yieldThenMergeCt);
-      PVAL(totalExtracts);
-      PVAL(multipleDelayedExtracts);
+      printAllocStats();
     #endif
   }
 
@@ -814,12 +876,157 @@ bool GLR::glrParse(LexerInterface &lexer, SemanticValue &treeTop)
 }
 
 
+// alternate between the directly-coded parser, for as long as it
+// can go on, and the GLR core for the stretches it can't handle
+bool GLR::directGlrParse(UserActions::DirectParseFunc directParse,
+                         LexerInterface &lexer, SemanticValue &treeTop)
+{
+  directStack.reset(tables->startState);
+  for (;;) {
+    switch (directParse(userAct, directStack, lexer, treeTop)) {
+      case DP_DONE:
+        return true;
+
+      case DP_CANCELLED:
+        // like the mini-LR core, report it as a parse error
+        printParseErrorMessage(directStack.topState());
+        return false;
+
+      case DP_STUCK:
+        break;
+
+      default:
+        xfailure("bad DirectParseResult");
+    }
+
+    switch (innerGlrParseForTables(lexer, treeTop, &directStack)) {
+      case IR_ERROR:
+        return false;
+
+      case IR_DONE:
+        return true;
+
+      case IR_RESUME:
+        break;
+    }
+  }
+}
+
+
+// turn the directly-coded parser's stack into a linear GSS, and make
+// its top the only topmost parser; the semantic values move along
+void GLR::stackFromDirect(DirectLRStack &direct)
+{
+  RCPtr<StackNode> node;
+  for (int i=0; i < direct.size(); i++) {
+    DirectLRStack::Entry const &e = direct[i];
+    RCPtr<StackNode> next = makeStackNode(e.state);
+    NODE_COLUMN( next->column = e.column; )
+    if (node) {
+      next->addFirstSiblingLink(std::move(node), e.sval  SOURCELOCARG(e.loc));
+    }
+    node = std::move(next);
+  }
+  addTopmostParser(std::move(node));
+
+  NODE_COLUMN( globalNodeColumn = direct.column; )
+  direct.resize(0);
+}
+
+
+// the reverse of 'stackFromDirect': if there is just one topmost
+// parser, and its stack is linear all the way to the bottom, then
+// move it into 'direct' and return true; otherwise, return false
+// and leave everything as it was
+bool GLR::stackToDirect(DirectLRStack &direct)
+{
+  if (topmostParsers.size() != 1) {
+    return false;
+  }
+
+  // measure the stack, checking that it's linear
+  int depth = 1;
+  StackNode *node = topmostParsers[0].get();
+  for (; !node->hasZeroSiblings(); node = node->firstSib.sib.get()) {
+    if (node->hasMultipleSiblings()) {
+      return false;
+    }
+    depth++;
+  }
+
+  // copy it, top down; the links give up their values
+  direct.resize(depth);
+  node = topmostParsers[0].get();
+  for (int i = depth-1; i >= 0; i--) {
+    DirectLRStack::Entry &e = direct[i];
+    e.state = node->state;
+    NODE_COLUMN( e.column = node->column; )
+    e.sval = node->firstSib.sval;
+    e.loc = SOURCELOC( node->firstSib.loc ) NOSOURCELOC( SL_UNKNOWN );
+    node->firstSib.sval = NULL_SVAL;
+    node = node->firstSib.sib.get();
+  }
+  NODE_COLUMN( direct.column = globalNodeColumn; )
+
+  topmostParsers.clear();
+  prevTopmost.clear();
+  return true;
+}
+
+
+// run the parser core instantiated for the layout of 'tables'; the
+// choice is made once per call, not per token
+GLR::InnerResult GLR::innerGlrParseForTables(LexerInterface &lexer,
+                                             SemanticValue &treeTop,
+                                             DirectLRStack *direct)
+{
+  // one instance per layout 'compress' can make, with and without CRS
+  #define LAYOUT_CASES(crs)                                     \
+    LAYOUT_CASE(crs)                                            \
+    LAYOUT_CASE(crs | TL_EEF)                                   \
+    LAYOUT_CASE(crs | TL_EEF | TL_GCS)                          \
+    LAYOUT_CASE(crs | TL_EEF | TL_GCS | TL_GCSC)                \
+    LAYOUT_CASE(crs | TL_RDS)                                   \
+    LAYOUT_CASE(crs | TL_RDS | TL_EEF)
+  #define LAYOUT_CASE(l) \
+    case (l): return innerGlrParse<(l), false>(*this, lexer, treeTop, direct);
+
+  // profiling gets one instance of its own, which looks the layout up
+  // as it goes, so the others needn't test for it in the loop
+  if (profile) {
+    return innerGlrParse<TL_DYNAMIC, true>(*this, lexer, treeTop, direct);
+  }
+
+  switch (tables->layout()) {
+    LAYOUT_CASES(0)
+    LAYOUT_CASES(TL_CRS)
+
+    default:
+      // not one 'compress' makes; look the layout up as we go
+      return innerGlrParse<TL_DYNAMIC, false>(*this, lexer, treeTop, direct);
+  }
+
+  #undef LAYOUT_CASE
+  #undef LAYOUT_CASES
+}
+
+
 // This function is the core of the parser, and its performance is
 // critical to the end-to-end performance of the whole system.  It is
 // a static member so the accesses to 'glr' (aka 'this') will be
-// visible.
-STATICDEF bool GLR
-  ::innerGlrParse(GLR &glr, LexerInterface &lexer, SemanticValue &treeTop)
+// visible.  It is instantiated for each table layout 'L', so the
+// table lookups compile to just what that layout needs, and with
+// 'PROFILE' true when the lookups are to be counted in 'glr.profile'.
+//
+// When 'direct' is not NULL, it is the stack of the directly-coded
+// parser, which got stuck on the current token.  Then, the parse
+// starts from that stack, and whenever a token has been dealt with
+// and the stack is linear again, it goes back to 'direct' and the
+// return value is IR_RESUME.
+template <int L, bool PROFILE>
+STATICDEF GLR::InnerResult GLR
+  ::innerGlrParse(GLR &glr, LexerInterface &lexer, SemanticValue &treeTop,
+                  DirectLRStack *direct)
 {
   #ifndef NDEBUG
     bool doDumpGSS = tracingSys("dumpGSS");
@@ -828,7 +1035,8 @@ STATICDEF bool GLR
   // pull a bunch of things out of 'glr' so they'll be accessible from
   // the stack frame instead of having to indirect into the 'glr' object
   UserActions *userAct = glr.userAct;
-  ParseTables *tables = glr.tables;
+  ParseTables const *tables = glr.tables;
+  ParseProfile *profile = glr.profile;
   #if USE_MINI_LR
     std::vector<RCPtr<StackNode>> &topmostParsers = glr.topmostParsers;
   #endif
@@ -842,17 +1050,14 @@ STATICDEF bool GLR
     userAct->getReclassifier();
   #endif
 
-  // the stack node pool is a local variable of this function for
-  // fastest access by the mini-LR core; other parts of the algorihthm
-  // can access it using a pointer stored in the GLR class (caller
-  // nullifies this pointer afterward to prevent dangling references)
-  ObjectPool<StackNode> stackNodePool(30);
-  glr.stackNodePool = &stackNodePool;
-
   // create an initial ParseTop with grammar-initial-state,
-  // set active-parsers to contain just this
-  NODE_COLUMN( glr.globalNodeColumn = 0; )
-  {
+  // set active-parsers to contain just this; or take over where
+  // the directly-coded parser left off
+  if (direct) {
+    glr.stackFromDirect(*direct);
+  }
+  else {
+    NODE_COLUMN( glr.globalNodeColumn = 0; )
     RCPtr<StackNode> first = glr.makeStackNode(tables->startState);
     glr.addTopmostParser(std::move(first));
   }
@@ -882,7 +1087,7 @@ STATICDEF bool GLR
 
     // some debugging streams so the TRSPARSE etc. macros work
     bool trParse       = glr.trParse;
-    std::ostream &trsParse  = glr.trsParse;
+    std::ostream *trsParse  = glr.trsParse;
   #endif
   for (;;) {
     // debugging
@@ -938,22 +1143,25 @@ STATICDEF bool GLR
       RCPtr<StackNode> parser(std::move(topmostParsers[0]));
       xassertdb(parser->refCtIs(1));     // 'parser'
 
-      #if ENABLE_EEF_COMPRESSION
-        if (tables->actionEntryIsError(parser->state, lexer.type)) {
-          return false;    // parse error
-        }
-      #endif
+      if (PROFILE) {
+        profile->countAction(parser->state, lexer.type);
+      }
+
+      if (tables->uses<L, TL_EEF>() &&
+          tables->actionEntryIsError<L>(parser->state, lexer.type)) {
+        return IR_ERROR;    // parse error
+      }
 
       ActionEntry action =
-        tables->getActionEntry_noError(parser->state, lexer.type);
+        tables->getActionEntry_noError<L>(parser->state, lexer.type);
 
       // I decode reductions before shifts because:
       //   - they are 4x more common in my C grammar
       //   - decoding a reduction is one less integer comparison
       // however I can only measure ~1% performance difference
-      if (tables->isReduceAction(action)) {
+      if (tables->isReduceAction<L>(action)) {
         ACCOUNTING( localDetReduce++; )
-        int prodIndex = tables->decodeReduce(action, parser->state);
+        int prodIndex = tables->decodeReduce<L>(action, parser->state);
         ParseTables::ProdInfo const &prodInfo = tables->getProdInfo(prodIndex);
         int rhsLen = prodInfo.rhsLen;
         if (rhsLen <= parser->determinDepth) {
@@ -1042,8 +1250,11 @@ STATICDEF bool GLR
 
           // this is like a shift -- we need to know where to go; the
           // 'goto' table has this information
-          StateId newState = tables->decodeGoto(
-            tables->getGotoEntry(parser->state, prodInfo.lhsIndex),
+          if (PROFILE) {
+            profile->countGoto(parser->state, prodInfo.lhsIndex);
+          }
+          StateId newState = tables->decodeGoto<L>(
+            tables->getGotoEntry<L>(parser->state, prodInfo.lhsIndex),
             prodInfo.lhsIndex);
 
           // debugging
@@ -1088,7 +1299,7 @@ STATICDEF bool GLR
 
               // TODO: I'm pretty sure I'm not properly cleaning
               // up all of my state here..
-              return false;
+              return IR_ERROR;
             }
           #endif // USE_KEEP
 
@@ -1100,11 +1311,11 @@ STATICDEF bool GLR
         }
       }
 
-      else if (tables->isShiftAction(action)) {
+      else if (tables->isShiftAction<L>(action)) {
         ACCOUNTING( localDetShift++; )
 
         // can shift unambiguously
-        StateId newState = tables->decodeShift(action, lexer.type);
+        StateId newState = tables->decodeShift<L>(action, lexer.type);
 
         TRSPARSE("state " << parser->state <<
                  ", (unambig) shift token " << lexer.tokenDesc() <<
@@ -1142,8 +1353,8 @@ STATICDEF bool GLR
 
     // if we get here, we're dropping into the nondeterministic GLR
     // algorithm in its full glory
-    if (!glr.nondeterministicParseToken()) {
-      return false;
+    if (!glr.nondeterministicParseToken<L>()) {
+      return IR_ERROR;
     }
 
   #if USE_MINI_LR    // silence a warning when it's not enabled
@@ -1154,11 +1365,23 @@ STATICDEF bool GLR
       break;
     }
 
-    // get the next token
-    nextToken(&lexer);
+    // get the next token; if the lexer has a batch staged, this
+    // copies it out of the lexer's buffer instead of calling the lexer
+    if (!lexer.takePending()) {
+      nextToken(&lexer);
+    }
     #ifndef NDEBUG
       tokenNumber++;
     #endif
+
+    // can the directly-coded parser take it from here?
+    if (direct && glr.stackToDirect(*direct)) {
+      ACCOUNTING(
+        glr.detShift += localDetShift;
+        glr.detReduce += localDetReduce;
+      )
+      return IR_RESUME;
+    }
   }
 
   // push stats into main object
@@ -1167,11 +1390,10 @@ STATICDEF bool GLR
     glr.detReduce += localDetReduce;
   )
 
-  // end of parse; note that this function must be called *before*
-  // the stackNodePool is deallocated
+  // end of parse
   bool rc = glr.cleanupAfterParse(treeTop);
 
-  return rc;
+  return rc? IR_DONE : IR_ERROR;
 }
 
 
@@ -1189,6 +1411,7 @@ string stackTraceString(StackNode *parser)
 // return false if caller should return false; pulled out of
 // glrParse to reduce register pressure (but didn't help as
 // far as I can tell!)
+template <int L>
 bool GLR::nondeterministicParseToken()
 {
   //std::cout << "not deterministic\n";
@@ -1196,6 +1419,12 @@ bool GLR::nondeterministicParseToken()
   // ([GLR] called the code from here to the end of
   // the loop 'parseword')
 
+  // the mini-LR core replaces the sole parser in place rather than
+  // calling addTopmostParser, so its index entry may be out of date
+  if (topmostParsers.size() == 1) {
+    parserIndex[topmostParsers[0]->state] = 0;
+  }
+
   // work through the worklist
   StateId lastToDie = STATE_INVALID;
 
@@ -1205,9 +1434,10 @@ bool GLR::nondeterministicParseToken()
   for (i=0; i < topmostParsers.size(); i++) {
     StackNode* parser = topmostParsers[i].get();
 
+    profileAction(profile, parser->state, lexerPtr->type);
     ActionEntry action =
-      tables->getActionEntry(parser->state, lexerPtr->type);
-    int actions = rwlEnqueueReductions(parser, action, NULL /*sibLink*/);
+      tables->getActionEntry<L>(parser->state, lexerPtr->type);
+    int actions = rwlEnqueueReductions<L>(parser, action, NULL /*sibLink*/);
 
     if (actions == 0) {
       TRSPARSE("parser in state " << parser->state << " died");
@@ -1217,10 +1447,10 @@ bool GLR::nondeterministicParseToken()
 
   // now that the reductions for all the existing topmost states
   // have been enqueued, process that worklist
-  rwlProcessWorklist();
+  rwlProcessWorklist<L>();
 
   // finally, do all the shifts that the topmost states can do
-  rwlShiftTerminals();
+  rwlShiftTerminals<L>();
 
 
   // if all active parsers have died, there was an error
@@ -1309,7 +1539,7 @@ SemanticValue GLR::doReductionAction(
 // pulled from glrParse() to reduce register pressure
 bool GLR::cleanupAfterParse(SemanticValue &treeTop)
 {
-  trsParse << "Parse succeeded!\n";
+  TRSPARSE("Parse succeeded!");
 
 
   // finish the parse by reducing to start symbol
@@ -1362,6 +1592,7 @@ void GLR::pullFromTopmostParsers(StackNode *parser)
       // the last one to maintain contiguity
       if (i < last) {
         topmostParsers[i] = std::move(topmostParsers[last]);
+        parserIndex[topmostParsers[i]->state] = i;
         // (no need to actually copy 'i' into 'last')
       }
       topmostParsers.pop_back(); // removes a reference to 'parser'
@@ -1377,13 +1608,14 @@ void GLR::pullFromTopmostParsers(StackNode *parser)
 // possible; moreover, checking that could be very expensive, since
 // there may be many paths along which to consider reducing, and many
 // paths from that reduced node forward..
+template <int L>
 bool GLR::canMakeProgress(StackNode *parser)
 {
   ActionEntry entry =
-    tables->getActionEntry(parser->state, lexerPtr->type);
+    tables->getActionEntry<L>(parser->state, lexerPtr->type);
 
-  return tables->isShiftAction(entry) ||
-         tables->isReduceAction(entry) ||
+  return tables->isShiftAction<L>(entry) ||
+         tables->isReduceAction<L>(entry) ||
          !tables->isErrorAction(entry);
 }
 
@@ -1392,23 +1624,17 @@ bool GLR::canMakeProgress(StackNode *parser)
 // return NULL
 StackNode *GLR::findTopmostParser(StateId state)
 {
-  #ifdef USE_PARSER_INDEX
-    int index = parserIndex[state];
-    if (index != INDEX_NO_PARSER) {
-      return topmostParsers[index];
+  // the index entry may be left over from some parser that has
+  // since moved or gone away, so it only counts if it leads back
+  // to a parser in 'state'
+  ParserIndexEntry index = parserIndex[state];
+  if (index < topmostParsers.size()) {
+    StackNode *node = topmostParsers[index].get();
+    if (node->state == state) {
+      return node;
     }
-    else {
-      return NULL;
-    }
-  #else
-    for (int i=0; i < topmostParsers.size(); i++) {
-      StackNode* node = topmostParsers[i].get();
-      if (node->state == state) {
-        return node;
-      }
-    }
-    return NULL;
-  #endif
+  }
+  return NULL;
 }
 
 
@@ -1448,9 +1674,9 @@ void GLR::dumpGSS(int tokenNumber) const
       dumpGSSEdge(dest, node, node->firstSib.sib.getC());
       queue.push_back(node->firstSib.sib.get());
 
-      for (auto const& lsib : node->leftSiblings) {
-        dumpGSSEdge(dest, node, lsib.sib.getC());
-        queue.push_back(const_cast<StackNode*>( lsib.sib.getC() ));
+      for (SiblingLink const *lsib = node->leftSiblings; lsib; lsib = lsib->next) {
+        dumpGSSEdge(dest, node, lsib->sib.getC());
+        queue.push_back(const_cast<StackNode*>( lsib->sib.getC() ));
       }
     }
   }
@@ -1510,7 +1736,7 @@ static void innerStackSummary(string &sb, std::unordered_set<StackNode const*> &
 
   sb << "-";
 
-  if (node->leftSiblings.empty()) {
+  if (!node->leftSiblings) {
     // one sibling
     innerStackSummary(sb, printed, node->firstSib.sib.getC());
   }
@@ -1519,9 +1745,9 @@ static void innerStackSummary(string &sb, std::unordered_set<StackNode const*> &
     sb << "(";
     innerStackSummary(sb, printed, node->firstSib.sib.getC());
 
-    for (auto const& lsib : node->leftSiblings) {
+    for (SiblingLink const *lsib = node->leftSiblings; lsib; lsib = lsib->next) {
       sb << "|";
-      innerStackSummary(sb, printed, lsib.sib.getC());
+      innerStackSummary(sb, printed, lsib->sib.getC());
     }
     sb << ")";
   }
@@ -1555,43 +1781,39 @@ ReductionPathQueue::Path::Path()
   : startStateId(STATE_INVALID),
     prodIndex(-1),
     startColumn(-1),
-    leftEdgeNode(NULL),
-    sibLinks(INITIAL_RHSLEN_SIZE),
-    symbols(INITIAL_RHSLEN_SIZE),
-    next(NULL)
+    leftEdgeNode(NULL)
 {}
 
 
-void ReductionPathQueue::Path::init(StateId ssi, int pi, int rhsLen)
+void ReductionPathQueue::Path::init(StateId ssi, int pi)
 {
   startStateId = ssi;
   prodIndex = pi;
-
-  sibLinks.resize(rhsLen+1);
-  symbols.resize(rhsLen+1);
 }
 
 
-ReductionPathQueue::ReductionPathQueue(ParseTables *t)
-  : top(NULL),
+ReductionPathQueue::ReductionPathQueue(ParseTables const *t)
+  : heap(),
+    nextSequence(0),
     pathPool(30),    // arbitrary initial pool size
     tables(t)
-{}
+{
+  heap.reserve(TYPICAL_MAX_REDUCTION_PATHS);
+}
 
 ReductionPathQueue::~ReductionPathQueue()
 {
-  // 'pathPool' will automatically array-deallocate all of the
-  // paths, which will themselves then delete their internal
-  // 'sibLinks' and 'symbols' arrays
+  // 'pathPool' will automatically array-deallocate all of the paths
 }
 
 
-ReductionPathQueue::Path *ReductionPathQueue::newPath(
-  StateId startStateId, int prodIndex, int rhsLen)
+/*static*/ inline bool
+  ReductionPathQueue::goesBefore(Entry const &e1, Entry const &e2)
 {
-  Path *p = pathPool.alloc();
-  p->init(startStateId, prodIndex, rhsLen);
-  return p;
+  // 'rank' has the start column and then the nonterminal order;
+  // after that they go in the order they arrived
+  return e1.rank < e2.rank ||
+         (e1.rank == e2.rank && e1.sequence < e2.sequence);
 }
 
 
@@ -1601,66 +1823,42 @@ void ReductionPathQueue::insertPathCopy(Path const *src, StackNode *leftEdge)
 
   // make a new node
   Path *p = pathPool.alloc();
-  p->init(src->startStateId, src->prodIndex, prodInfo.rhsLen);
+  p->init(src->startStateId, src->prodIndex);
 
   // fill in left edge info
   p->leftEdgeNode = leftEdge;
   p->startColumn = leftEdge->column;
 
   // copy the path info
-  for (int i = prodInfo.rhsLen-1; i>=0; i--) {
-    p->sibLinks[i] = src->sibLinks[i];
-    p->symbols[i] = src->symbols[i];
-  }
-
-  // find the proper place to insert it
-  if (!top || goesBefore(p, top)) {
-    // prepend
-    p->next = top;
-    top = p;
-  }
-  else {
-    // search
-    Path *prev = top;
-    while (prev->next && !goesBefore(p, prev->next)) {
-      prev = prev->next;
-    }
-
-    // insert
-    p->next = prev->next;
-    prev->next = p;
-  }
+  std::copy_n(src->sibLinks, prodInfo.rhsLen, p->sibLinks);
+  std::copy_n(src->symbols, prodInfo.rhsLen, p->symbols);
+
+  // put it into the heap; the heap's comparison says which path is
+  // "less" urgent, so it is 'goesBefore' backwards
+  Entry e;
+  xassertdb(leftEdge->column >= 0);
+  e.rank = ((unsigned long long)~(unsigned)leftEdge->column << 32) |
+           tables->getNontermOrdinal(prodInfo.lhsIndex);
+  e.sequence = nextSequence++;
+  e.path = p;
+
+  heap.push_back(e);
+  std::push_heap(heap.begin(), heap.end(),
+                 [](Entry const &a, Entry const &b) { return goesBefore(b, a); });
 }
 
-bool ReductionPathQueue::goesBefore(Path const *p1, Path const *p2) const
+inline ReductionPathQueue::Path *ReductionPathQueue::dequeue()
 {
-  if (p1->startColumn > p2->startColumn) {
-    // 'p1' spans fewer tokens, so it goes first
-    return true;
-  }
-  else if (p2->startColumn > p1->startColumn) {
-    // same logic
-    return false;
-  }
-  else {
-    // equal start columns, so compare ids of nonterminals
-    // to which we're reducing in each case
-    NtIndex p1NtIndex = tables->getProdInfo(p1->prodIndex).lhsIndex;
-    NtIndex p2NtIndex = tables->getProdInfo(p2->prodIndex).lhsIndex;
+  std::pop_heap(heap.begin(), heap.end(),
+                [](Entry const &a, Entry const &b) { return goesBefore(b, a); });
+  Path *ret = heap.back().path;
+  heap.pop_back();
 
-    // consult total order on nonterminals
-    int ord1 = tables->getNontermOrdinal(p1NtIndex);
-    int ord2 = tables->getNontermOrdinal(p2NtIndex);
-
-    return ord1 < ord2;
+  if (heap.empty()) {
+    // nothing left to be ordered against, so the numbering can
+    // start over rather than eventually wrap around
+    nextSequence = 0;
   }
-}
-
-
-inline ReductionPathQueue::Path *ReductionPathQueue::dequeue()
-{
-  Path *ret = top;
-  top = top->next;
   return ret;
 }
 
@@ -1672,6 +1870,7 @@ void ReductionPathQueue::deletePath(Path *p)
 
 
 // process the reduction worklist
+template <int L>
 void GLR::rwlProcessWorklist()
 {
   // location of this token
@@ -1757,8 +1956,8 @@ void GLR::rwlProcessWorklist()
     else {
       // shift the nonterminal with its reduced semantic value
       SiblingLink *newLink =
-        rwlShiftNonterminal(path->leftEdgeNode, prodInfo.lhsIndex,
-                            sval  SOURCELOCARG( leftEdge ) );
+        rwlShiftNonterminal<L>(path->leftEdgeNode, prodInfo.lhsIndex,
+                               sval  SOURCELOCARG( leftEdge ) );
 
       if (newLink) {
         // for each 'finished' parser ...
@@ -1766,9 +1965,10 @@ void GLR::rwlProcessWorklist()
           StackNode *parser = topmostParsers[i].get();
 
           // ... do any reduce actions that are now enabled by the new link
+          profileAction(profile, parser->state, lexerPtr->type);
           ActionEntry action =
-            tables->getActionEntry(parser->state, lexerPtr->type);
-          rwlEnqueueReductions(parser, action, newLink);
+            tables->getActionEntry<L>(parser->state, lexerPtr->type);
+          rwlEnqueueReductions<L>(parser, action, newLink);
         }
       }
     }
@@ -1788,14 +1988,16 @@ void GLR::rwlProcessWorklist()
 //   - we make a new stack node
 //   - we add a new link between existing stack nodes
 //   - we merge two semantic values onto an existing link
+template <int L>
 SiblingLink *GLR::rwlShiftNonterminal(StackNode *leftSibling, int lhsIndex,
                                       SemanticValue /*owner*/ sval
                                       SOURCELOCARG( SourceLoc loc ) )
 {
   // this is like a shift -- we need to know where to go; the
   // 'goto' table has this information
-  StateId rightSiblingState = tables->decodeGoto(
-    tables->getGotoEntry(leftSibling->state, lhsIndex), lhsIndex);
+  profileGoto(profile, leftSibling->state, lhsIndex);
+  StateId rightSiblingState = tables->decodeGoto<L>(
+    tables->getGotoEntry<L>(leftSibling->state, lhsIndex), lhsIndex);
 
   // debugging
   TRSPARSE("state " << leftSibling->state <<
@@ -1819,7 +2021,7 @@ SiblingLink *GLR::rwlShiftNonterminal(StackNode *leftSibling, int lhsIndex,
       // 'rightSibling' cannot make progress at all, it would be much
       // better to just drop this alternative than demand the user
       // merge trees when there is not necessarily any ambiguity
-      if (!canMakeProgress(rightSibling)) {
+      if (!canMakeProgress<L>(rightSibling)) {
         // both trees are dead; deallocate one (the other alternative
         // will be dropped later, when 'rightSibling' is considered
         // for action in the usual way)
@@ -1943,9 +2145,10 @@ SiblingLink *GLR::rwlShiftNonterminal(StackNode *leftSibling, int lhsIndex,
     // here, rather than adding something to the parser worklist,
     // we'll directly expand its reduction paths and add them
     // to the reduction worklist
+    profileAction(profile, rightSiblingView->state, lexerPtr->type);
     ActionEntry action =
-      tables->getActionEntry(rightSiblingView->state, lexerPtr->type);
-    rwlEnqueueReductions(rightSiblingView, action, NULL /*sibLink*/);
+      tables->getActionEntry<L>(rightSiblingView->state, lexerPtr->type);
+    rwlEnqueueReductions<L>(rightSiblingView, action, NULL /*sibLink*/);
 
     // no need for the elaborate re-checking above, since we
     // just created rightSibling, so no new opportunities
@@ -1967,18 +2170,19 @@ SiblingLink *GLR::rwlShiftNonterminal(StackNode *leftSibling, int lhsIndex,
 //
 // this function returns the # of actions the parser can take, as
 // part of a rather weak error reporting scheme..
+template <int L>
 int GLR::rwlEnqueueReductions(StackNode *parser, ActionEntry action,
                               SiblingLink *mustUseLink)
 {
   parser->checkLocalInvariants();
 
-  if (tables->isShiftAction(action)) {
+  if (tables->isShiftAction<L>(action)) {
     // do nothing, we're only interested in reductions
     return 1;
   }
-  else if (tables->isReduceAction(action)) {
+  else if (tables->isReduceAction<L>(action)) {
     // reduce
-    int prodIndex = tables->decodeReduce(action, parser->state);
+    int prodIndex = tables->decodeReduce<L>(action, parser->state);
 
     // get information about the production we'll use
     ParseTables::ProdInfo const &info = tables->getProdInfo(prodIndex);
@@ -1987,14 +2191,10 @@ int GLR::rwlEnqueueReductions(StackNode *parser, ActionEntry action,
 
     // initialize a prototype Path which will monitor our progress
     // though the enumeration of all paths
-    ReductionPathQueue::Path *proto =
-      pathQueue.newPath(parser->state, prodIndex, rhsLen);
-
-    // kick off the recursion
-    rwlRecursiveEnqueue(proto, rhsLen, parser, mustUseLink);
+    ReductionPathQueue::Path proto;
+    proto.init(parser->state, prodIndex);
 
-    // deallocate the prototype
-    pathQueue.deletePath(proto);
+    rwlEnqueuePaths(&proto, rhsLen, parser, mustUseLink);
 
     return 1;
   }
@@ -2004,9 +2204,9 @@ int GLR::rwlEnqueueReductions(StackNode *parser, ActionEntry action,
   }
   else {
     // ambiguous; check for reductions
-    ActionEntry *entry = tables->decodeAmbigAction(action, parser->state);
+    ActionEntry const *entry = tables->decodeAmbigAction<L>(action, parser->state);
     for (int i=0; i<entry[0]; i++) {
-      rwlEnqueueReductions(parser, entry[i+1], mustUseLink);
+      rwlEnqueueReductions<L>(parser, entry[i+1], mustUseLink);
     }
 
     return entry[0];
@@ -2014,52 +2214,84 @@ int GLR::rwlEnqueueReductions(StackNode *parser, ActionEntry action,
 }
 
 
-// arguments have same meanings as in 'rwlRecursiveEnqueue'
-inline void GLR::rwlCollectPathLink(
-  ReductionPathQueue::Path *proto, int popsRemaining,
-  StackNode *currentNode, SiblingLink *mustUseLink, SiblingLink *linkToAdd)
+// the link after 'link' among 'node's sibling links, or NULL
+static inline SiblingLink *nextSiblingLink(StackNode *node, SiblingLink *link)
 {
-  proto->sibLinks[popsRemaining] = linkToAdd;
-  proto->symbols[popsRemaining] = currentNode->getSymbolC();
-
-  if (linkToAdd == mustUseLink) {
-    rwlRecursiveEnqueue(proto, popsRemaining, linkToAdd->sib.get(),
-                        NULL /*mustUseLink*/);
-  }
-  else {
-    rwlRecursiveEnqueue(proto, popsRemaining, linkToAdd->sib.get(),
-                        mustUseLink);
-  }
+  return link == &node->firstSib? node->leftSiblings : link->next;
 }
 
-// recursive depth-first enumeration of paths
-void GLR::rwlRecursiveEnqueue(
+// depth-first enumeration of the paths of 'rhsLen' links leading left
+// from 'start'; each one found is written into 'proto' and a copy of
+// it is queued, unless 'mustUseLink' is non-NULL and the path does
+// not use it
+//
+// This walks the stack with explicit arrays rather than recursion,
+// but visits the paths in the same order the recursive version did:
+// the rightmost link varies slowest, and at each node 'firstSib'
+// comes before the 'leftSiblings' list.
+void GLR::rwlEnqueuePaths(
   ReductionPathQueue::Path *proto,  // prototype path, with path so far
-  int popsRemaining,                // # of links yet to traverse to find a full path
-  StackNode *currentNode,           // node we're at in the path
+  int rhsLen,                       // # of links in a full path
+  StackNode *start,                 // node at the right end
   SiblingLink *mustUseLink)         // link the path must use (if non-NULL)
 {
-  if (popsRemaining == 0) {
-    // we found path of required length
+  if (rhsLen == 0) {
+    // the empty path
+    if (mustUseLink == NULL) {
+      pathQueue.insertPathCopy(proto, start);
+    }
+    return;
+  }
+  xassertdb(rhsLen <= MAX_RHSLEN);    // checked against the tables in GLR::GLR
+
+  // 'proto->sibLinks[i]' is a sibling link of 'nodes[i]'; the links
+  // at indices 'i' through rhsLen-1 are the path so far
+  StackNode *nodes[MAX_RHSLEN];
+  int i = rhsLen-1;
+  nodes[i] = start;
+  proto->sibLinks[i] = &start->firstSib;
+  proto->symbols[i] = start->getSymbolC();
 
-    // if we have failed to use the required link, ignore this path
-    if (mustUseLink != NULL) {
-      return;
+  // # of times 'mustUseLink' appears in the path so far
+  int uses = 0;
+
+  for (;;) {
+    SiblingLink *link = proto->sibLinks[i];
+    if (link == mustUseLink) {
+      uses++;
     }
 
-    // the prototype path is the one we want; copy it, fill in
-    // the 'startColumn', and insert it into the queue
-    pathQueue.insertPathCopy(proto, currentNode);
-  }
+    if (i > 0) {
+      // extend the path by the first link of the node to the left
+      StackNode *left = link->sib.get();
+      i--;
+      nodes[i] = left;
+      proto->sibLinks[i] = &left->firstSib;
+      proto->symbols[i] = left->getSymbolC();
+      continue;
+    }
 
-  else {
-    // explore 'currentNode's siblings
-    rwlCollectPathLink(proto, popsRemaining-1, currentNode, mustUseLink,
-                       &(currentNode->firstSib));
+    // the path is complete
+    if (mustUseLink == NULL || uses > 0) {
+      pathQueue.insertPathCopy(proto, link->sib.get());
+    }
+
+    // move on to the next path: advance the leftmost link that has
+    // an alternative, dropping the ones to its left
+    for (;;) {
+      if (proto->sibLinks[i] == mustUseLink) {
+        uses--;
+      }
 
-    for (auto& lsib : currentNode->leftSiblings) {
-        rwlCollectPathLink(proto, popsRemaining-1, currentNode, mustUseLink,
-                           &lsib);
+      SiblingLink *next = nextSiblingLink(nodes[i], proto->sibLinks[i]);
+      if (next) {
+        proto->sibLinks[i] = next;
+        break;
+      }
+
+      if (++i == rhsLen) {
+        return;       // every path has been seen
+      }
     }
   }
 }
@@ -2067,6 +2299,7 @@ void GLR::rwlRecursiveEnqueue(
 
 // final phase in processing of a token: all topmost parsers
 // shift the current token, if they can
+template <int L>
 void GLR::rwlShiftTerminals()
 {
   NODE_COLUMN( globalNodeColumn++; )
@@ -2092,32 +2325,33 @@ void GLR::rwlShiftTerminals()
 
 
     // where can this shift, if anyplace?
+    profileAction(profile, leftSibling->state, lexerPtr->type);
     ActionEntry action =
-      tables->getActionEntry(leftSibling->state, lexerPtr->type);
+      tables->getActionEntry<L>(leftSibling->state, lexerPtr->type);
 
     // we'll set this if we find a valid shift dest
     StateId newState = STATE_INVALID;
 
     // consult action table, looking only for shifts
-    if (tables->isShiftAction(action)) {
+    if (tables->isShiftAction<L>(action)) {
       // unambiguous shift
-      newState = tables->decodeShift(action, lexerPtr->type);
+      newState = tables->decodeShift<L>(action, lexerPtr->type);
     }
-    else if (tables->isReduceAction(action) ||
+    else if (tables->isReduceAction<L>(action) ||
              tables->isErrorAction(action)) {
       // reduce or error
       continue;
     }
     else {
       // nondeterministic; get actions
-      ActionEntry *entry = tables->decodeAmbigAction(action, leftSibling->state);
+      ActionEntry const *entry = tables->decodeAmbigAction<L>(action, leftSibling->state);
 
       // do each one
       for (int i=0; i<entry[0]; i++) {
         action = entry[i+1];
-        if (tables->isShiftAction(action)) {
+        if (tables->isShiftAction<L>(action)) {
           // a shift was among the conflicted actions
-          newState = tables->decodeShift(action, lexerPtr->type);
+          newState = tables->decodeShift<L>(action, lexerPtr->type);
           break;
         }
       }
@@ -39,13 +39,14 @@
 #define GLR_H
 
 #include "glrconfig.h"     // SOURCELOC
+#include "directlr.h"      // DirectLRStack
 #include "parsetables.h"   // StateId
 #include "rcptr.h"         // RCPtr
 #include "useract.h"       // UserActions, SemanticValue
 #include "objpool.h"       // ObjectPool
+#include "slabarena.h"     // SlabArena
 #include "srcloc.h"        // SourceLoc
 
-#include <forward_list>    // std::forward_list
 #include <stdio.h>         // FILE
 #include <iostream>        // std::ostream
 #include <vector>          // std::vector
@@ -53,6 +54,7 @@
 
 // fwds from other files
 class LexerInterface;      // lexerint.h
+class ParseProfile;        // parseprof.h
 
 // forward decls for things declared below
 class StackNode;           // unit of parse state
@@ -87,6 +89,9 @@ public:
   // (which means the induced parse forest is incomplete)
   YIELD_COUNT( int yieldCount; )
 
+  // next link in the owning node's 'leftSiblings' list
+  SiblingLink *next;
+
   // if you add additional fields, they need to be inited in the
   // constructor *and* in StackNode::addFirstSiblingLink
 
@@ -127,8 +132,9 @@ public:
   // if there is more than one, it means two or more LR stacks have
   // been joined at this point.  this is the parse-time representation
   // of ambiguity (actually, unambiguous grammars or inputs do
-  // sometimes lead to multiple siblings)
-  std::forward_list<SiblingLink> leftSiblings;   // this is a set
+  // sometimes lead to multiple siblings); the links are chained
+  // through 'next', and allocated by GLR::allocSiblingLink
+  SiblingLink *leftSiblings;           // (owner list) this is a set
 
   // the *first* sibling is simply embedded directly into the
   // stack node, to avoid list overhead in the common case of
@@ -156,10 +162,6 @@ public:
   // not used by the parsing algorithm itself
   NODE_COLUMN( int column; )
 
-  // count and high-water for stack nodes
-  static int numStackNodesAllocd;
-  static int maxStackNodesAllocd;
-
 
 private:    // funcs
   SiblingLink *
@@ -202,8 +204,8 @@ public:     // funcs
 
   // sibling count queries (each one answerable in constant time)
   bool hasZeroSiblings() const { return !firstSib.sib; }
-  bool hasOneSibling() const { return firstSib.sib && leftSiblings.empty(); }
-  bool hasMultipleSiblings() const { return !leftSiblings.empty(); }
+  bool hasOneSibling() const { return firstSib.sib && !leftSiblings; }
+  bool hasMultipleSiblings() const { return leftSiblings != NULL; }
 
   // when you expect there's only one sibling link, get it this way
   SiblingLink const *getUniqueLinkC() const;
@@ -217,14 +219,23 @@ public:     // funcs
   int computeDeterminDepth() const;
 
   // debugging
-  static void printAllocStats();
   void checkLocalInvariants() const;
 };
 
 
+// the longest right-hand side the GLR core can reduce by; it sizes
+// the fixed arrays of the mini-LR core and of reduction paths, and
+// GLR::GLR checks the tables against it
+enum { MAX_RHSLEN = 30 };
+
+
 // this is a priority queue of stack node paths that are candidates to
 // reduce, maintained such that we can select paths in an order which
-// will avoid yield-then-merge
+// will avoid yield-then-merge: a path spanning fewer tokens goes
+// before one spanning more, and of two paths spanning the same
+// tokens, the one reducing to B goes first if A ->+ B (this is the
+// nonterminal order in the tables); remaining ties go in the order
+// the paths were queued
 class ReductionPathQueue {
 public:       // types
   // a single path in the stack
@@ -249,53 +260,66 @@ public:       // types
 
     // ---- path in between ----
     // array of sibling links, naming the path; 'sibLink[0]' is the
-    // leftmost link; array length is given by the rhsLen of
-    // prodIndex's production
-    std::vector<SiblingLink*> sibLinks;    // (array of serfs)
+    // leftmost link; only the first rhsLen entries (for prodIndex's
+    // production) are meaningful
+    SiblingLink *sibLinks[MAX_RHSLEN];     // (array of serfs)
 
     // corresponding array of symbol ids so we know how to interpret
     // the semantic values in the links
-    std::vector<SymbolId> symbols;
-
-    // link between nodes for construction of a linked list,
-    // kept in sorted order
-    Path *next;
+    SymbolId symbols[MAX_RHSLEN];
 
   public:     // funcs
     Path();
 
-    void init(StateId startStateId, int prodIndex, int rhsLen);
+    void init(StateId startStateId, int prodIndex);
     void deinit() {}
   };
 
+private:      // types
+  // a queued path, with its position in the queue spelled out so
+  // that ordering two paths touches neither the paths nor the tables
+  struct Entry {
+    // startColumn, complemented, in the high half, so paths that
+    // span fewer tokens come first; then the ordinal of the
+    // production's left-hand side in the total order on nonterminals
+    unsigned long long rank;
+
+    // when the path was queued, relative to the others, so paths
+    // that tie on 'rank' are served first come, first served
+    unsigned sequence;
+
+    Path *path;
+  };
+
 private:      // data
-  // head of the list
-  Path *top;
+  // the queued paths, as a binary heap whose front is the path
+  // that goes first (see 'goesBefore')
+  std::vector<Entry> heap;
+
+  // sequence number for the next path queued
+  unsigned nextSequence;
 
   // allocation pool of Path objects
   ObjectPool<Path> pathPool;
 
   // parse tables, so we can decode prodIndex and also compare
   // production ids for sorting purposes
-  ParseTables *tables;
+  ParseTables const *tables;
 
 private:      // funcs
-  bool goesBefore(Path const *p1, Path const *p2) const;
+  static bool goesBefore(Entry const &e1, Entry const &e2);
 
 public:       // funcs
-  ReductionPathQueue(ParseTables *t);
+  ReductionPathQueue(ParseTables const *t);
   ~ReductionPathQueue();
 
-  // get another Path object, inited with these values
-  Path *newPath(StateId startStateId, int prodIndex, int rhsLen);
-
   // make a copy of the prototype 'src', fill in its left-edge
   // fields using 'leftEdge', and insert it into sorted order
   // in the queue
   void insertPathCopy(Path const *src, StackNode *leftEdge);
 
   // true if there are no more paths
-  bool isEmpty() const { return top == NULL; }
+  bool isEmpty() const { return heap.empty(); }
   bool isNotEmpty() const { return !isEmpty(); }
 
   // remove the next path to reduce from the list, and return it
@@ -307,15 +331,29 @@ public:       // funcs
 
 
 // each GLR object is a parser for a specific grammar, but can be
-// used to parse multiple token streams
+// used to parse multiple token streams; it is meant to be kept
+// around as a parse session: the stack node pool, the parser index
+// and the scratch buffers all survive from one 'glrParse' to the
+// next, so parsing many small inputs with one GLR object pays the
+// setup cost only once
+//
+// A GLR object is reentrant: all of its mutable state, including
+// the stack node accounting, lives in the object itself, and the
+// parse tables are only ever read.  So several GLR objects, each
+// confined to its own thread, can parse concurrently while sharing
+// one ParseTables.  The user actions are not shared this way; each
+// thread needs its own (see mtparse.h).
 class GLR {
+  // stack nodes get their sibling links from 'allocSiblingLink'
+  friend class StackNode;
+
 public:
   // ---- grammar-wide data ----
   // user-specified actions
   UserActions *userAct;                     // (serf)
 
-  // parse tables derived from the grammar
-  ParseTables *tables;                      // (serf)
+  // parse tables derived from the grammar; shared, read-only
+  ParseTables const *tables;                // (serf)
 
   // ---- parser state between tokens ----
   // I keep a pointer to this so I can ask for token descriptions
@@ -329,9 +367,10 @@ public:
   std::vector<RCPtr<StackNode>> topmostParsers;     // (refct list)
 
   // index: StateId -> index in 'topmostParsers' of unique parser
-  // with that state, or INDEX_NO_PARSER if none has that state
-  typedef unsigned char ParserIndexEntry;
-  enum { INDEX_NO_PARSER = 255 };
+  // with that state; an entry is only believed if it is in range
+  // and the parser there really has that state, so stale entries
+  // need never be cleared (see findTopmostParser)
+  typedef unsigned ParserIndexEntry;
   ParserIndexEntry *parserIndex;            // (owner)
 
   // this is for assigning unique ids to stack nodes
@@ -358,23 +397,50 @@ public:
   std::vector<RCPtr<StackNode>> prevTopmost;        // (refct list)
 
   // ---- allocation pools ----
-  // this is a pointer to the same-named local variable in innerGlrParse
-  ObjectPool<StackNode> *stackNodePool;
+  // stack nodes; kept warm between parses, and replaced with a fresh
+  // pool only when a parse leaves nodes behind (see 'glrParse')
+  ObjectPool<StackNode> *stackNodePool;     // (owner)
+
+  // sibling links beyond each node's 'firstSib'; these are made in
+  // token order and mostly die a few frontiers later, so they come
+  // from slabs that are reclaimed whole (see slabarena.h)
+  SlabArena<SiblingLink> linkArena;
 
   // pool and list for the RWL implementation
   ReductionPathQueue pathQueue;
 
+  // parse stack of the directly-coded parser, if there is one
+  DirectLRStack directStack;
+
   // ---- user options ----
   // when true, failed parses are accompanied by some rudimentary
   // diagnosis; when false, failed parses are silent (default: true)
   bool noisyFailedParse;
 
+  // when true, additional sibling links come from 'linkArena'; when
+  // false, each one is allocated on the heap (default: true); only
+  // change this between parses
+  bool useLinkArena;
+
+  // when true, and the user actions have a directly-coded parser for
+  // these tables (UserActions::getDirectParser), it does the parsing
+  // wherever the grammar is deterministic (default: true); it is not
+  // used while tracing parser actions, since it doesn't trace
+  bool useDirectParser;
+
+  // when not NULL, every action and goto table lookup the parser makes
+  // is counted in it, for 'elkhound -profile'; the directly-coded
+  // parser isn't used meanwhile, since it doesn't count (default: NULL)
+  ParseProfile *profile;                    // (nullable serf)
+
   // ---- debugging trace ----
-  // these are computed during GLR::GLR since the profiler reports
+  // 'trParse' is computed during GLR::GLR since the profiler reports
   // there is significant expense to computing the debug strings
-  // (that are then usually not printed)
+  // (that are then usually not printed); 'trsParse' is set only for
+  // the duration of each parse, since the stream trace() hands out
+  // when not tracing belongs to the calling thread
   bool trParse;                             // tracingSys("parse")
-  std::ostream &trsParse;                        // trace("parse")
+  std::ostream *trsParse;                   // trace("parse"), or NULL
 
   // track column for new nodes
   NODE_COLUMN( int globalNodeColumn; )
@@ -385,6 +451,18 @@ public:
   // count of # of times yield-then-merge happens
   int yieldThenMergeCt;
 
+  // count and high-water for stack nodes
+  int numStackNodesAllocd;
+  int maxStackNodesAllocd;
+
+  // # of sibling links added between existing stack nodes, and the
+  // # of passes spent recomputing 'determinDepth' afterwards
+  int parserMerges;
+  int computeDepthIters;
+
+  // # of sibling links made beyond each node's 'firstSib'
+  int numExtraLinks;
+
 private:    // funcs
   // comments in glr.cc
   SemanticValue duplicateSemanticValue(SymbolId sym, SemanticValue sval);
@@ -397,42 +475,66 @@ private:    // funcs
   void clearAllStackNodes();
   void addTopmostParser(RCPtr<StackNode> parser);
   void pullFromTopmostParsers(StackNode *parser);
+  template <int L>
   bool canMakeProgress(StackNode *parser);
   void dumpGSS(int tokenNumber) const;
   void dumpGSSEdge(FILE *dest, StackNode const *src,
                                StackNode const *target) const;
   void printConfig() const;
+  void printAllocStats() const;
   void buildParserIndex();
+  void resetStackNodePool();
+  inline SiblingLink *allocSiblingLink(RCPtr<StackNode> sib, SemanticValue sval
+                                       SOURCELOCARG( SourceLoc loc ) );
+  inline void freeSiblingLink(SiblingLink *link);
   void printParseErrorMessage(StateId lastToDie);
   bool cleanupAfterParse(SemanticValue &treeTop);
+  template <int L>
   bool nondeterministicParseToken();
-  static bool innerGlrParse(GLR &glr, LexerInterface &lexer, SemanticValue &treeTop);
+
+  // outcome of 'innerGlrParse'
+  enum InnerResult {
+    IR_ERROR,              // parse error
+    IR_DONE,               // parse finished
+    IR_RESUME,             // stack moved back to 'direct' (see glr.cc)
+  };
+  // 'L' is the tables' layout() (see parsetables.h); 'PROFILE' is
+  // true when 'profile' is set
+  template <int L, bool PROFILE>
+  static InnerResult innerGlrParse(GLR &glr, LexerInterface &lexer,
+                                   SemanticValue &treeTop,
+                                   DirectLRStack *direct);
+  InnerResult innerGlrParseForTables(LexerInterface &lexer,
+                                     SemanticValue &treeTop,
+                                     DirectLRStack *direct);
+  bool directGlrParse(UserActions::DirectParseFunc directParse,
+                      LexerInterface &lexer, SemanticValue &treeTop);
+  void stackFromDirect(DirectLRStack &direct);
+  bool stackToDirect(DirectLRStack &direct);
   SemanticValue doReductionAction(
     int productionId, SemanticValue const *svals
     SOURCELOCARG( SourceLoc loc ) );
 
+  // these take the layout 'L' from 'innerGlrParse'
+  template <int L>
   void rwlProcessWorklist();
+  template <int L>
   SiblingLink *rwlShiftNonterminal(StackNode *leftSibling, int lhsIndex,
                                    SemanticValue /*owner*/ sval
                                    SOURCELOCARG( SourceLoc loc ) );
+  template <int L>
   int rwlEnqueueReductions(StackNode *parser, ActionEntry action,
                            SiblingLink *sibLink);
-  void rwlCollectPathLink(
-    ReductionPathQueue::Path *proto, int popsRemaining,
-    StackNode *currentNode, SiblingLink *mustUseLink, SiblingLink *linkToAdd);
-  void rwlRecursiveEnqueue(
-    ReductionPathQueue::Path *proto,
-    int popsRemaining,
-    StackNode *currentNode,
-    SiblingLink *mustUseLink);
+  void rwlEnqueuePaths(
+    ReductionPathQueue::Path *proto, int rhsLen,
+    StackNode *start, SiblingLink *mustUseLink);
+  template <int L>
   void rwlShiftTerminals();
 
-  void configCheck(char const *option, bool core, bool table);
-
   string stackSummary() const;
 
 public:     // funcs
-  GLR(UserActions *userAct, ParseTables *tables);
+  GLR(UserActions *userAct, ParseTables const *tables);
   ~GLR();
 
   // ------- primary interface -------
@@ -440,9 +542,14 @@ public:     // funcs
   void readBinaryGrammar(char const *grammarFname);
 
   // parse, using the token stream in 'lexer', and store the final
-  // semantic value in 'treeTop'
+  // semantic value in 'treeTop'; may be called any number of times,
+  // with different lexers and user actions
   bool glrParse(LexerInterface &lexer, SemanticValue &treeTop);
 
+  // give back the memory the session has accumulated between
+  // parses, e.g. after an unusually large input
+  void releaseSessionStorage();
+
 };
 
 
@@ -56,29 +56,19 @@
 #endif
 
 
-// when true, error entries in the action table are extracted into
-// their own bitmap; this then enables compression on the action
-// table, since it makes it sparse
-#ifndef ENABLE_EEF_COMPRESSION
-  #define ENABLE_EEF_COMPRESSION 0
-#endif
-
-// when true, the action and goto tables are compressed using
-// graph coloring
-#ifndef ENABLE_GCS_COMPRESSION
-  #define ENABLE_GCS_COMPRESSION 0
-#endif
-
-// when true, action and goto *columns* are merged during GCS;
-// otherwise, only rows are merged
-#ifndef ENABLE_GCS_COLUMN_COMPRESSION
-  #define ENABLE_GCS_COLUMN_COMPRESSION 0
-#endif
-
-// when true, entries in the action and goto tables are a
-// 1-byte index into an appropriate map
-#ifndef ENABLE_CRS_COMPRESSION
-  #define ENABLE_CRS_COMPRESSION 0
+// The parse table compression options (Error Entry Factoring, the
+// Graph Coloring Scheme with or without columns, the Code Reduction
+// Scheme and the Row Displacement Scheme) used to be chosen here, and
+// the parser core had to be compiled to match the tables.  Now they
+// are chosen when the tables are made (elkhound -eef, -gcs, -gcsc,
+// -crs, -rds), the tables record them, and the core reads any of
+// them (see TableLayout in parsetables.h).
+#if (defined(ENABLE_EEF_COMPRESSION) && ENABLE_EEF_COMPRESSION) || \
+    (defined(ENABLE_GCS_COMPRESSION) && ENABLE_GCS_COMPRESSION) || \
+    (defined(ENABLE_GCS_COLUMN_COMPRESSION) && ENABLE_GCS_COLUMN_COMPRESSION) || \
+    (defined(ENABLE_CRS_COMPRESSION) && ENABLE_CRS_COMPRESSION) || \
+    (defined(ENABLE_RDS_COMPRESSION) && ENABLE_RDS_COMPRESSION)
+  #error "table compression is chosen when the tables are made (elkhound -eef etc.)"
 #endif
 
 
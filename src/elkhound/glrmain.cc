@@ -4,7 +4,9 @@
 // the Elkhound parser)
 
 #include <iostream>       // std::cout
-#include <stdlib.h>       // exit
+#include <stdlib.h>       // exit, atoi
+#include <string.h>       // strcmp
+#include <chrono>         // std::chrono
 
 #include "trace.h"        // traceAddSys
 #include "parssppt.h"     // ParseTreeAndTokens, treeMain
@@ -12,6 +14,7 @@
 #include "srcloc.h"       // SourceLocManager
 #include "cc_lang.h"      // CCLang
 #include "parsetables.h"  // ParseTables
+#include "glr.h"          // GLR
 
 // no bison-parser present, so define it myself
 Lexer2Token const *yylval = NULL;
@@ -20,11 +23,48 @@ Lexer2Token const *yylval = NULL;
 ParseTables *makeParseTables();
 UserActions *makeUserActions(StringTable &table, CCLang &lang);
 
+// lex the input once, then parse it 'iters' times with one GLR,
+// and report the time per parse
+void benchmark(ParseTreeAndTokens &tree, int iters, int argc, char **argv)
+{
+  char const *inputFname = processArgs(argc, argv, "  -bench <n>:     time <n> parses of input-file\n");
+  maybeUseTrivialActions(tree);
+  if (!lexNamedFile(tree.lexer2, inputFname)) {
+    exit(2);
+  }
+
+  GLR glr(tree.userAct, tree.tables);
+
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  for (int i=0; i < iters; i++) {
+    tree.lexer2.beginReading();
+    if (!glr.glrParse(tree.lexer2, tree.treeTop)) {
+      exit(2);
+    }
+  }
+  double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+  int tokens = tree.lexer2.tokens.size();
+  std::cout << tokens << " tokens, " << iters << " parses: "
+            << us / iters << " us/parse, "
+            << us / iters / tokens << " us/token" << std::endl;
+}
+
 void doit(int argc, char **argv)
 {
   traceAddSys("progress");
   //traceAddSys("parse-tree");
 
+  // -bench must come first
+  int benchIters = 0;
+  if (argc >= 3 && 0==strcmp(argv[1], "-bench")) {
+    benchIters = atoi(argv[2]);
+    argv[2] = argv[0];    // shift, keeping the program name
+    argc -= 2;
+    argv += 2;
+  }
+
   SemanticValue treeTop;
   CCLang lang;
   ParseTreeAndTokens tree(lang, treeTop);
@@ -32,7 +72,10 @@ void doit(int argc, char **argv)
   ParseTables *tables = makeParseTables();
   tree.userAct = user;
   tree.tables = tables;
-  if (!treeMain(tree, argc, argv)) {
+  if (benchIters > 0) {
+    benchmark(tree, benchIters, argc, argv);
+  }
+  else if (!treeMain(tree, argc, argv)) {
     // parse error
     exit(2);
   }
@@ -11,19 +11,31 @@
 #include "nonport.h"     // getMilliseconds
 #include "crc.h"         // crc32
 #include "flatutil.h"    // Flatten, xfer helpers
+#include "bflatten.h"    // BFlatten
 #include "grampar.h"     // readGrammarFile
 #include "emitcode.h"    // EmitCode
 #include "strutil.h"     // replace
 #include "ckheap.h"      // numMallocCalls
 #include "genml.h"       // emitMLActionCode
-
-#include <functional>    // std::hash
+#include "parseprof.h"   // ParseProfile
+
+#include <algorithm>     // std::sort, std::min
+#include <atomic>        // std::atomic
+#include <condition_variable> // std::condition_variable
+#include <exception>     // std::exception_ptr
+#include <functional>    // std::hash, std::function
+#include <map>           // std::map
 #include <memory>        // std::make_unique, unique_ptr
+#include <mutex>         // std::mutex
+#include <thread>        // std::thread
 #include <unordered_map> // std::unordered_map
 #include <unordered_set> // std::unordered_set
+#include <utility>       // std::pair
 #include <vector>        // std::vector
 #include <fstream>       // std::ofstream
+#include <streambuf>     // std::streambuf
 #include <stdlib.h>      // getenv
+#include <limits.h>      // INT_MAX
 #include <stdio.h>       // printf
 
 
@@ -46,7 +58,8 @@ public:
 // into GrammarAnalysis and push the interfaces to accomodate
 
 // NOTE: only LALR(1) has been recently tested; in particular I
-// know that LR(1) is broken (3/26/02)
+// know that LR(1) is broken (3/26/02); for LR(1) tables, use
+// GrammarAnalysis::minimalLR1 instead of these flags
 
 // LR(0) does all reductions, regardless of what the next token is
 static bool const LR0 = false;
@@ -120,7 +133,6 @@ void DottedProduction::init()
   dot = -1;
   afterDot = NULL;
   canDeriveEmpty = false;
-  backPointer = NULL;
 }
 
 
@@ -951,12 +963,21 @@ GrammarAnalysis::GrammarAnalysis()
     numProds(0),
     initialized(false),
     nextItemSetId(0),    // [ASU] starts at 0 too
+    closureLookaheads(true),
     itemSets(),
     startState(NULL),
     cyclic(false),
     symOfInterest(NULL),
     errors(0),
-    tables(NULL)
+    tables(NULL),
+    numThreads(1),
+    relationalLookaheads(false),
+    minimalLR1(false),
+    tableLayout(0),
+    cacheDir(),
+    cacheSalt(),
+    automatonFname(),
+    profileFname()
 {}
 
 
@@ -1402,144 +1423,207 @@ void GrammarAnalysis::initializeAuxData()
 }
 
 
-void GrammarAnalysis::computeWhatCanDeriveWhat()
-{
-  xassert(initialized);
+// below this many rows, the threads cost more than they save
+enum { PARALLEL_CLOSURE_MIN_ROWS = 128 };
 
+// close 'rel', a square relation, transitively, by Warshall's
+// algorithm a row at a time: for each k, every row with bit k set
+// gets row k or'd into it.  With several threads, each owns a block of
+// rows, and they wait for each other between values of k; row k
+// itself doesn't change during step k (or'ing it into itself does
+// nothing), so everyone can read it while the rows are written.
+static void transitiveClosure(Bit2d &rel, int numThreads)
+{
+  int const n = rel.Size().y;
+  xassert(rel.Size().x == n);
 
-  // iterate: propagate 'true' bits across the derivability matrix
-  // (i.e. compute transitive closure on the canDerive relation)
-  for (;;) {
-    int changes = 0;       // for this iter, # of times we set a matrix bit
+  if (numThreads <= 1 || n < PARALLEL_CLOSURE_MIN_ROWS) {
+    for (int k=0; k < n; k++) {
+      for (int j=0; j < n; j++) {
+        if (j != k && rel.get(point(k, j))) {
+          rel.orRow(j, k);
+        }
+      }
+    }
+    return;
+  }
 
-    // --------- first part: add new canDerive relations --------
-    // loop over all productions
-    for (auto prod = productions.cbegin(); prod != productions.cend(); ++prod) {
+  int const threads = (std::min)(numThreads, n);
+  std::mutex mutex;
+  std::condition_variable stepped;
+  int waiting = 0;      // threads done with the current step
+  int step = 0;         // steps all threads are done with
 
-      // since I don't include 'empty' explicitly in my rules, I won't
-      // conclude that anything can derive empty, which is a problem;
-      // so I special-case it here
-      if (prod->right.empty()) {
-	    addDerivable(prod->left, &emptyString);
-        continue;      	// no point in looping over RHS symbols since there are none
+  auto worker = [&](int t) {
+    int const lo = (int)((long)n * t / threads);
+    int const hi = (int)((long)n * (t+1) / threads);
+    for (int k=0; k < n; k++) {
+      for (int j=lo; j < hi; j++) {
+        if (j != k && rel.get(point(k, j))) {
+          rel.orRow(j, k);
+        }
       }
 
-      // iterate over RHS symbols, seeing if the LHS can derive that
-      // RHS symbol (by itself)
-      for (auto rightSym = prod->right.cbegin(); rightSym != prod->right.cend(); ++rightSym) {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (++waiting == threads) {
+        waiting = 0;
+        step++;
+        stepped.notify_all();
+      }
+      else {
+        stepped.wait(lock, [&]{ return step > k; });
+      }
+    }
+  };
 
-        if (rightSym->sym->isTerminal()) {
-          // if prod->left derives a string containing a terminal,
-          // then it can't derive any nontermial alone (using this
-          // production, at least) -- empty is considered a nonterminal
-          break;
-        }
+  std::vector<std::thread> others;
+  for (int t=1; t < threads; t++) {
+    others.emplace_back(worker, t);
+  }
+  worker(0);
+  for (std::thread &th : others) {
+    th.join();
+  }
+}
 
-        // otherwise, it's a nonterminal
-        Nonterminal const &rightNT = rightSym->sym->asNonterminalC();
 
-        // check if we already know that LHS derives rightNT
-        if (canDerive(prod->left, &rightNT)) {
-          // we already know that prod->left derives rightSym,
-          // so let's not check it again
-        }
+// N ->* M holds if N = M, or N derives M alone (N -> alpha M beta
+// where alpha and beta can derive empty), or if that chains; so this
+// finds which nonterminals can derive empty, then the derives-alone
+// edges, and closes them transitively.  N ->* empty is recorded for
+// each N that can derive empty.
+void GrammarAnalysis::computeWhatCanDeriveWhat()
+{
+  xassert(initialized);
+  bool const tr = tracingSys("derivable");
+  int const emptyIndex = emptyString.ntIndex;
+
+  // ------- which nonterminals can derive empty -------
+  // for each production, how many RHS nonterminals aren't yet known
+  // to derive empty (-1 if it has a terminal, so it never will)
+  std::vector<int> unknown(numProds, 0);
+  // for each nonterminal, the productions it appears in on the RHS,
+  // once per appearance
+  std::vector<std::vector<Production const*>> appearsIn(numNonterms);
+  std::vector<bool> nullable(numNonterms, false);
+  std::vector<int> worklist;
+
+  auto foundNullable = [&](Nonterminal const *nt) {
+    if (!nullable[nt->ntIndex]) {
+      nullable[nt->ntIndex] = true;
+      worklist.push_back(nt->ntIndex);
+    }
+  };
+  foundNullable(&emptyString);
+
+  for (auto const &prod : productions) {
+    int &count = unknown[prod.prodIndex];
+    for (auto const &elt : prod.right) {
+      if (elt.sym->isTerminal()) {
+        count = -1;
+        break;
+      }
+      count++;
+    }
+    if (count > 0) {
+      for (auto const &elt : prod.right) {
+        appearsIn[elt.sym->asNonterminalC().ntIndex].push_back(&prod);
+      }
+    }
+    else if (count == 0) {
+      foundNullable(prod.left);
+    }
+  }
 
-        else {
-          // we are wondering if prod->left can derive rightSym.. for
-          // this to be true, every symbol that comes after rightSym
-          // must be able to derive emptySymbol (we've already verified
-          // by now that every symbol to the *left* can derive empty)
-          bool restDeriveEmpty = true;
-          // *after* right symbol
-          for (auto afterRightSym = std::next(rightSym);
-               afterRightSym != prod->right.cend(); ++afterRightSym) {
-
-            if (afterRightSym->sym->isTerminal()  ||
-                  // if it's a terminal, it can't derive emptyString
-                !canDeriveEmpty(&( afterRightSym->sym->asNonterminalC() ))) {
-                  // this symbol can't derive empty string (or, we don't
-                  // yet know that it can), so we conclude that prod->left
-                  // can't derive rightSym
-              restDeriveEmpty = false;
-              break;
-            }
-          }
+  while (!worklist.empty()) {
+    int nt = worklist.back();
+    worklist.pop_back();
+    for (Production const *prod : appearsIn[nt]) {
+      if (--unknown[prod->prodIndex] == 0) {
+        foundNullable(prod->left);
+      }
+    }
+  }
 
-          if (restDeriveEmpty) {
-            // we have discovered that prod->left can derive rightSym
-            bool chgd = addDerivable(prod->left, &rightNT);
-            xassert(chgd);    // above, we verified we didn't already know this
+  // ------- derives-alone edges -------
+  // the diagonal is cleared while closing, so a bit that comes back
+  // there means a cycle; edges N -> N from productions like N -> N
+  // are left out, as they always have been, so such a production
+  // alone doesn't make N cyclic
+  loopi(numNonterms) {
+    derivable->reset(point(i, i));
+  }
 
-            changes++;
+  for (auto const &prod : productions) {
+    if (unknown[prod.prodIndex] < 0) {
+      continue;        // a terminal can't be derived away
+    }
 
-            trace("derivable")
-              << "discovered (by production): " << prod->left->name
-              << " ->* " << rightNT.name << "\n";
-          }
-        }
+    // N derives M alone if every other RHS symbol can derive empty;
+    // so if two of them can't, it derives none alone
+    Nonterminal const *notNullable = NULL;
+    int numNotNullable = 0;
+    for (auto const &elt : prod.right) {
+      Nonterminal const *nt = &( elt.sym->asNonterminalC() );
+      if (!nullable[nt->ntIndex]) {
+        notNullable = nt;
+        numNotNullable++;
+      }
+    }
+    if (numNotNullable > 1) {
+      continue;
+    }
 
-        // ok, we've considered prod->left deriving rightSym.  now, we
-        // want to consider whether prod->left can derive any of the
-        // symbols that follow rightSym in this production.  for this
-        // to be true, rightSym itself must derive the emptyString
-        if (!canDeriveEmpty(&rightNT)) {
-          // it doesn't -- no point in further consideration of
-          // this production
-          break;
-        }
-      } // end of loop over RHS symbols
-    } // end of loop over productions
-
-
-    // -------- second part: compute closure over existing relations ------
-    // I'll do this by computing R + R^2 -- that is, I'll find all
-    // paths of length 2 and add an edge between their endpoints.
-    // I do this, rather than computing the entire closure now, since
-    // on the next iter I will add more relations and have to re-do
-    // a full closure; iterative progress seems a better way.
-
-    // I don't consider edges (u,u) because it messes up my cyclicty
-    // detection logic.  (But (u,v) and (v,u) is ok, and in fact is
-    // what I want, for detecting cycles.)
-
-    // for each node u (except empty)
-    int numNonterms = numNonterminals();
-    for (int u=1; u<numNonterms; u++) {
-      // for each edge (u,v) where u != v
-      for (int v=0; v<numNonterms; v++) {
-        if (u==v || !canDerive(u,v)) continue;
-
-        // for each edge (v,w) where v != w
-        for (int w=0; w<numNonterms; w++) {
-          if (v==w || !canDerive(v,w)) continue;
-
-          // add an edge (u,w), if there isn't one already
-          if (addDerivable(u,w)) {
-            changes++;
-            trace("derivable")
-              << "discovered (by closure step): "
-              << indexedNonterms[u]->name << " ->* "
-              << indexedNonterms[w]->name << "\n";
-          }
+    for (auto const &elt : prod.right) {
+      Nonterminal const *nt = &( elt.sym->asNonterminalC() );
+      if (nt == prod.left || (notNullable && nt != notNullable)) {
+        continue;
+      }
+      if (!canDerive(prod.left, nt)) {
+        derivable->set(point(prod.left->ntIndex, nt->ntIndex));
+        if (tr) {
+          trace("derivable")
+            << "discovered (by production): " << prod.left->name
+            << " ->* " << nt->name << "\n";
         }
       }
     }
+  }
 
-
-    // ------ finally: iterate until no changes -------
-    if (changes == 0) {
-      // didn't make any changes during the last iter, so
-      // everything has settled
-      break;
+  loopi(numNonterms) {
+    if (i != emptyIndex && nullable[i]) {
+      derivable->set(point(i, emptyIndex));
     }
-  } // end of loop until settles
+  }
+
+  // ------- closure -------
+  std::unique_ptr<Bit2d> before;
+  if (tr) {
+    before = std::make_unique<Bit2d>(*derivable);
+  }
+
+  transitiveClosure(*derivable, numThreads);
 
+  if (tr) {
+    for (int u=0; u < numNonterms; u++) {
+      for (int w=0; w < numNonterms; w++) {
+        if (u != w && canDerive(u, w) && !before->get(point(u, w))) {
+          trace("derivable")
+            << "discovered (by closure step): "
+            << indexedNonterms[u]->name << " ->* "
+            << indexedNonterms[w]->name << "\n";
+        }
+      }
+    }
+  }
 
-  // I used to do all closure here and no closure in the loop.
-  // But that fails in cases where closure (when it reveals
-  // more things that derive emptyString) yields new opportunities
-  // for derives-relation discovery.  Therefore I now alternate
-  // between them, and at the end, no closure is necessary.
+  // N ->+ N marks N as cyclic; and every N ->* N in 0 steps
+  loopi(numNonterms) {
+    if (canDerive(i, i)) {
+      addDerivable(i, i);
+    }
+    derivable->set(point(i, i));
+  }
 }
 
 
@@ -1577,37 +1661,69 @@ void GrammarAnalysis::computeFirst()
   bool tr = tracingSys("first");
   int numTerms = numTerminals();
 
-  // iterate, looking for new First members, until no changes
-  int changes = 1;   // so the loop begins
-  while (changes > 0) {
-    changes = 0;
+  // First(LHS) has the terminal that begins the RHS after any prefix
+  // of nonterminals that can derive empty, and First(N) for each N in
+  // that prefix; the terminals go in once, then the First sets are
+  // pushed along the N's until they stop growing, revisiting only the
+  // nonterminals whose First just grew
 
-    // for each production
-    for (auto prod = productions.begin(); prod != productions.end(); ++prod) {
-      // convenient aliases
-      Nonterminal *LHS = prod->left;
-        // the list iter is mutating because I modify LHS's First set
+  // for each nonterminal N, the productions whose LHS's First
+  // includes First(N)
+  std::vector<std::vector<Production*>> beginning(numNonterms);
+  std::vector<bool> queued(numNonterms, false);
+  std::vector<int> worklist;
+
+  auto added = [&](Production const *prod, TerminalSet const &set) {
+    if (tr) {
+      std::ostream &trs = trace("first");
+      trs << "added ";
+      set.print(trs, *this);
+      trs << " to " << prod->left->name << " because of "
+          << prod->toString() << std::endl;
+    }
+    int i = prod->left->ntIndex;
+    if (!queued[i]) {
+      queued[i] = true;
+      worklist.push_back(i);
+    }
+  };
 
-      // compute First(RHS-sequence)
-      TerminalSet firstOfRHS(numTerms);
-      firstOfSequence(firstOfRHS, prod->right);
+  for (auto &prod : productions) {
+    TerminalSet terms(numTerms);
+    for (auto const &elt : prod.right) {
+      if (elt.sym->isTerminal()) {
+        terms.add(elt.sym->asTerminal().termIndex);
+        break;
+      }
+      Nonterminal const &nt = elt.sym->asNonterminalC();
+      beginning[nt.ntIndex].push_back(&prod);
+      if (!canDeriveEmpty(&nt)) {
+        break;
+      }
+    }
 
-      // store this back into 'prod'
-      prod->firstSet.merge(firstOfRHS);
+    if (prod.left->first.merge(terms)) {
+      added(&prod, terms);
+    }
+  }
 
-      // add everything in First(RHS-sequence) to First(LHS)
-      if (LHS->first.merge(firstOfRHS)) {
-        changes++;
-        if (tr) {
-          std::ostream &trs = trace("first");
-          trs << "added ";
-          firstOfRHS.print(trs, *this);
-          trs << " to " << LHS->name << " because of "
-              << prod->toString() << std::endl;
-        }
+  while (!worklist.empty()) {
+    int i = worklist.back();
+    worklist.pop_back();
+    queued[i] = false;
+
+    Nonterminal const *nt = indexedNonterms[i];
+    for (Production *prod : beginning[i]) {
+      if (prod->left->first.merge(nt->first)) {
+        added(prod, nt->first);
       }
-    } // for (productions)
-  } // while (changes)
+    }
+  }
+
+  // and each production's First, from the finished sets
+  for (auto &prod : productions) {
+    firstOfSequence(prod.firstSet, prod.right);
+  }
 
   if (tr) {
     for (auto const& nt : nonterminals) {
@@ -1682,83 +1798,107 @@ void GrammarAnalysis::computeDProdFirsts()
 }
 
 
+// Follow(B) includes First(beta) for each production A -> alpha B
+// beta, and Follow(A) if beta can derive empty.  The first part is
+// fixed once First is known, so it goes in once; then the Follow sets
+// are pushed along the second part, as in 'computeFirst'.
 void GrammarAnalysis::computeFollow()
 {
   int numTerms = numTerminals();
 
-  // loop until no changes
-  int changes = 1;
-  while (changes > 0) {
-    changes = 0;
+  // for each nonterminal A, the B's whose Follow includes Follow(A),
+  // with the production that says so
+  std::vector<std::vector<std::pair<Nonterminal*, Production const*>>>
+    ending(numNonterms);
+  std::vector<bool> queued(numNonterms, false);
+  std::vector<int> worklist;
+
+  auto added = [&](Nonterminal &nt, TerminalSet const &set,
+                   char const *why, Production const &prod) {
+    if (&nt == symOfInterest) {
+      std::ostream &trs = trace("follow-sym");
+      trs << "Follow(" << nt.name << "): adding ";
+      set.print(trs, *this);
+      trs << " by " << why << " of " << prod << std::endl;
+    }
+    if (!queued[nt.ntIndex]) {
+      queued[nt.ntIndex] = true;
+      worklist.push_back(nt.ntIndex);
+    }
+  };
 
-    // 'mutate' is needed because adding 'term' to the follow of 'nt'
-    // needs a mutable 'term' and 'nt'
+  // 'mutate' is needed because adding 'term' to the follow of 'nt'
+  // needs a mutable 'term' and 'nt'
 
-    // for each production
-    for (auto prod = productions.begin(); prod != productions.end(); ++prod) {
+  // for each production
+  for (auto prod = productions.begin(); prod != productions.end(); ++prod) {
 
-      // for each RHS nonterminal member
-      auto const rightEnd = prod->right.end();
-      for (auto rightSym = prod->right.begin(); rightSym != rightEnd; ++rightSym) {
-        if (rightSym->sym->isTerminal()) continue;
+    // for each RHS nonterminal member
+    auto const rightEnd = prod->right.end();
+    for (auto rightSym = prod->right.begin(); rightSym != rightEnd; ++rightSym) {
+      if (rightSym->sym->isTerminal()) continue;
 
-        // convenient alias
-        Nonterminal &rightNT = rightSym->sym->asNonterminal();
+      // convenient alias
+      Nonterminal &rightNT = rightSym->sym->asNonterminal();
 
-        // I'm not sure what it means to compute Follow(emptyString),
-        // so let's just not do so
-        if (&rightNT == &emptyString) {
-          continue;
-        }
+      // I'm not sure what it means to compute Follow(emptyString),
+      // so let's just not do so
+      if (&rightNT == &emptyString) {
+        continue;
+      }
 
-        // an iterator pointing to the symbol just after
-        // 'rightSym' will be useful below
-        auto afterRightSym = std::next(rightSym);
-        // NOTE: it may be at the end now
-
-        // rule 1:
-        // if there is a production A -> alpha B beta, then
-        // everything in First(beta) is in Follow(B)
-        {
-          // compute First(beta)
-          TerminalSet firstOfBeta(numTerms);
-          firstOfIterSeq(firstOfBeta, afterRightSym, rightEnd);
-
-          // put those into Follow(rightNT)
-          if (rightNT.follow.merge(firstOfBeta)) {
-            changes++;
-            if (&rightNT == symOfInterest) {
-              std::ostream &trs = trace("follow-sym");
-              trs << "Follow(" << rightNT.name
-                  << "): adding ";
-              firstOfBeta.print(trs, *this);
-              trs << " by first(RHS-tail) of " << *prod
-                  << std::endl;
-            }
-          }
+      // an iterator pointing to the symbol just after
+      // 'rightSym' will be useful below
+      auto afterRightSym = std::next(rightSym);
+      // NOTE: it may be at the end now
+
+      // rule 1:
+      // if there is a production A -> alpha B beta, then
+      // everything in First(beta) is in Follow(B)
+      {
+        // compute First(beta)
+        TerminalSet firstOfBeta(numTerms);
+        firstOfIterSeq(firstOfBeta, afterRightSym, rightEnd);
+
+        // put those into Follow(rightNT)
+        if (rightNT.follow.merge(firstOfBeta)) {
+          added(rightNT, firstOfBeta, "first(RHS-tail)", *prod);
         }
+      }
 
-        // rule 2:
-        // if there is a production A -> alpha B, or a
-        // production A -> alpha B beta where beta ->* empty ...
-        if (iterSeqCanDeriveEmpty(afterRightSym, rightEnd)) {
-          // ... then everything in Follow(A) is in Follow(B)
-          if (rightNT.follow.merge(prod->left->follow)) {
-            changes++;
-            if (&rightNT == symOfInterest) {
-              std::ostream &trs = trace("follow-sym");
-              trs << "Follow(" << rightNT.name
-                  << "): adding ";
-              prod->left->follow.print(trs, *this);
-              trs << " by follow(LHS) of " << *prod
-                  << std::endl;
-            }
-          }
-        }
+      // rule 2:
+      // if there is a production A -> alpha B, or a
+      // production A -> alpha B beta where beta ->* empty ...
+      if (iterSeqCanDeriveEmpty(afterRightSym, rightEnd) &&
+          &rightNT != prod->left) {
+        // ... then everything in Follow(A) is in Follow(B)
+        ending[prod->left->ntIndex].push_back(std::make_pair(&rightNT, &*prod));
+      }
+
+    } // for each RHS nonterminal member
+  } // for each production
+
+  // whatever the Follow sets have so far, from rule 1 or from
+  // before, has to be passed on
+  for (auto &nt : nonterminals) {
+    if (!queued[nt.ntIndex]) {
+      queued[nt.ntIndex] = true;
+      worklist.push_back(nt.ntIndex);
+    }
+  }
 
-      } // for each RHS nonterminal member
-    } // for each production
-  } // until no changes
+  while (!worklist.empty()) {
+    int i = worklist.back();
+    worklist.pop_back();
+    queued[i] = false;
+
+    Nonterminal const *left = indexedNonterms[i];
+    for (auto const &e : ending[i]) {
+      if (e.first->follow.merge(left->follow)) {
+        added(*e.first, left->follow, "follow(LHS)", *e.second);
+      }
+    }
+  }
 }
 
 
@@ -1831,9 +1971,17 @@ void GrammarAnalysis::computePredictiveParsingTable()
 }
 
 
+void GrammarAnalysis::itemSetClosure(ItemSet &itemSet)
+{
+  std::vector<LRItem*> onWorklist(numProds, NULL);
+  itemSetClosure(itemSet, onWorklist);
+}
+
+
 // based on [ASU] figure 4.33, p.223
 // NOTE: sometimes this is called with nonempty nonkernel items...
-void GrammarAnalysis::itemSetClosure(ItemSet &itemSet)
+void GrammarAnalysis::itemSetClosure(ItemSet &itemSet,
+                                     std::vector<LRItem*> &onWorklist)
 {
   bool const tr = tracingSys("closure");
   std::ostream &trs = trace("closure");     // trace stream
@@ -1842,8 +1990,11 @@ void GrammarAnalysis::itemSetClosure(ItemSet &itemSet)
     itemSet.print(trs, *this);
   }
 
-  // every 'item' on the worklist has item->dprod->backPointer == item;
-  // every 'dprod' not associated has dprod->backPointer == NULL
+  // every 'item' on the worklist has onWorklist[item->prodIndex()] == item;
+  // every other entry of 'onWorklist' is NULL (only dot-0 dprods are
+  // ever put on the worklist, so the production index identifies the
+  // dprod); this used to be a backpointer in the dprod itself, but
+  // that made it impossible to close two item sets at once
   sm::stack<LRItem*> worklist;
 
   // scratch terminal set for singleItemClosure
@@ -1862,15 +2013,15 @@ void GrammarAnalysis::itemSetClosure(ItemSet &itemSet)
 
   // first, close the kernel items -> worklist
   for (LRItem const *ik : itemSet.kernelItems) {
-    singleItemClosure(finished, worklist, ik, scratchSet);
+    singleItemClosure(finished, worklist, onWorklist, ik, scratchSet);
   }
 
   while (!worklist.empty()) {
     // pull the first production
     LRItem* item = worklist.top();
     worklist.pop();
-    xassert(item->dprod->backPointer == item);     // was on worklist
-    item->dprod->backPointer = NULL;               // now off of worklist
+    xassert(onWorklist[item->prodIndex()] == item);   // was on worklist
+    onWorklist[item->prodIndex()] = NULL;             // now off of worklist
 
     // put it into list of 'done' items; this way, if this
     // exact item is generated during closure, it will be
@@ -1879,7 +2030,7 @@ void GrammarAnalysis::itemSetClosure(ItemSet &itemSet)
     finished.insert(std::make_pair(item->dprod, item));
 
     // close it -> worklist
-    singleItemClosure(finished, worklist, item, scratchSet);
+    singleItemClosure(finished, worklist, onWorklist, item, scratchSet);
   }
 
   // move everything from 'finished' to the nonkernel items list
@@ -1887,8 +2038,7 @@ void GrammarAnalysis::itemSetClosure(ItemSet &itemSet)
     for (std::pair<const DottedProduction *, LRItem*> const &f : finished) {
       // temporarily, the item is owned both by the hashtable
       // and the list
-      itemSet.nonkernelItems.insert(itemSet.nonkernelItems.begin(), f.second);
-      // FIXME probably doesn't need to be up front
+      itemSet.nonkernelItems.push_back(f.second);
     }
     finished.clear();
   }
@@ -1900,6 +2050,11 @@ void GrammarAnalysis::itemSetClosure(ItemSet &itemSet)
     throw;
   }
 
+  // the hashtable's iteration order depends on the history of the
+  // table, so put the items in a canonical order; among other things,
+  // this determines the order of reductions in ambiguous table entries
+  sm::sortSList(itemSet.nonkernelItems, LRItem::diff);
+
   // we potentially added a bunch of things
   itemSet.changedItems();
 
@@ -1913,6 +2068,7 @@ void GrammarAnalysis::itemSetClosure(ItemSet &itemSet)
 void GrammarAnalysis
   ::singleItemClosure(Finished &finished,
                       sm::stack<LRItem*> &worklist,
+                      std::vector<LRItem*> &onWorklist,
                       LRItem const *item, TerminalSet &newItemLA)
 {
   INITIAL_MALLOC_STATS();
@@ -1981,18 +2137,22 @@ void GrammarAnalysis
     // get beta (what follows B in 'item')
     DottedProduction const *beta = nextDProd(item->dprod);
 
-    // get First(beta) -> new item's lookahead
-    newItemLA = beta->firstSet;
+    // when only building the LR(0) automaton, all lookaheads stay
+    // empty ('newItemLA' is never set)
+    if (closureLookaheads) {
+      // get First(beta) -> new item's lookahead
+      newItemLA = beta->firstSet;
 
-    // if beta ->* epsilon, add LA
-    if (beta->canDeriveEmpty) {
-      newItemLA.merge(item->lookahead);
-    }
+      // if beta ->* epsilon, add LA
+      if (beta->canDeriveEmpty) {
+        newItemLA.merge(item->lookahead);
+      }
 
-    // except we do not want to put terminals in the lookahead set
-    // for which 'prod' is not allowed to reduce when they are next
-    if (!prod.forbid.empty()) {
-      newItemLA.removeSet(prod.forbid);
+      // except we do not want to put terminals in the lookahead set
+      // for which 'prod' is not allowed to reduce when they are next
+      if (!prod.forbid.empty()) {
+        newItemLA.removeSet(prod.forbid);
+      }
     }
 
     if (tr) {
@@ -2007,7 +2167,7 @@ void GrammarAnalysis
     // is 'newDP' already there?
     // check in working and finished tables
     bool inDoneList = true;
-    LRItem *already = newDP->backPointer;   // workhash.lookup(newDP);
+    LRItem *already = onWorklist[prod.prodIndex];   // workhash.lookup(newDP);
     if (already) {
       inDoneList = false;
     }
@@ -2041,8 +2201,8 @@ void GrammarAnalysis
           finished.erase(already->dprod);
           CHECK_MALLOC_STATS("before worklist push");
           worklist.push(already);
-          xassert(already->dprod->backPointer == NULL);   // was not on
-          already->dprod->backPointer = already;          // now is on worklist
+          xassert(onWorklist[prod.prodIndex] == NULL);   // was not on
+          onWorklist[prod.prodIndex] = already;          // now is on worklist
           UPDATE_MALLOC_STATS();     // allow expansion
         }
         else {
@@ -2067,8 +2227,8 @@ void GrammarAnalysis
       }
 
       worklist.push(newItem);
-      xassert(newItem->dprod->backPointer == NULL);
-      newItem->dprod->backPointer = newItem;
+      xassert(onWorklist[prod.prodIndex] == NULL);
+      onWorklist[prod.prodIndex] = newItem;
 
       UPDATE_MALLOC_STATS();     // "new LRItem" or expansion of worklist
     }
@@ -2219,8 +2379,70 @@ struct ItemSetEquals {
 
 
 // [ASU] fig 4.34, p.224
-// puts the finished parse tables into 'itemSetsDone'
+// puts the finished parse tables into 'itemSets'
 void GrammarAnalysis::constructLRItemSets()
+{
+  // with relational lookaheads, first build the LR(0) automaton, which
+  // has the same states as the LALR(1) one
+  // (which is also what the incremental construction reuses)
+  bool const relational = (relationalLookaheads || !automatonFname.empty()) &&
+                          LALR1 && !minimalLR1;
+  closureLookaheads = !relational;
+
+  if (minimalLR1) {
+    std::vector<ItemSet*> lr1;
+    constructCanonicalLR1ItemSets(lr1);
+    traceProgress(1) << "merging " << lr1.size()
+                     << " canonical LR(1) states...\n";
+    mergeLR1ItemSets(lr1);
+  }
+  // the parallel construction only knows how to do LALR(1), and does
+  // not try to produce the traces in a sensible order
+  else if (relational && !automatonFname.empty() &&
+           !tracingSys("lrsets") && !tracingSys("closure")) {
+    constructLRItemSetsIncremental();
+  }
+  else if (numThreads > 1 && LALR1 &&
+      !tracingSys("lrsets") && !tracingSys("closure")) {
+    constructLRItemSetsParallel();
+  }
+  else {
+    constructLRItemSetsSerial();
+  }
+
+  closureLookaheads = true;
+  if (relational) {
+    traceProgress(1) << "LALR(1) lookaheads...\n";
+    computeRelationalLookaheads();
+  }
+
+  traceProgress(1) << "done with LR sets: " << itemSets.size()
+                   << " states\n";
+
+
+  // do the BFS now, since we want to print the sample inputs
+  // in the loop that follows
+  traceProgress(1) << "BFS tree on transition graph...\n";
+  computeBFSTree();
+
+  if (tracingSys("itemset-graph")) {
+    // write this info to a graph applet file
+    std::ofstream out("lrsets.g");
+    if (!out) {
+      xsyserror("std::ofstream open");
+    }
+    out << "# lr sets in graph form\n";
+
+    for (ItemSet const *itemSet : itemSets) {
+      itemSet->writeGraph(out, *this);
+    }
+  }
+}
+
+
+// depth-first worklist algorithm: when a lookahead change reaches a
+// state that is already done, it goes back on the pending list
+void GrammarAnalysis::constructLRItemSetsSerial()
 {
   bool tr = tracingSys("lrsets");
 
@@ -2258,6 +2480,9 @@ void GrammarAnalysis::constructLRItemSets()
   std::vector<DottedProduction const*> kernelCRCArray;
   kernelCRCArray.reserve(BIG_VALUE);
 
+  // and one for itemSetClosure
+  std::vector<LRItem*> onWorklist(numProds, NULL);
+
   // start by constructing closure of first production
   // (basically assumes first production has start symbol
   // on LHS, and no other productions have the start symbol
@@ -2275,7 +2500,7 @@ void GrammarAnalysis::constructLRItemSets()
     //firstDP->laAdd(0 /*EOF token id*/);
 
     is->sortKernelItems();                    // redundant, but can't hurt
-    itemSetClosure(*is);                      // calls changedItems internally
+    itemSetClosure(*is, onWorklist);                      // calls changedItems internally
 
     // this makes the initial pending itemSet
     itemSetsPending.insert(is);
@@ -2391,7 +2616,7 @@ void GrammarAnalysis::constructLRItemSets()
 
             // this changed 'already'; recompute its closure
             if (already != itemSet) {
-              itemSetClosure(*already);
+              itemSetClosure(*already, onWorklist);
             }
             else {
               // DANGER!  I'm already iterating over 'itemSet's item lists,
@@ -2434,7 +2659,7 @@ void GrammarAnalysis::constructLRItemSets()
           }
 
           // finish it by computing its closure
-          itemSetClosure(*withDotMoved);
+          itemSetClosure(*withDotMoved, onWorklist);
 
           // then add it to 'pending'
           itemSetsPending.insert(withDotMoved);
@@ -2468,7 +2693,7 @@ void GrammarAnalysis::constructLRItemSets()
     // now that we're finished iterating over the items, I can do the
     // postponed closure
     if (mustCloseMyself) {
-      itemSetClosure(*itemSet);
+      itemSetClosure(*itemSet, onWorklist);
       UPDATE_MALLOC_STATS();
     }
 
@@ -2492,32 +2717,1032 @@ void GrammarAnalysis::constructLRItemSets()
   // states end up out of order; put them back in order
   sm::sortSList(itemSets, ItemSet::diffById);
 
+  // Ensure we didn't leak anything
+  xassert(itemSetsPending.empty());
+  xassert(itemSetsDone.empty());
+}
 
-  traceProgress(1) << "done with LR sets: " << itemSets.size()
-                   << " states\n";
 
+// append to 'moves' the kernel reached from 'source' on each symbol
+// that follows a dot in it, in item order; the kernels are new item
+// sets with no id, owned by the caller, and not yet closed
+void GrammarAnalysis::moveDotAllSymbols(ItemSet const *source, Moves &moves,
+                                        std::vector<DottedProduction const*> &array)
+{
+  size_t const first = moves.size();
+  for (LRItem const *item : source->getAllItems()) {
+    if (item->isDotAtEnd()) continue;
+    Symbol const *sym = item->symbolAfterDotC();
 
-  // do the BFS now, since we want to print the sample inputs
-  // in the loop that follows
-  traceProgress(1) << "BFS tree on transition graph...\n";
-  computeBFSTree();
+    bool seen = false;
+    for (size_t i = first; i < moves.size(); i++) {
+      if (moves[i].first == sym) {
+        seen = true;
+        break;
+      }
+    }
+    if (seen) continue;
 
-  if (tracingSys("itemset-graph")) {
-    // write this info to a graph applet file
-    std::ofstream out("lrsets.g");
-    if (!out) {
-      xsyserror("std::ofstream open");
+    ItemSet *candidate = new ItemSet(STATE_INVALID, numTerms, numNonterms);
+    std::vector<LRItem *> unusedTail;
+    moveDotNoClosure(source, sym, candidate, unusedTail, array);
+    xassert(unusedTail.empty());
+    moves.push_back(std::make_pair(sym, candidate));
+  }
+}
+
+
+// run 'fn(i, t)' for each 'i' in [0,n), spread over up to 'numThreads'
+// threads; 't' says which thread (0 is the caller's), so 'fn' can use
+// per-thread scratch space; the first exception thrown by any call is
+// rethrown here once all the threads have stopped
+static void parallelFor(int numThreads, int n,
+                        std::function<void (int i, int t)> const &fn)
+{
+  std::atomic<int> next(0);
+  std::exception_ptr failure;
+  std::mutex failureMutex;
+
+  auto worker = [&](int t) {
+    try {
+      for (int i = next++; i < n; i = next++) {
+        fn(i, t);
+      }
     }
-    out << "# lr sets in graph form\n";
+    catch (...) {
+      std::lock_guard<std::mutex> lock(failureMutex);
+      if (!failure) {
+        failure = std::current_exception();
+      }
+      next = n;      // stop the others soon
+    }
+  };
 
-    for (ItemSet const *itemSet : itemSets) {
-      itemSet->writeGraph(out, *this);
+  std::vector<std::thread> threads;
+  for (int t=1; t < (std::min)(numThreads, n); t++) {
+    threads.emplace_back(worker, t);
+  }
+  worker(0);
+  for (std::thread &th : threads) {
+    th.join();
+  }
+
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+
+// the item sets built so far, split by kernel CRC into independently
+// locked shards so several threads can look up and insert at once
+struct ConcurrentItemSetTable {
+  enum { NUM_SHARDS = 64 };
+
+  struct Shard {
+    std::mutex mutex;
+
+    // all the item sets whose kernel hashes to this shard
+    std::unordered_set<ItemSet*, ItemSetHash, ItemSetEquals> sets;   // (owner)
+
+    // members of 'sets' that already had an id at the start of the
+    // current round and whose kernel lookaheads have grown since
+    std::unordered_set<ItemSet*> changed;                           // (serfs)
+  };
+  Shard shards[NUM_SHARDS];
+
+  Shard &shardFor(ItemSet const *is)
+    { return shards[ItemSetHash()(is) % NUM_SHARDS]; }
+};
+
+
+// same result as the serial algorithm, computed in rounds: each
+// round takes every state whose outgoing transitions are not yet
+// known to be up to date (the "frontier"), builds the kernels they
+// lead to, finds or creates the corresponding states (merging
+// lookaheads into existing ones), and then closes every state that is
+// new or whose lookaheads changed; those states form the next
+// frontier.  Within a round each phase runs on all threads, with a
+// barrier between phases, so no state is read while it is written.
+//
+// Everything that depends on timing is kept out of the result: new
+// states are numbered by walking the frontier in order, and
+// renumberStates later gives the states their canonical numbers, so
+// the tables come out the same as with the serial algorithm.
+void GrammarAnalysis::constructLRItemSetsParallel()
+{
+  ConcurrentItemSetTable table;
+
+  // per-thread scratch space
+  std::vector<std::vector<LRItem*>> onWorklist(
+    numThreads, std::vector<LRItem*>(numProds, NULL));
+  std::vector<std::vector<DottedProduction const*>> kernelCRCArray(numThreads);
+
+  // the start state, as in the serial version
+  {
+    ItemSet *is = makeItemSet();              // (owner)
+    startState = is;
+    is->addKernelItem(numTerms, getDProd(&productions.front(), 0 /*dot at left*/));
+    is->sortKernelItems();
+    itemSetClosure(*is, onWorklist[0]);
+    table.shardFor(is).sets.insert(is);       // (ownership transfer)
+  }
+
+  std::vector<ItemSet*> frontier;             // (serfs)
+  frontier.push_back(startState);
+
+  while (!frontier.empty()) {
+    // for each frontier state, the kernels it reaches; the states
+    // start out as candidates owned by this list, and are replaced by
+    // the states actually used
+    std::vector<Moves> moves(frontier.size());
+
+    // phase 1: move the dot across each symbol
+    parallelFor(numThreads, frontier.size(), [&](int i, int t) {
+      moveDotAllSymbols(frontier[i], moves[i], kernelCRCArray[t]);
+    });
+
+    // phase 2: find each candidate's state, or make the candidate a
+    // new state; only the shard lock protects lookaheads here, since
+    // all writes to a given state's kernel happen under its shard's lock
+    parallelFor(numThreads, frontier.size(), [&](int i, int) {
+      ItemSet *source = frontier[i];
+      for (std::pair<Symbol const*, ItemSet*> &m : moves[i]) {
+        ItemSet *candidate = m.second;
+        ConcurrentItemSetTable::Shard &shard = table.shardFor(candidate);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ItemSet *already = sm::getPointerFromSet(shard.sets, candidate);
+        if (already) {
+          if (candidate->mergeLookaheadsInto(*already) &&
+              already->id != STATE_INVALID) {
+            // states made this round get closed anyway
+            shard.changed.insert(already);
+          }
+          delete candidate;
+          m.second = already;
+        }
+        else {
+          shard.sets.insert(candidate);       // (ownership transfer)
+        }
+
+        // only this thread touches 'source' in this phase
+        source->setTransition(m.first, m.second);
+      }
+    });
+
+    // number the new states in frontier order, so the numbering does
+    // not depend on which thread inserted them
+    std::vector<ItemSet*> next;
+    for (Moves const &ms : moves) {
+      for (std::pair<Symbol const*, ItemSet*> const &m : ms) {
+        if (m.second->id == STATE_INVALID) {
+          m.second->id = (StateId)(nextItemSetId++);
+          next.push_back(m.second);
+        }
+      }
+    }
+    for (ConcurrentItemSetTable::Shard &shard : table.shards) {
+      next.insert(next.end(), shard.changed.begin(), shard.changed.end());
+      shard.changed.clear();
+    }
+    std::sort(next.begin(), next.end(),
+      [](ItemSet const *a, ItemSet const *b) { return a->id < b->id; });
+
+    // phase 3: close the new and changed states; they are the ones
+    // whose transitions must be (re)computed next round
+    parallelFor(numThreads, next.size(), [&](int i, int t) {
+      itemSetClosure(*next[i], onWorklist[t]);
+    });
+
+    frontier.swap(next);
+  }
+
+  // move all of the states out of the table and into 'this->itemSets'
+  for (ConcurrentItemSetTable::Shard &shard : table.shards) {
+    itemSets.insert(itemSets.end(), shard.sets.begin(), shard.sets.end());
+    shard.sets.clear();
+  }
+  sm::sortSList(itemSets, ItemSet::diffById);
+}
+
+
+// ---------------- incremental LR(0) item sets ----------------
+// The LR(0) automaton of an earlier run, as saved by
+// constructLRItemSetsIncremental.  Productions are saved as text,
+// because their indices change along with the grammar; the items
+// refer to them by position in 'prods'.
+struct SavedAutomaton {
+  typedef std::vector<std::pair<int,int>> Items;     // (production, dot)
+
+  struct State {
+    Items kernel;                   // sorted
+    Items nonkernel;
+    std::vector<int> successors;    // state indices
+  };
+
+  std::vector<string> prods;
+  std::vector<State> states;
+
+  void xfer(Flatten &flat);
+};
+
+// bump this whenever the saved automaton format changes
+enum { SAVED_AUTOMATON_VERSION = 1 };
+enum { SAVED_AUTOMATON_MAGIC = 0x656c6b30 };
+
+static void xferItems(Flatten &flat, SavedAutomaton::Items &items)
+{
+  int n = items.size();
+  flat.xferInt(n);
+  items.resize(n);
+  for (std::pair<int,int> &item : items) {
+    flat.xferInt(item.first);
+    flat.xferInt(item.second);
+  }
+}
+
+void SavedAutomaton::xfer(Flatten &flat)
+{
+  flat.checkpoint(SAVED_AUTOMATON_MAGIC);
+  flat.checkpoint(SAVED_AUTOMATON_VERSION);
+
+  int n = prods.size();
+  flat.xferInt(n);
+  prods.resize(n);
+  for (string &p : prods) {
+    flat.xferString(p);
+  }
+
+  n = states.size();
+  flat.xferInt(n);
+  states.resize(n);
+  for (State &s : states) {
+    xferItems(flat, s.kernel);
+    xferItems(flat, s.nonkernel);
+
+    n = s.successors.size();
+    flat.xferInt(n);
+    s.successors.resize(n);
+    for (int &succ : s.successors) {
+      flat.xferInt(succ);
     }
   }
 
-  // Ensure we didn't leak anything
-  xassert(itemSetsPending.empty());
-  xassert(itemSetsDone.empty());
+  // every index must be in range, so the rest can use them freely
+  for (State const &s : states) {
+    for (SavedAutomaton::Items const *items : { &s.kernel, &s.nonkernel }) {
+      for (std::pair<int,int> const &item : *items) {
+        formatAssert((unsigned)item.first < prods.size());
+      }
+    }
+    for (int succ : s.successors) {
+      formatAssert((unsigned)succ < states.size());
+    }
+  }
+}
+
+
+// the text by which a saved automaton identifies 'prod'
+static string productionSignature(Production const &prod)
+{
+  string ret(prod.left->name.str);
+  ret += " ->";
+  for (Production::RHSElt const &elt : prod.right) {
+    ret += elt.sym->isTerminal()? " t:" : " n:";
+    ret += elt.sym->name.str;
+  }
+  return ret;
+}
+
+
+// The same LR(0) automaton that constructLRItemSetsSerial builds
+// with closureLookaheads==false, but reusing the one saved in
+// 'automatonFname' by an earlier run, if any: a state's closure only
+// depends on its kernel and on the productions of the nonterminals
+// the closure expands, so when a state's kernel matches a saved state
+// whose expanded nonterminals all have the same productions now, the
+// saved nonkernel items and successor kernels are used instead of
+// computing them.  Afterwards the new automaton is saved there.
+void GrammarAnalysis::constructLRItemSetsIncremental()
+{
+  SavedAutomaton old;
+  if (fileOrDirectoryExists(automatonFname.c_str())) {
+    try {
+      BFlatten flat(automatonFname.c_str(), true /*reading*/);
+      old.xfer(flat);
+    }
+    catch (xBase &x) {
+      traceProgress() << "not reusing " << automatonFname << ": "
+                      << x.why() << std::endl;
+      old = SavedAutomaton();
+    }
+  }
+
+  // map the saved productions to ours, and back
+  std::vector<Production const*> oldToNew(old.prods.size(), NULL);
+  std::vector<int> newToOld(numProds, -1);
+  {
+    std::unordered_map<string, int> bySignature;
+    for (int p=0; p < numProds; p++) {
+      bySignature[productionSignature(*getProduction(p))] = p;
+    }
+    for (int o=0; o < (int)old.prods.size(); o++) {
+      auto it = bySignature.find(old.prods[o]);
+      if (it != bySignature.end()) {
+        oldToNew[o] = getProduction(it->second);
+        newToOld[it->second] = o;
+      }
+    }
+  }
+
+  // a nonterminal is unchanged if it has exactly the productions it
+  // had before
+  std::vector<bool> unchanged(numNonterms, false);
+  {
+    std::vector<std::vector<int>> oldByLHS(numNonterms);
+    std::vector<bool> lost(numNonterms, false);
+    for (int o=0; o < (int)old.prods.size(); o++) {
+      // the saved production's LHS is the text before " ->"
+      string lhs = old.prods[o].substr(0, old.prods[o].find(" ->"));
+      Nonterminal const *nt = findNonterminalC(lhs.c_str());
+      if (!nt) continue;
+      oldByLHS[nt->ntIndex].push_back(o);
+      if (!oldToNew[o]) {
+        lost[nt->ntIndex] = true;       // production was removed
+      }
+    }
+    for (int nt=0; nt < numNonterms; nt++) {
+      bool same = !lost[nt];
+      for (Production const *prod : productionsByLHS[nt]) {
+        if (newToOld[prod->prodIndex] < 0) {
+          same = false;                 // production was added
+        }
+      }
+      unchanged[nt] = same &&
+        oldByLHS[nt].size() == productionsByLHS[nt].size();
+    }
+  }
+
+  // saved states whose closure is still valid, by kernel: all of their
+  // items still exist, and every nonterminal after a dot (these are
+  // the ones the closure expands) is unchanged
+  std::map<SavedAutomaton::Items, int> reusable;
+  for (int s=0; s < (int)old.states.size(); s++) {
+    SavedAutomaton::State const &st = old.states[s];
+    bool ok = true;
+    for (SavedAutomaton::Items const *items : { &st.kernel, &st.nonkernel }) {
+      for (std::pair<int,int> const &item : *items) {
+        Production const *prod = oldToNew[item.first];
+        if (!prod || item.second < 0 || item.second > prod->rhsLength()) {
+          ok = false;
+          continue;
+        }
+        DottedProduction const *dp = getDProd(prod, item.second);
+        if (!dp->isDotAtEnd() &&
+            dp->symbolAfterDotC()->isNonterminal() &&
+            !unchanged[dp->symbolAfterDotC()->asNonterminalC().ntIndex]) {
+          ok = false;
+        }
+      }
+    }
+    if (ok) {
+      reusable[st.kernel] = s;
+    }
+  }
+
+  // the saved state whose closure 'is' can use, or -1
+  auto findReusable = [&](ItemSet const *is) -> int {
+    SavedAutomaton::Items kernel;
+    for (LRItem const *item : is->kernelItems) {
+      int o = newToOld[item->prodIndex()];
+      if (o < 0) {
+        return -1;
+      }
+      kernel.push_back(std::make_pair(o, item->getDot()));
+    }
+    std::sort(kernel.begin(), kernel.end());
+    auto it = reusable.find(kernel);
+    return it == reusable.end()? -1 : it->second;
+  };
+
+  std::unordered_set<ItemSet*, ItemSetHash, ItemSetEquals> table;   // (owner)
+  std::vector<ItemSet*> worklist;                                   // (serfs)
+  std::vector<LRItem*> onWorklist(numProds, NULL);
+  std::vector<DottedProduction const*> kernelCRCArray;
+  int numReused = 0;
+
+  {
+    ItemSet *is = makeItemSet();              // (owner)
+    startState = is;
+    is->addKernelItem(numTerms, getDProd(&productions.front(), 0 /*dot at left*/));
+    is->sortKernelItems();
+    is->computeKernelCRC(kernelCRCArray);
+    table.insert(is);                         // (ownership transfer)
+    worklist.push_back(is);
+  }
+
+  // breadth first, so the state ids come out in a sensible order
+  for (size_t w = 0; w < worklist.size(); w++) {
+    ItemSet *source = worklist[w];
+    Moves moves;
+
+    int o = findReusable(source);
+    if (o >= 0) {
+      numReused++;
+      SavedAutomaton::State const &st = old.states[o];
+      for (std::pair<int,int> const &item : st.nonkernel) {
+        source->addNonkernelItem(numTerms, getDProd(oldToNew[item.first], item.second));
+      }
+      sm::sortSList(source->nonkernelItems, LRItem::diff);
+      source->changedItems();
+
+      for (int succ : st.successors) {
+        ItemSet *candidate = new ItemSet(STATE_INVALID, numTerms, numNonterms);
+        for (std::pair<int,int> const &item : old.states[succ].kernel) {
+          candidate->addKernelItem(numTerms, getDProd(oldToNew[item.first], item.second));
+        }
+        candidate->sortKernelItems();
+        candidate->computeKernelCRC(kernelCRCArray);
+        Symbol const *sym = candidate->kernelItems.front()->dprod->symbolBeforeDotC();
+        moves.push_back(std::make_pair(sym, candidate));
+      }
+    }
+    else {
+      itemSetClosure(*source, onWorklist);
+      moveDotAllSymbols(source, moves, kernelCRCArray);
+    }
+
+    for (std::pair<Symbol const*, ItemSet*> &m : moves) {
+      ItemSet *already = sm::getPointerFromSet(table, m.second);
+      if (already) {
+        delete m.second;
+      }
+      else {
+        already = m.second;
+        already->id = (StateId)(nextItemSetId++);
+        table.insert(already);                // (ownership transfer)
+        worklist.push_back(already);
+      }
+      source->setTransition(m.first, already);
+    }
+  }
+
+  traceProgress(1) << "reused the closures of " << numReused << " of "
+                   << worklist.size() << " states\n";
+
+  itemSets.insert(itemSets.end(), table.begin(), table.end());
+  table.clear();
+  sm::sortSList(itemSets, ItemSet::diffById);
+
+  // save this automaton for the next run; the ids are 0..n-1
+  SavedAutomaton now;
+  for (int p=0; p < numProds; p++) {
+    now.prods.push_back(productionSignature(*getProduction(p)));
+  }
+  now.states.resize(itemSets.size());
+  for (ItemSet const *is : itemSets) {
+    SavedAutomaton::State &st = now.states[is->id];
+    for (LRItem const *item : is->kernelItems) {
+      st.kernel.push_back(std::make_pair(item->prodIndex(), item->getDot()));
+    }
+    std::sort(st.kernel.begin(), st.kernel.end());
+    for (LRItem const *item : is->nonkernelItems) {
+      st.nonkernel.push_back(std::make_pair(item->prodIndex(), item->getDot()));
+    }
+    for (int t=0; t < numTerms; t++) {
+      if (ItemSet const *dest = is->transitionC(getTerminal(t))) {
+        st.successors.push_back(dest->id);
+      }
+    }
+    for (int nt=0; nt < numNonterms; nt++) {
+      if (ItemSet const *dest = is->transitionC(getNonterminal(nt))) {
+        st.successors.push_back(dest->id);
+      }
+    }
+  }
+
+  // under a temporary name first, in case another run is reading it
+  string tmp = fmt::format("{}.{}.tmp", automatonFname, getProcessId());
+  try {
+    if (!ensurePath(automatonFname.c_str(), false /*isDirectory*/)) {
+      xsyserror("mkdir", automatonFname);
+    }
+    {
+      BFlatten flat(tmp.c_str(), false /*reading*/);
+      now.xfer(flat);
+    }
+    if (rename(tmp.c_str(), automatonFname.c_str()) != 0) {
+      xsyserror("rename", automatonFname);
+    }
+  }
+  catch (xBase &x) {
+    std::cout << "warning: could not save the LR(0) automaton to "
+              << automatonFname << ": " << x.why() << std::endl;
+    remove(tmp.c_str());
+  }
+}
+
+
+// ---------------- minimal LR(1) item sets ----------------
+// canonical LR(1) states are the same only if their kernel
+// lookaheads are too; many states share each core, so the hash
+// includes the lookaheads
+struct LR1ItemSetHash {
+  size_t operator()(ItemSet const *key) const
+  {
+    size_t h = key->kernelItemsCRC;
+    for (LRItem const *item : key->kernelItems) {
+      h = h * 31 + item->lookahead.hash();
+    }
+    return h;
+  }
+};
+
+struct LR1ItemSetEquals {
+  bool operator()(ItemSet const *key1, ItemSet const *key2) const
+  {
+    if (!(*key1 == *key2)) {
+      return false;
+    }
+    for (size_t i=0; i < key1->kernelItems.size(); i++) {
+      if (!key1->kernelItems[i]->lookahead.isEqual(key2->kernelItems[i]->lookahead)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+
+// the canonical LR(1) item sets, numbered 0 .. n-1 in the order they
+// are found, start state first; no lookaheads are ever merged, so
+// each state is processed once
+void GrammarAnalysis::constructCanonicalLR1ItemSets(std::vector<ItemSet*> &states)
+{
+  std::unordered_set<ItemSet*, LR1ItemSetHash, LR1ItemSetEquals> seen;   // (serfs)
+  std::vector<LRItem*> onWorklist(numProds, NULL);
+  std::vector<DottedProduction const*> kernelCRCArray;
+
+  {
+    ItemSet *is = makeItemSet();
+    is->addKernelItem(numTerms, getDProd(&productions.front(), 0 /*dot at left*/));
+    is->sortKernelItems();
+    itemSetClosure(*is, onWorklist);
+    states.push_back(is);
+    seen.insert(is);
+  }
+
+  for (size_t i=0; i < states.size(); i++) {
+    ItemSet *source = states[i];
+
+    Moves moves;
+    moveDotAllSymbols(source, moves, kernelCRCArray);
+    for (std::pair<Symbol const*, ItemSet*> &m : moves) {
+      ItemSet *target = sm::getPointerFromSet(seen, m.second);
+      if (target) {
+        delete m.second;
+      }
+      else {
+        target = m.second;
+        target->id = (StateId)(nextItemSetId++);
+        itemSetClosure(*target, onWorklist);
+        states.push_back(target);
+        seen.insert(target);
+      }
+      source->setTransition(m.first, target);
+    }
+  }
+}
+
+
+// true if the canonical states 'members', which share a core, could be
+// one state without any of them getting a conflict it does not already
+// have: wherever the merged state would have several actions on some
+// terminal, every member with any action there must have all of them.
+// 'finals[m]' lists the items of state 'm' with the dot at the end,
+// which are in the same order for every member
+static bool lr1Mergeable(std::vector<ItemSet*> const &states,
+                         std::vector<std::vector<LRItem const*>> const &finals,
+                         std::vector<int> const &members, int numTerms)
+{
+  size_t const numFinals = finals[members[0]].size();
+  if (numFinals == 0) {
+    return true;       // no reductions, so no conflicts
+  }
+
+  ItemSet const *core = states[members[0]];
+  for (int t=0; t < numTerms; t++) {
+    int const shift = core->getTermTransition(t)? 1 : 0;
+
+    // reductions on 't' in the merged state
+    int merged = 0;
+    for (size_t j=0; j < numFinals; j++) {
+      for (int m : members) {
+        if (finals[m][j]->laContains(t)) {
+          merged++;
+          break;
+        }
+      }
+    }
+    if (shift + merged < 2) {
+      continue;
+    }
+
+    // each member's reductions are a subset of the merged ones, so
+    // comparing counts is enough
+    for (int m : members) {
+      int mine = 0;
+      for (size_t j=0; j < numFinals; j++) {
+        if (finals[m][j]->laContains(t)) {
+          mine++;
+        }
+      }
+      if ((shift || mine) && mine != merged) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+// replace the canonical LR(1) item sets 'lr1' with the fewest merged
+// ones this finds, in 'itemSets'.  Like LALR(1), states with the same
+// core are merged, but only as long as lr1Mergeable allows; the groups
+// are then split further until every group's members go to the same
+// groups on each symbol, so the groups form an automaton.  Splitting
+// a mergeable group leaves mergeable groups, so the result has exactly
+// the conflicts of canonical LR(1).
+void GrammarAnalysis::mergeLR1ItemSets(std::vector<ItemSet*> &lr1)
+{
+  int const numStates = lr1.size();
+
+  std::vector<std::vector<LRItem const*>> finals(numStates);
+  for (int i=0; i < numStates; i++) {
+    xassert(lr1[i]->id == i);
+    for (LRItem const *item : lr1[i]->getAllItems()) {
+      if (item->isDotAtEnd()) {
+        finals[i].push_back(item);
+      }
+    }
+  }
+
+  // group by core, in order of first appearance
+  std::unordered_map<ItemSet*, std::vector<int>, ItemSetHash, ItemSetEquals> cores;
+  std::vector<std::vector<int>*> coreOrder;
+  for (int i=0; i < numStates; i++) {
+    auto res = cores.emplace(lr1[i], std::vector<int>());
+    if (res.second) {
+      coreOrder.push_back(&res.first->second);
+    }
+    res.first->second.push_back(i);
+  }
+
+  // split each core greedily into mergeable groups
+  std::vector<int> block(numStates);
+  int numBlocks = 0;
+  for (std::vector<int> *core : coreOrder) {
+    std::vector<std::vector<int>> groups;
+    for (int i : *core) {
+      size_t g = 0;
+      for (; g < groups.size(); g++) {
+        groups[g].push_back(i);
+        if (lr1Mergeable(lr1, finals, groups[g], numTerms)) {
+          break;
+        }
+        groups[g].pop_back();
+      }
+      if (g == groups.size()) {
+        groups.push_back(std::vector<int>(1, i));
+      }
+    }
+
+    for (std::vector<int> const &group : groups) {
+      for (int i : group) {
+        block[i] = numBlocks;
+      }
+      numBlocks++;
+    }
+  }
+
+  // refine until transitions respect the blocks; blocks are
+  // renumbered in order of first member, so the start state's is 0
+  for (;;) {
+    std::map<std::vector<int>, int> signatures;
+    std::vector<int> refined(numStates);
+    for (int i=0; i < numStates; i++) {
+      std::vector<int> sig(1, block[i]);
+      for (int t=0; t < numTerms; t++) {
+        if (ItemSet const *dest = lr1[i]->getTermTransition(t)) {
+          sig.push_back(block[dest->id]);
+        }
+      }
+      for (int nt=0; nt < numNonterms; nt++) {
+        if (ItemSet const *dest = lr1[i]->getNontermTransition(nt)) {
+          sig.push_back(block[dest->id]);
+        }
+      }
+      refined[i] = signatures.emplace(sig, (int)signatures.size()).first->second;
+    }
+
+    bool const stable = ((int)signatures.size() == numBlocks);
+    block.swap(refined);
+    numBlocks = signatures.size();
+    if (stable) {
+      break;
+    }
+  }
+
+  // make one state per block, from its first member
+  std::vector<ItemSet*> merged(numBlocks, NULL);
+  std::vector<int> rep(numBlocks, -1);
+  nextItemSetId = 0;
+  for (int i=0; i < numStates; i++) {
+    int b = block[i];
+    if (!merged[b]) {
+      xassert(b == nextItemSetId);
+      merged[b] = makeItemSet();
+      rep[b] = i;
+      for (LRItem const *item : lr1[i]->kernelItems) {
+        merged[b]->addKernelItem(*item);
+      }
+    }
+    else {
+      lr1[i]->mergeLookaheadsInto(*merged[b]);
+    }
+  }
+
+  std::vector<LRItem*> onWorklist(numProds, NULL);
+  for (int b=0; b < numBlocks; b++) {
+    ItemSet *source = lr1[rep[b]];
+    merged[b]->changedItems();
+    itemSetClosure(*merged[b], onWorklist);
+
+    for (int t=0; t < numTerms; t++) {
+      if (ItemSet const *dest = source->getTermTransition(t)) {
+        merged[b]->setTransition(indexedTerms[t], merged[block[dest->id]]);
+      }
+    }
+    for (int nt=0; nt < numNonterms; nt++) {
+      if (ItemSet const *dest = source->getNontermTransition(nt)) {
+        merged[b]->setTransition(indexedNonterms[nt], merged[block[dest->id]]);
+      }
+    }
+  }
+
+  for (ItemSet *is : lr1) {
+    delete is;
+  }
+  lr1.clear();
+
+  itemSets = merged;
+  startState = merged[0];
+}
+
+
+// ---------------- relational LALR(1) lookaheads ----------------
+namespace {
+
+// an edge of a relation over nonterminal transitions; the target's
+// set flows to the source, minus 'mask' if that is not NULL
+struct RelationEdge {
+  int to;
+  TerminalSet const *mask;      // (serf)
+};
+
+// DeRemer and Pennello's "digraph" algorithm: given a relation R over
+// nodes 0..n-1, and initial sets F'(x) in 'sets', replace each set
+// with the smallest F(x) such that
+//   F(x) = F'(x) u U{ F(y) - mask(x,y) : x R y }
+// Without masks, every member of a strongly connected component gets
+// the same set; a component containing a masked edge is iterated to a
+// fixpoint instead.
+class RelationClosure {
+private:    // data
+  std::vector<std::vector<RelationEdge>> const &edges;
+  std::vector<TerminalSet> &sets;
+
+  // N(x) of the paper: 0 for unvisited, INT_MAX once x's set is final,
+  // and otherwise the depth of the stack when x was pushed, lowered to
+  // that of the earliest node x is known to reach
+  std::vector<int> depth;
+  std::vector<int> stack;
+
+private:    // funcs
+  bool mergeEdge(int x, RelationEdge const &e);
+  void traverse(int x);
+
+public:     // funcs
+  RelationClosure(std::vector<std::vector<RelationEdge>> const &e,
+                  std::vector<TerminalSet> &s)
+    : edges(e), sets(s), depth(e.size(), 0), stack() {}
+
+  void run();
+};
+
+
+bool RelationClosure::mergeEdge(int x, RelationEdge const &e)
+{
+  if (!e.mask) {
+    return sets[x].merge(sets[e.to]);
+  }
+  return sets[x].mergeExcept(sets[e.to], *e.mask);
+}
+
+
+void RelationClosure::traverse(int x)
+{
+  stack.push_back(x);
+  int const d = stack.size();
+  depth[x] = d;
+
+  for (RelationEdge const &e : edges[x]) {
+    if (depth[e.to] == 0) {
+      traverse(e.to);
+    }
+    depth[x] = (std::min)(depth[x], depth[e.to]);
+    mergeEdge(x, e);
+  }
+
+  if (depth[x] != d) {
+    return;      // not the root of its component
+  }
+
+  // the component is the stack from 'x' up; an edge stays inside it
+  // exactly when its target's set is not yet final
+  bool masked = false;
+  for (int i = d-1; i < (int)stack.size() && !masked; i++) {
+    for (RelationEdge const &e : edges[stack[i]]) {
+      if (e.mask && depth[e.to] != INT_MAX) {
+        masked = true;
+        break;
+      }
+    }
+  }
+
+  if (!masked) {
+    for (int i = d-1; i < (int)stack.size(); i++) {
+      sets[stack[i]].copy(sets[x]);
+    }
+  }
+  else {
+    bool changed;
+    do {
+      changed = false;
+      for (int i = d-1; i < (int)stack.size(); i++) {
+        for (RelationEdge const &e : edges[stack[i]]) {
+          if (mergeEdge(stack[i], e)) {
+            changed = true;
+          }
+        }
+      }
+    } while (changed);
+  }
+
+  for (int i = d-1; i < (int)stack.size(); i++) {
+    depth[stack[i]] = INT_MAX;
+  }
+  stack.resize(d-1);
+}
+
+
+void RelationClosure::run()
+{
+  for (int x=0; x < (int)edges.size(); x++) {
+    if (depth[x] == 0) {
+      traverse(x);
+    }
+  }
+}
+
+
+// the item in 'state' for 'dprod', or NULL; relies on both item lists
+// being sorted by LRItem::diff
+LRItem *findItem(ItemSet *state, DottedProduction const *dprod)
+{
+  auto before = [](LRItem const *item, DottedProduction const *dp) {
+    int ret = item->prodIndex() - dp->getProd()->prodIndex;
+    return ret? ret < 0 : item->getDot() < dp->getDot();
+  };
+
+  std::vector<LRItem *> *lists[] = { &state->kernelItems, &state->nonkernelItems };
+  for (std::vector<LRItem *> *list : lists) {
+    auto it = std::lower_bound(list->begin(), list->end(), dprod, before);
+    if (it != list->end() && (*it)->dprod == dprod) {
+      return *it;
+    }
+  }
+  return NULL;
+}
+
+} // anonymous namespace
+
+
+// DeRemer and Pennello, "Efficient Computation of LALR(1) Look-Ahead
+// Sets", TOPLAS 4(4), 1982.  This runs on the LR(0) automaton (every
+// item's lookahead empty) and gives every item, not just the ones
+// with the dot at the end, the lookahead the propagating construction
+// would have given it, so the results are indistinguishable.
+//
+// The relations are over the nonterminal transitions (p,A).  Follow(p,A)
+// is what the closure in 'p' merges into the lookahead of the items
+// "A -> . gamma" (before removing their forbid_next tokens):
+//   - Read(p,A): the terminals that can be shifted after A, perhaps
+//     after some nullable nonterminals ("reads");
+//   - plus Follow(p',B) for each (p',B) that (p,A) "includes": where
+//     B -> beta A eta, eta is nullable, and p' reaches p on beta.
+// The one extension needed here is forbid_next: an includes edge only
+// passes on what its production does not forbid.
+void GrammarAnalysis::computeRelationalLookaheads()
+{
+  // states are still numbered 0 .. n-1 in construction order
+  int const numStates = itemSets.size();
+  std::vector<ItemSet*> stateById(numStates);
+  for (ItemSet *s : itemSets) {
+    stateById[s->id] = s;
+  }
+
+  // number the nonterminal transitions
+  std::vector<int> nodeIndex(numStates * numNonterms, -1);
+  std::vector<ItemSet*> nodeSource;             // (serfs)
+  std::vector<Nonterminal const*> nodeSymbol;   // (serfs)
+  for (ItemSet *s : stateById) {
+    for (int nt=0; nt < numNonterms; nt++) {
+      if (s->getNontermTransition(nt)) {
+        nodeIndex[s->id * numNonterms + nt] = nodeSource.size();
+        nodeSource.push_back(s);
+        nodeSymbol.push_back(indexedNonterms[nt]);
+      }
+    }
+  }
+  int const numNodes = nodeSource.size();
+  auto node = [&](ItemSet const *p, Nonterminal const *A) {
+    int ret = nodeIndex[p->id * numNonterms + A->ntIndex];
+    xassert(ret >= 0);
+    return ret;
+  };
+
+  // Read = DR + reads*
+  std::vector<TerminalSet> sets(numNodes, TerminalSet(numTerms));
+  std::vector<std::vector<RelationEdge>> edges(numNodes);
+  for (int x=0; x < numNodes; x++) {
+    ItemSet const *r = nodeSource[x]->transition(nodeSymbol[x]);
+    for (int t=0; t < numTerms; t++) {
+      if (r->getTermTransition(t)) {
+        sets[x].add(t);
+      }
+    }
+    for (int nt=0; nt < numNonterms; nt++) {
+      if (r->getNontermTransition(nt) &&
+          canDeriveEmpty(indexedNonterms[nt])) {
+        edges[x].push_back(RelationEdge{ node(r, indexedNonterms[nt]), NULL });
+      }
+    }
+  }
+  RelationClosure(edges, sets).run();
+
+  // Follow = Read + includes*
+  for (std::vector<RelationEdge> &e : edges) {
+    e.clear();
+  }
+  for (int x=0; x < numNodes; x++) {
+    for (Production *prod : productionsByLHS[nodeSymbol[x]->ntIndex]) {
+      TerminalSet const *mask = prod->forbid.empty()? NULL : &prod->forbid;
+      ItemSet *p = nodeSource[x];
+      int posn = 0;
+      for (Production::RHSElt const &elt : prod->right) {
+        posn++;
+        if (elt.sym->isNonterminal() && getDProd(prod, posn)->canDeriveEmpty) {
+          edges[node(p, &elt.sym->asNonterminalC())].push_back(RelationEdge{ x, mask });
+        }
+        p = p->transition(elt.sym);
+        xassert(p);
+      }
+    }
+  }
+  RelationClosure(edges, sets).run();
+
+  // lookback: every item "A -> alpha . beta" in a state reached from
+  // p on alpha gets Follow(p,A), minus what its production forbids
+  TerminalSet la(numTerms);
+  for (int x=0; x < numNodes; x++) {
+    for (Production *prod : productionsByLHS[nodeSymbol[x]->ntIndex]) {
+      la.copy(sets[x]);
+      if (!prod->forbid.empty()) {
+        la.removeSet(prod->forbid);
+      }
+
+      ItemSet *p = nodeSource[x];
+      for (int posn=0; ; posn++) {
+        LRItem *item = findItem(p, getDProd(prod, posn));
+        xassert(item);
+        item->lookahead.merge(la);
+
+        if (posn == prod->rhsLength()) break;
+        p = p->transition(prod->right[posn].sym);
+      }
+    }
+  }
 }
 
 
@@ -3016,6 +4241,42 @@ bool isAmbiguousNonterminal(Symbol const *sym)
 // described in the Dencker et. al. paper (see parsetables.h).
 void GrammarAnalysis::renumberStates()
 {
+  // the sort below breaks ties using the ids of transition targets, so
+  // give the states canonical provisional ids first: the order in which
+  // a breadth-first walk from the start state reaches them, taking the
+  // transitions in symbol index order.  Otherwise the result would
+  // depend on the order in which constructLRItemSets found the states.
+  {
+    std::vector<ItemSet*> order;            // (serfs)
+    std::vector<bool> reached(itemSets.size(), false);
+    order.push_back(startState);
+    reached[startState->id] = true;
+
+    for (size_t i=0; i < order.size(); i++) {
+      ItemSet *source = order[i];
+      for (int t=0; t < numTerms; t++) {
+        ItemSet *target = source->transition(indexedTerms[t]);
+        if (target && !reached[target->id]) {
+          reached[target->id] = true;
+          order.push_back(target);
+        }
+      }
+      for (int nt=0; nt < numNonterms; nt++) {
+        ItemSet *target = source->transition(indexedNonterms[nt]);
+        if (target && !reached[target->id]) {
+          reached[target->id] = true;
+          order.push_back(target);
+        }
+      }
+    }
+
+    // every state is reachable, by construction
+    xassert(order.size() == itemSets.size());
+    for (size_t i=0; i < order.size(); i++) {
+      order[i]->id = (StateId)i;
+    }
+  }
+
   // sort them into the right order
   sm::sortSList(itemSets, &GrammarAnalysis::renumberStatesDiff, this);
 
@@ -3032,6 +4293,108 @@ void GrammarAnalysis::renumberStates()
 
     n++;
   }
+
+  if (!profileFname.empty()) {
+    profileStateOrder();
+  }
+}
+
+
+// Number the states again, by how a parser used them: starting at
+// the start state, each state is followed by its successor (through
+// a shift or goto) that the profile says was taken most often, as
+// long as there is one not yet numbered; then the chain starts over
+// at the most used state not yet numbered.  The rows of states the
+// parser visits one after another then tend to share cache lines and
+// pages.  Unused states come last, in their canonical order.  This
+// loses the grouping by incoming symbol, so it can't be combined
+// with the Code Reduction Scheme.
+void GrammarAnalysis::profileStateOrder()
+{
+  ParseProfile profile(profileFname.c_str());
+
+  int numStates = itemSets.size();
+  std::vector<ItemSet*> byId(numStates);           // (serfs)
+  std::vector<SymbolId> symbols(numStates);
+  for (ItemSet *s : itemSets) {
+    byId[s->id] = s;
+    symbols[s->id] = encodeSymbolId(s->getStateSymbolC());
+  }
+
+  if (profile.numStates != numStates ||
+      profile.numTerms != numTerms ||
+      profile.numNonterms != numNonterms ||
+      profile.symbolsCRC != ParseProfile::stateSymbolsCRC(symbols)) {
+    xformat(fmt::format("{}: the profile is not of this grammar's tables, "
+                        "as numbered without -profile", profileFname));
+  }
+
+  std::vector<uint64_t> heat(numStates);
+  for (int s=0; s < numStates; s++) {
+    heat[s] = profile.stateCount((StateId)s);
+  }
+
+  // most used first; ties in canonical order
+  std::vector<int> byHeat(numStates);
+  for (int s=0; s < numStates; s++) {
+    byHeat[s] = s;
+  }
+  std::stable_sort(byHeat.begin(), byHeat.end(),
+    [&](int a, int b) { return heat[a] > heat[b]; });
+
+  std::vector<ItemSet*> order;                     // (serfs)
+  std::vector<bool> placed(numStates, false);
+  size_t nextHot = 0;
+  ItemSet *cur = startState;
+  while (cur) {
+    order.push_back(cur);
+    placed[cur->id] = true;
+
+    // the most taken transition to a state not yet placed
+    ItemSet *next = NULL;
+    uint64_t best = 0;
+    for (int t=0; t < numTerms; t++) {
+      ItemSet *target = cur->transition(indexedTerms[t]);
+      uint64_t count = profile.actionCounts[(size_t)cur->id * numTerms + t];
+      if (target && !placed[target->id] && count > best) {
+        next = target;
+        best = count;
+      }
+    }
+    for (int nt=0; nt < numNonterms; nt++) {
+      ItemSet *target = cur->transition(indexedNonterms[nt]);
+      uint64_t count = profile.gotoCounts[(size_t)cur->id * numNonterms + nt];
+      if (target && !placed[target->id] && count > best) {
+        next = target;
+        best = count;
+      }
+    }
+
+    // otherwise, the most used state not yet placed
+    while (!next && nextHot < byHeat.size() && heat[byHeat[nextHot]] > 0) {
+      if (!placed[byHeat[nextHot]]) {
+        next = byId[byHeat[nextHot]];
+      }
+      nextHot++;
+    }
+    cur = next;
+  }
+
+  int used = order.size();
+  for (int s=0; s < numStates; s++) {
+    if (!placed[s]) {
+      order.push_back(byId[s]);
+    }
+  }
+
+  for (size_t i=0; i < order.size(); i++) {
+    order[i]->id = (StateId)i;
+  }
+  std::sort(itemSets.begin(), itemSets.end(),
+    [](ItemSet const *a, ItemSet const *b) { return a->id < b->id; });
+
+  traceProgress(1) << "profile " << profileFname << ": " << used
+                   << " of " << numStates << " states used\n";
 }
 
 STATICDEF int GrammarAnalysis::renumberStatesDiff
@@ -3190,9 +4553,10 @@ void GrammarAnalysis::computeParseTables(bool allowAmbig)
 {
   tables = new ParseTables(numTerms, numNonterms, itemSets.size(), numProds,
                            startState->id,
-                           0 /* slight hack: assume it's the first production */);
+                           0 /* slight hack: assume it's the first production */,
+                           !!(tableLayout & TL_CRS));
 
-  if (ENABLE_CRS_COMPRESSION) {
+  if (tableLayout & TL_CRS) {
     // first-state info
     bool doingTerms = true;
     int prevSymCode = -1;
@@ -3351,21 +4715,7 @@ void GrammarAnalysis::computeParseTables(bool allowAmbig)
   }
   xassert(nextOrdinal == -1);    // should have used them all
 
-  if (ENABLE_EEF_COMPRESSION) {
-    tables->computeErrorBits();
-  }
-
-  if (ENABLE_GCS_COMPRESSION) {
-    if (ENABLE_GCS_COLUMN_COMPRESSION) {
-      tables->mergeActionColumns();
-    }
-    tables->mergeActionRows();
-
-    if (ENABLE_GCS_COLUMN_COMPRESSION) {
-      tables->mergeGotoColumns();
-    }
-    tables->mergeGotoRows();
-  }
+  tables->compress(tableLayout);
 }
 
 
@@ -3756,7 +5106,7 @@ void GrammarAnalysis::lrParse(char const *input)
         << "; possible actions:\n";
 
       // get actions
-      ActionEntry *entry = tables->decodeAmbigAction(action, state);
+      ActionEntry const *entry = tables->decodeAmbigAction(action, state);
 
       // explain each one
       for (int i=0; i<entry[0]; i++) {
@@ -3908,7 +5258,7 @@ void GrammarAnalysis::exampleGrammar()
 }
 
 
-void GrammarAnalysis::runAnalyses(char const *setsFname)
+void GrammarAnalysis::analyze(char const *setsFname)
 {
   // prepare for symbol of interest
   {
@@ -4124,16 +5474,274 @@ void GrammarAnalysis::runAnalyses(char const *setsFname)
 }
 
 
+// ------------------ analysis cache -----------------------
+// The cache holds, for each grammar key, <key>.tables (written by
+// ParseTables::writeBinary) and <key>.report, which has what the
+// analysis printed and its error count.  The key covers everything
+// the tables depend on, but none of the action code, so changing
+// only actions reuses the previous analysis.
+
+// bump this whenever the key or the .report format changes
+enum { ANALYSIS_CACHE_VERSION = 1 };
+
+// .report files start with this (as a Flatten checkpoint)
+enum { ANALYSIS_CACHE_MAGIC = 0x656c6b61 };
+
+
+// a Flatten that only writes, and keeps a hash (64-bit FNV-1a) of
+// everything written to it
+class HashFlatten : public Flatten {
+public:      // data
+  uint64_t hash;
+
+public:      // funcs
+  HashFlatten() : hash(0xcbf29ce484222325ULL) {}
+
+  virtual bool reading() const { return false; }
+  virtual void xferSimple(void *var, unsigned len);
+  virtual void noteOwner(void *) {}
+  virtual void xferSerf(void *&, bool) { xfailure("can't hash serf pointers"); }
+};
+
+void HashFlatten::xferSimple(void *var, unsigned len)
+{
+  unsigned char const *p = (unsigned char const*)var;
+  for (unsigned i=0; i < len; i++) {
+    hash = (hash ^ p[i]) * 0x100000001b3ULL;
+  }
+}
+
+
+// copies everything written to it into 'text', in addition to
+// passing it on to 'dest'
+class TeeStreambuf : public std::streambuf {
+private:     // data
+  std::streambuf *dest;
+  string &text;
+
+protected:   // funcs
+  virtual int overflow(int c)
+  {
+    if (c == EOF) {
+      return 0;
+    }
+    text.push_back((char)c);
+    return dest->sputc((char)c);
+  }
+  virtual std::streamsize xsputn(char const *s, std::streamsize n)
+  {
+    text.append(s, n);
+    return dest->sputn(s, n);
+  }
+  virtual int sync() { return dest->pubsync(); }
+
+public:      // funcs
+  TeeStreambuf(std::streambuf *d, string &t) : dest(d), text(t) {}
+};
+
+
+uint64_t GrammarAnalysis::cacheKey() const
+{
+  HashFlatten flat;
+  auto xferStr = [&](char const *s) {
+    string tmp(s? s : "");
+    flat.xferString(tmp);
+  };
+
+  flat.writeInt(ANALYSIS_CACHE_VERSION);
+  xferStr(cacheSalt.c_str());
+  flat.writeInt(minimalLR1);
+  flat.writeInt(tableLayout);
+
+  // the profile decides the state numbering
+  xferStr(profileFname.empty()? NULL :
+          readStringFromFile(profileFname).c_str());
+
+  // symbols, in the order that gives them their indices
+  flat.writeInt((int)terminals.size());
+  for (Terminal const &t : terminals) {
+    xferStr(t.name.str);
+    xferStr(t.alias.str);
+    flat.writeInt(t.termIndex);
+    flat.writeInt(t.precedence);
+    flat.writeInt(t.associativity);
+  }
+  flat.writeInt((int)nonterminals.size());
+  for (Nonterminal const &nt : nonterminals) {
+    xferStr(nt.name.str);
+    flat.writeInt(nt.maximal);
+    flat.writeInt((int)nt.subsets.size());
+    for (Nonterminal const *sub : nt.subsets) {
+      xferStr(sub->name.str);
+    }
+  }
+  xferStr(startSymbol? startSymbol->name.str : NULL);
+
+  // productions, without their tags or actions
+  flat.writeInt((int)productions.size());
+  for (Production const &prod : productions) {
+    flat.writeInt(prod.prodIndex);
+    xferStr(prod.left->name.str);
+    flat.writeInt((int)prod.right.size());
+    for (Production::RHSElt const &elt : prod.right) {
+      flat.writeInt(elt.sym->isTerminal());
+      xferStr(elt.sym->name.str);
+    }
+    flat.writeInt(prod.precedence);
+    TerminalSet forbid(prod.forbid);
+    forbid.xfer(flat);
+  }
+
+  // these decide what gets reported
+  flat.writeInt(expectedSR);
+  flat.writeInt(expectedRR);
+  flat.writeInt(expectedUNRNonterms);
+  flat.writeInt(expectedUNRTerms);
+
+  return flat.hash;
+}
+
+
+bool GrammarAnalysis::loadCachedAnalyses(rostring base)
+{
+  string reportFname = base + ".report";
+  if (!fileOrDirectoryExists(reportFname.c_str())) {
+    return false;
+  }
+
+  int cachedErrors;
+  string report;
+  std::unique_ptr<ParseTables> cached;
+  try {
+    BFlatten flat(reportFname.c_str(), true /*reading*/);
+    flat.checkpoint(ANALYSIS_CACHE_MAGIC);
+    flat.checkpoint(ANALYSIS_CACHE_VERSION);
+    flat.xferInt(cachedErrors);
+    flat.xferString(report);
+    cached.reset(ParseTables::loadBinary((base + ".tables").c_str()));
+  }
+  catch (xBase &x) {
+    // damaged, or written by a build with other table options
+    traceProgress() << "not using cached analysis: " << x.why() << std::endl;
+    return false;
+  }
+
+  errors = cachedErrors;
+  checkWellFormed();
+  initializeAuxData();
+
+  if (cached->getNumTerms() != numTerms ||
+      cached->getNumNonterms() != numNonterms ||
+      cached->getNumProds() != numProds) {
+    // only a hash collision could do this
+    xfailure("cached parse tables do not fit the grammar");
+  }
+  tables = cached.release();
+
+  std::cout << report << std::flush;
+  return true;
+}
+
+
+void GrammarAnalysis::saveCachedAnalyses(rostring base, rostring report) const
+{
+  // leave out the progress lines, since their times will be stale
+  string kept;
+  for (size_t start = 0; start < report.size(); ) {
+    size_t end = report.find('\n', start);
+    end = (end == string::npos)? report.size() : end+1;
+    if (report.compare(start, 14, "%%% progress: ") != 0) {
+      kept.append(report, start, end-start);
+    }
+    start = end;
+  }
+
+  // write each file under a temporary name, then rename it, so a
+  // concurrent run never sees a partial file; the report goes last
+  // because it is what marks the entry as present
+  int pid = getProcessId();
+  string tablesFname = base + ".tables";
+  string reportFname = base + ".report";
+  string tablesTmp = fmt::format("{}.{}.tmp", tablesFname, pid);
+  string reportTmp = fmt::format("{}.{}.tmp", reportFname, pid);
+  try {
+    if (!ensurePath(tablesFname.c_str(), false /*isDirectory*/)) {
+      xsyserror("mkdir", cacheDir);
+    }
+
+    tables->finishTables();
+    tables->writeBinary(tablesTmp.c_str());
+    if (rename(tablesTmp.c_str(), tablesFname.c_str()) != 0) {
+      xsyserror("rename", tablesFname);
+    }
+
+    {
+      BFlatten flat(reportTmp.c_str(), false /*reading*/);
+      int errs = errors;
+      flat.checkpoint(ANALYSIS_CACHE_MAGIC);
+      flat.checkpoint(ANALYSIS_CACHE_VERSION);
+      flat.xferInt(errs);
+      flat.xferString(kept);
+    }
+    if (rename(reportTmp.c_str(), reportFname.c_str()) != 0) {
+      xsyserror("rename", reportFname);
+    }
+  }
+  catch (xBase &x) {
+    // the cache is only an optimization
+    std::cout << "warning: could not save analysis to " << base
+              << ": " << x.why() << std::endl;
+    remove(tablesTmp.c_str());
+    remove(reportTmp.c_str());
+  }
+}
+
+
+void GrammarAnalysis::runAnalyses(char const *setsFname)
+{
+  // the cache has no item sets to write to 'setsFname'
+  if (cacheDir.empty() || setsFname) {
+    analyze(setsFname);
+    return;
+  }
+
+  string base = fmt::format("{}/{:016x}", cacheDir, cacheKey());
+  if (loadCachedAnalyses(base)) {
+    traceProgress() << "reused analysis " << base << std::endl;
+    return;
+  }
+
+  // record what the analysis prints, to print it again on a hit
+  string report;
+  {
+    TeeStreambuf tee(std::cout.rdbuf(), report);
+    std::streambuf *saved = std::cout.rdbuf(&tee);
+    try {
+      analyze(NULL);
+    }
+    catch (...) {
+      std::cout.rdbuf(saved);
+      throw;
+    }
+    std::cout.rdbuf(saved);
+  }
+
+  traceProgress() << "saving analysis " << base << std::endl;
+  saveCachedAnalyses(base, report);
+}
+
+
 // ------------------ emitting action code -----------------------
 // prototypes for this section; some of them accept Grammar simply
 // because that's all they need; there's no problem upgrading them
 // to GrammarAnalysis
 void emitDescriptions(GrammarAnalysis const &g, EmitCode &out);
 void emitActionCode(GrammarAnalysis const &g, rostring hFname,
-                    rostring ccFname, rostring srcFname);
+                    rostring ccFname, rostring srcFname, bool direct);
 void emitUserCode(EmitCode &out, LocString const &code, bool braces = true);
 void emitActions(Grammar const &g, EmitCode &out, EmitCode &dcl);
 void emitDupDelMerge(GrammarAnalysis const &g, EmitCode &out, EmitCode &dcl);
+void emitDirectParser(GrammarAnalysis const &g, EmitCode &out);
 void emitFuncDecl(Grammar const &g, EmitCode &out, EmitCode &dcl,
                   char const *rettype, rostring params);
 void emitDDMInlines(Grammar const &g, EmitCode &out, EmitCode &dcl,
@@ -4152,9 +5760,10 @@ string actionFuncName(Production const &prod)
 }
 
 
-// emit the user's action code to a file
+// emit the user's action code to a file; with 'direct', also emit a
+// directly-coded parser (see directlr.h)
 void emitActionCode(GrammarAnalysis const &g, rostring hFname,
-                    rostring ccFname, rostring srcFname)
+                    rostring ccFname, rostring srcFname, bool direct)
 {
   EmitCode dcl(hFname);
 
@@ -4218,6 +5827,15 @@ void emitActionCode(GrammarAnalysis const &g, rostring hFname,
       << "    int oldTokenType, SemanticValue sval);\n"
       << "\n"
       ;
+  if (direct) {
+    dcl << "  // the directly-coded parser\n"
+        << "  static int directParse(\n"
+        << "    " << g.actionClassName << " *ths, DirectLRStack &stack,\n"
+        << "    LexerInterface &lexer, SemanticValue &treeTop);\n"
+        << "  virtual DirectParseFunc getDirectParser(ParseTables const *tables);\n"
+        << "\n"
+        ;
+  }
 
   EmitCode out(ccFname);
 
@@ -4239,6 +5857,10 @@ void emitActionCode(GrammarAnalysis const &g, rostring hFname,
   out << "#include \"" << sm_basename(hFname) << "\"     // " << g.actionClassName << "\n";
   out << "#include \"parsetables.h\" // ParseTables\n";
   out << "#include \"srcloc.h\"      // SourceLoc\n";
+  if (direct) {
+    out << "#include \"directlr.h\"    // DirectLRStack\n";
+    out << "#include \"lexerint.h\"    // LexerInterface\n";
+  }
   out << "\n";
   out << "#include <assert.h>      // assert\n";
   out << "#include <iostream>      // std::cout\n";
@@ -4272,6 +5894,11 @@ void emitActionCode(GrammarAnalysis const &g, rostring hFname,
   out << "\n";
 
   g.tables->finishTables();
+  if (direct) {
+    emitDirectParser(g, out);
+    out << "\n";
+    out << "\n";
+  }
   g.tables->emitConstructionCode(out, string(g.actionClassName), "makeTables");
 
   // I put this last in the context class, and make it public
@@ -4431,6 +6058,57 @@ void emitDescriptions(GrammarAnalysis const &g, EmitCode &out)
 }
 
 
+// emit an expression that calls the action function for 'prod' and
+// yields a SemanticValue; the semantic value of RHS element i is
+// passed as <svalPrefix>i<svalSuffix>, and the location as 'locName'
+void emitActionCall(EmitCode &out, Production const &prod,
+                    char const *svalPrefix, char const *svalSuffix,
+                    char const *locName)
+{
+  out << "(SemanticValue)(ths->" << actionFuncName(prod) << "("
+      SOURCELOC( << locName )
+      ;
+  NOSOURCELOC( (void)locName; )
+
+  // iterate over RHS elements, emitting arguments for each with a tag
+  int index = -1;      // index into the semantic values
+  int ct=0;
+  SOURCELOC( ct++ );   // count 'loc' if it is passed
+  for (auto const& elt : prod.right) {
+
+    // we have semantic values in the array for all RHS elements,
+    // even if they didn't get a tag
+    index++;
+
+    if (elt.tag.length() == 0) continue;
+
+    if (ct++ > 0) {
+      out << ", ";
+    }
+
+    // cast SemanticValue to proper type
+    out << "(" << typeString(elt.sym->type, elt.tag) << ")";
+    if (isEnumType(elt.sym->type)) {
+      // egcs-1.1.2 complains when I cast from void* to enum, even
+      // when there is a cast!  so let's put an intermediate cast
+      // to int
+      out << "(int)";
+    }
+    out << "(" << svalPrefix << index << svalSuffix << ")";
+  }
+
+  out << ")";     // end of argument list
+
+  if (0==strcmp(prod.left->type, "void")) {
+    // cute hack: turn the expression into a comma expression, with
+    // the value returned being 0
+    out << ", 0";
+  }
+
+  out << ")";
+}
+
+
 void emitActions(Grammar const &g, EmitCode &out, EmitCode &dcl)
 {
   out << "// ------------------- actions ------------------\n";
@@ -4506,48 +6184,10 @@ void emitActions(Grammar const &g, EmitCode &out, EmitCode &dcl)
 
   // iterate over productions
   for (auto const& prod : g.productions) {
-
     out << "    case " << prod.prodIndex << ":\n";
-    out << "      return (SemanticValue)(ths->" << actionFuncName(prod) << "("
-        SOURCELOC( << "loc" )
-        ;
-
-    // iterate over RHS elements, emitting arguments for each with a tag
-    int index = -1;      // index into 'semanticValues'
-    int ct=0;
-    SOURCELOC( ct++ );   // count 'loc' if it is passed
-    for (auto const& elt : prod.right) {
-
-      // we have semantic values in the array for all RHS elements,
-      // even if they didn't get a tag
-      index++;
-
-      if (elt.tag.length() == 0) continue;
-
-      if (ct++ > 0) {
-        out << ", ";
-      }
-
-      // cast SemanticValue to proper type
-      out << "(" << typeString(elt.sym->type, elt.tag) << ")";
-      if (isEnumType(elt.sym->type)) {
-        // egcs-1.1.2 complains when I cast from void* to enum, even
-        // when there is a cast!  so let's put an intermediate cast
-        // to int
-        out << "(int)";
-      }
-      out << "(semanticValues[" << index << "])";
-    }
-
-    out << ")";     // end of argument list
-
-    if (0==strcmp(prod.left->type, "void")) {
-      // cute hack: turn the expression into a comma expression, with
-      // the value returned being 0
-      out << ", 0";
-    }
-
-    out << ");\n";
+    out << "      return ";
+    emitActionCall(out, prod, "semanticValues[", "]", "loc");
+    out << ";\n";
   }
 
   out << "    default:\n";
@@ -4662,6 +6302,199 @@ void emitDupDelMerge(GrammarAnalysis const &g, EmitCode &out, EmitCode &dcl)
 }
 
 
+// emit the directly-coded parser: one 'case' per state, dispatching
+// on the lookahead to shift and reduce code, with the actions called
+// directly so the compiler can inline them; cells of the action
+// table that are errors or conflicts make it return DP_STUCK, for
+// the GLR core to take over (see directlr.h)
+void emitDirectParser(GrammarAnalysis const &g, EmitCode &out)
+{
+  ParseTables const *tables = g.tables;
+  int numStates = tables->getNumStates();
+  int numTerms = tables->getNumTerms();
+  int numNonterms = tables->getNumNonterms();
+  int numProds = tables->getNumProds();
+  string acn(g.actionClassName);
+
+  out << "// ------------------- directly-coded parser ------------------\n"
+      << "/*static*/ int " << acn << "::directParse(\n"
+      << "  " << acn << " *ths, DirectLRStack &stack,\n"
+      << "  LexerInterface &lexer, SemanticValue &treeTop)\n"
+      << "{\n"
+      << "  LexerInterface::NextTokenFunc nextToken = lexer.getTokenFunc();\n"
+      << "\n"
+      << "  // reclassified lookahead; 'lexer.type' keeps the original,\n"
+      << "  // for the GLR core in case this parser gets stuck\n"
+      << "  int tok = reclassifyToken(ths, lexer.type, lexer.sval);\n"
+      << "\n"
+      << "  StateId state = stack.topState();   // state on top of 'stack'\n"
+      << "  StateId next;                       // state to push\n"
+      << "  SemanticValue sval;                 // value to push with it\n"
+      << "  SourceLoc leftEdge;                 // and its location\n"
+      << "  DirectLRStack::Entry *rhs;          // popped by a reduction\n"
+      << "\n"
+      << "  for (;;) {\n"
+      << "    switch ((int)state) {\n"
+      ;
+
+  // which productions are reduced deterministically, and which
+  // nonterminals need goto code
+  std::vector<bool> prodUsed(numProds, false);
+  std::vector<bool> ntUsed(numNonterms, false);
+  bool acceptUsed = false;
+
+  for (int s=0; s < numStates; s++) {
+    StateId state = (StateId)s;
+    out << "      case " << s << ":\n";
+
+    // shifts, and the terminals grouped by the production they
+    // reduce by
+    std::vector<std::pair<int, int>> shifts;
+    std::map<int, std::vector<int>> reductions;
+    for (int t=0; t < numTerms; t++) {
+      ActionEntry act = tables->getActionEntry(state, t);
+      if (tables->isShiftAction(act)) {
+        shifts.push_back(std::make_pair(t, (int)tables->decodeShift(act, t)));
+      }
+      else if (tables->isReduceAction(act)) {
+        reductions[tables->decodeReduce(act, state)].push_back(t);
+      }
+      // otherwise error or conflict: stuck
+    }
+
+    if (shifts.empty() && reductions.empty()) {
+      out << "        return DP_STUCK;\n";
+      continue;
+    }
+
+    out << "        switch (tok) {\n";
+    for (auto const &sh : shifts) {
+      if (sh.first == 0) {
+        // shifting EOF ends the parse
+        out << "          case 0: goto accept;\n";
+        acceptUsed = true;
+      }
+      else {
+        out << "          case " << sh.first << ": next = (StateId)"
+            << sh.second << "; goto shift;\n";
+      }
+    }
+    for (auto const &r : reductions) {
+      for (size_t i=0; i < r.second.size(); i++) {
+        out << (i%8 == 0? (i? "\n          " : "          ") : " ")
+            << "case " << r.second[i] << ":";
+      }
+      out << "\n"
+          << "            goto reduce" << r.first << ";\n";
+      prodUsed[r.first] = true;
+      ntUsed[tables->getProdInfo(r.first).lhsIndex] = true;
+    }
+    out << "          default: return DP_STUCK;\n"
+        << "        }\n";
+  }
+
+  out << "      default:\n"
+      << "        assert(!\"invalid state\");\n"
+      << "        return DP_STUCK;\n"
+      << "    }\n"
+      << "\n"
+      << "  shift:\n"
+      << "    stack.column++;\n"
+      << "    stack.push(next, lexer.sval, lexer.loc);\n"
+      << "    state = next;\n"
+      << "    if (!lexer.takePending()) {\n"
+      << "      nextToken(&lexer);\n"
+      << "    }\n"
+      << "    tok = reclassifyToken(ths, lexer.type, lexer.sval);\n"
+      << "    continue;\n"
+      ;
+
+  // reductions; each pops the right-hand side, calls the action,
+  // and goes to the goto code for its left-hand side
+  for (int p=0; p < numProds; p++) {
+    if (!prodUsed[p]) continue;
+    Production const *prod = g.getProduction(p);
+    ParseTables::ProdInfo const &info = tables->getProdInfo(p);
+
+    out << "\n"
+        << "  reduce" << p << ":     // " << prod->toString() << "\n"
+        << "    rhs = stack.pop(" << (int)info.rhsLen << ");\n"
+        << "    leftEdge = DirectLRStack::leftEdge(rhs, " << (int)info.rhsLen
+        << ", lexer.loc);\n"
+        << "    sval = ";
+    emitActionCall(out, *prod, "rhs[", "].sval", "leftEdge");
+    out << ";\n"
+        << "    goto goto" << (int)info.lhsIndex << ";\n";
+  }
+
+  // for each nonterminal, push the state it leads to from the state
+  // uncovered by the reduction
+  for (int nt=0; nt < numNonterms; nt++) {
+    if (!ntUsed[nt]) continue;
+    Nonterminal const *nonterm = g.getNonterminal(nt);
+
+    out << "\n"
+        << "  goto" << nt << ":     // " << nonterm->name << "\n"
+        << "    switch ((int)stack.topState()) {\n";
+    for (int s=0; s < numStates; s++) {
+      GotoEntry ge = tables->getGotoEntry((StateId)s, nt);
+      if (!tables->isErrorGoto(ge)) {
+        out << "      case " << s << ": next = (StateId)"
+            << tables->decodeGoto(ge, nt) << "; break;\n";
+      }
+    }
+    out << "      default:\n"
+        << "        assert(!\"invalid goto\");\n"
+        << "        return DP_STUCK;\n"
+        << "    }\n"
+        << "    stack.push(next, sval, leftEdge);\n"
+        << "    state = next;\n";
+    if (nonterm->keepCode) {
+      out << "    if (!ths->keep_" << nonterm->name << "(("
+          << notVoid(nonterm->type) << ")sval)) {\n"
+          << "      return DP_CANCELLED;\n"
+          << "    }\n";
+    }
+    out << "    continue;\n";
+  }
+
+  // like GLR::cleanupAfterParse, do the final reduction here rather
+  // than shifting EOF
+  if (acceptUsed) {
+    out << "\n"
+        << "  accept: {\n"
+        << "    SemanticValue svals[2];\n"
+        << "    svals[0] = stack.pop(1)->sval;\n"
+        << "    svals[1] = lexer.sval;\n"
+        << "    treeTop = doReductionAction(ths, "
+        << tables->finalProductionIndex << ", svals"
+        SOURCELOC( << ", lexer.loc" )
+        << ");\n"
+        << "    return DP_DONE;\n"
+        << "  }\n";
+  }
+
+  out << "  }\n"
+      << "}\n"
+      << "\n"
+      << "UserActions::DirectParseFunc " << acn
+      << "::getDirectParser(ParseTables const *tables)\n"
+      << "{\n"
+      << "  // the state numbers above are only good for the tables\n"
+      << "  // made by 'makeTables'\n"
+      << "  if (tables->getNumStates() != " << numStates << " ||\n"
+      << "      tables->getNumTerms() != " << numTerms << " ||\n"
+      << "      tables->getNumNonterms() != " << numNonterms << " ||\n"
+      << "      tables->getNumProds() != " << numProds << " ||\n"
+      << "      tables->startState != " << (int)tables->startState << " ||\n"
+      << "      tables->getChecksum() != " << tables->getChecksum() << "u) {\n"
+      << "    return NULL;\n"
+      << "  }\n"
+      << "  return (DirectParseFunc)&" << acn << "::directParse;\n"
+      << "}\n";
+}
+
+
 // emit both the function decl for the .h file, and the beginning of
 // the function definition for the .cc file
 void emitFuncDecl(Grammar const &g, EmitCode &out, EmitCode &dcl,
@@ -4877,7 +6710,6 @@ void emitSwitchCode(Grammar const &g, EmitCode &out,
 // TODO: split this into its own source file
 #ifdef GRAMANL_MAIN
 
-#include "bflatten.h"          // BFlatten
 #include "test.h"              // ARGS_MAIN
 #include "gramast.ast.gen.h"   // GrammarAST
 
@@ -4906,11 +6738,39 @@ int inner_entry(int argc, char **argv)
   // output files
   bool leavePartialOutputs = false;
 
+  // when true, emit a directly-coded parser too
+  bool direct = false;
+
+  // when true, also write the tables to <prefix>.tables
+  bool binaryTables = false;
+
+  // threads to use for the LR item set construction
+  int numThreads = 1;
+
+  // when true, compute the LALR(1) lookaheads from the LR(0) automaton
+  bool relationalLookaheads = false;
+
+  // when true, make LR(1) tables with as few states as this can
+  bool minimalLR1 = false;
+
+  // how to compress and encode the tables, as TableLayout bits
+  int tableLayout = 0;
+
+  // when not NULL, reuse analyses kept in this directory
+  char const *cacheDir = NULL;
+
+  // when not NULL, number the states by this parse profile
+  char const *profileFname = NULL;
+
+  // all the -tr arguments, since they change what the analysis prints
+  string traceFlags;
+
   while (argv[0] && argv[0][0] == '-') {
     char const *op = argv[0]+1;
     if (0==strcmp(op, "tr")) {
       SHIFT;
       traceAddMultiSys(argv[0]);
+      traceFlags += fmt::format("-tr {} ", argv[0]);
       SHIFT;
     }
     else if (0==strcmp(op, "v")) {
@@ -4936,6 +6796,68 @@ int inner_entry(int argc, char **argv)
       SHIFT;
       leavePartialOutputs = true;
     }
+    else if (0==strcmp(op, "direct")) {
+      SHIFT;
+      direct = true;
+    }
+    else if (0==strcmp(op, "tables")) {
+      SHIFT;
+      binaryTables = true;
+    }
+    else if (0==strcmp(op, "dp")) {
+      SHIFT;
+      relationalLookaheads = true;
+    }
+    else if (0==strcmp(op, "lr1")) {
+      SHIFT;
+      minimalLR1 = true;
+    }
+    else if (0==strcmp(op, "eef")) {
+      SHIFT;
+      tableLayout |= TL_EEF;
+    }
+    else if (0==strcmp(op, "gcs")) {
+      SHIFT;
+      tableLayout |= TL_EEF | TL_GCS;
+    }
+    else if (0==strcmp(op, "gcsc")) {
+      SHIFT;
+      tableLayout |= TL_EEF | TL_GCS | TL_GCSC;
+    }
+    else if (0==strcmp(op, "rds")) {
+      SHIFT;
+      tableLayout |= TL_RDS;
+    }
+    else if (0==strcmp(op, "crs")) {
+      SHIFT;
+      tableLayout |= TL_CRS;
+    }
+    else if (0==strcmp(op, "cache")) {
+      SHIFT;
+      if (!argv[0]) {
+        std::cout << "-cache needs a directory\n";
+        exit(2);
+      }
+      cacheDir = argv[0];
+      SHIFT;
+    }
+    else if (0==strcmp(op, "profile")) {
+      SHIFT;
+      if (!argv[0]) {
+        std::cout << "-profile needs a file\n";
+        exit(2);
+      }
+      profileFname = argv[0];
+      SHIFT;
+    }
+    else if (0==strcmp(op, "j")) {
+      SHIFT;
+      if (!argv[0] || (numThreads = atoi(argv[0])) < 1) {
+        std::cout << "-j needs a positive number of threads\n";
+        exit(2);
+      }
+      SHIFT;
+    }
     else {
       std::cout << "unknown option: " << argv[0] << std::endl;
       exit(2);
@@ -4960,10 +6882,59 @@ int inner_entry(int argc, char **argv)
             "                    (default is filename.gen.h, filename.gen.cc)\n"
             "  -ocaml          : generate ocaml parser instead of C++ parser\n"
             "  -leavePartial   : do not delete output files in case of error\n"
+            "  -direct         : also emit a directly-coded parser, which does\n"
+            "                    the deterministic parts of a parse without\n"
+            "                    the tables\n"
+            "  -tables         : also write the parse tables to <prefix>.tables,\n"
+            "                    for ParseTables::loadBinary\n"
+            "  -j <n>          : use <n> threads to construct the LR item sets\n"
+            "                    (and the derivability relation, if it's big)\n"
+            "  -dp             : compute the LALR(1) lookaheads with DeRemer and\n"
+            "                    Pennello's relations, after building the LR(0)\n"
+            "                    item sets (same tables, usually faster)\n"
+            "  -lr1            : make LR(1) tables, splitting only the LALR(1)\n"
+            "                    states whose merged lookaheads add conflicts\n"
+            "                    (slower; ignores -dp and -j)\n"
+            "  -eef            : compress the tables by Error Entry Factoring:\n"
+            "                    error actions in a bitmap of their own\n"
+            "  -gcs            : also merge compatible rows (Graph Coloring\n"
+            "                    Scheme); implies -eef\n"
+            "  -gcsc           : also merge compatible columns; implies -gcs\n"
+            "  -rds            : overlay the rows in one vector with a check\n"
+            "                    vector (Row Displacement Scheme)\n"
+            "  -crs            : encode the table entries with the Code\n"
+            "                    Reduction Scheme: indices relative to the\n"
+            "                    state and symbol, up to 16383 of each\n"
+            "                    (the parser reads any of these layouts, so\n"
+            "                    they need no rebuild of the parser core)\n"
+            "  -cache <dir>    : keep the tables and reports of each grammar in\n"
+            "                    <dir>, and reuse them when only the actions\n"
+            "                    change (not with -tr lrtable); also keep the\n"
+            "                    LR(0) item sets of the base grammar, and reuse\n"
+            "                    the parts that extension modules do not change\n"
+            "  -profile <file> : number the states so those a parser uses\n"
+            "                    together are adjacent in the tables; <file>\n"
+            "                    comes from a parser's -profile mode, run with\n"
+            "                    tables made without this option\n"
             ;
     return 0;
   }
 
+  if ((tableLayout & TL_GCS) && (tableLayout & TL_RDS)) {
+    std::cout << "-rds can't be used with -gcs or -gcsc\n";
+    exit(2);
+  }
+  if ((tableLayout & TL_CRS) && profileFname) {
+    std::cout << "-profile can't be used with -crs, which needs the states\n"
+                 "grouped by symbol\n";
+    exit(2);
+  }
+  if (tableLayout && useML) {
+    std::cout << "the table compression options can't be used with -ocaml,\n"
+                 "whose parser core only reads plain tables\n";
+    exit(2);
+  }
+
   if (!prefix.length()) {
     // default naming scheme
     prefix = replace(argv[0], ".gr", "");
@@ -4986,6 +6957,22 @@ int inner_entry(int argc, char **argv)
 
   // parse the AST into a Grammar
   GrammarAnalysis g;
+  g.numThreads = numThreads;
+  g.relationalLookaheads = relationalLookaheads;
+  g.minimalLR1 = minimalLR1;
+  g.tableLayout = tableLayout;
+  if (profileFname) {
+    g.profileFname = profileFname;
+  }
+  if (cacheDir) {
+    g.cacheDir = cacheDir;
+    g.cacheSalt = traceFlags;
+
+    // named after the base grammar alone, so it is shared by all the
+    // combinations of extension modules used with it
+    g.automatonFname = fmt::format("{}/{}.lr0", cacheDir,
+                                   replace(sm_basename(grammarFname), ".gr", ""));
+  }
   if (useML) {
     g.targetLang = "OCaml";
   }
@@ -5012,7 +6999,7 @@ int inner_entry(int argc, char **argv)
                     << " and " << hFname << " ...\n";
 
     try {
-      emitActionCode(g, hFname, ccFname, grammarFname);
+      emitActionCode(g, hFname, ccFname, grammarFname, direct);
     }
     catch (...) {
       if (!leavePartialOutputs) {
@@ -5025,6 +7012,12 @@ int inner_entry(int argc, char **argv)
       }
       throw;
     }
+
+    if (binaryTables) {
+      string tablesFname = fmt::format("{}.tables", prefix);
+      traceProgress() << "writing parse tables to " << tablesFname << " ...\n";
+      g.tables->writeBinary(tablesFname.c_str());
+    }
   }
   else {
     // emit some ML code
@@ -23,6 +23,7 @@
 #include "stack.h"        // sm::stack
 
 #include <vector>         // std::vector
+#include <utility>        // std::pair
 
 // forward decls
 class Bit2d;              // bit2d.h
@@ -59,13 +60,6 @@ public:     // data
   // sentential form can derive epsilon (the empty string)
   bool canDeriveEmpty;
 
-  // during item set closure, I need a way to map from dotted prods to
-  // the items which use them; so rather than use a hash table, I'll
-  // just annotate the dprods themselves with backpointers; these
-  // backpointers *must* be maintained as NULL when there's no
-  // association
-  mutable class LRItem *backPointer;
-
 private:    // funcs
   void init();
 
@@ -345,6 +339,7 @@ public:     // funcs
 
   // ------ hashtable stuff --------
   friend struct ItemSetHash;
+  friend struct LR1ItemSetHash;
 
   // ---- debugging ----
   void writeGraph(std::ostream &os, GrammarAnalysis const &g) const;
@@ -393,6 +388,10 @@ protected:  // data
   // canonical order
   int nextItemSetId;
 
+  // normally true; while false, itemSetClosure leaves the lookaheads
+  // empty, to build the LR(0) item sets
+  bool closureLookaheads;
+
   // the LR parsing tables
   std::vector<ItemSet *> itemSets;      // owning list
 
@@ -419,6 +418,46 @@ public:	    // data
   // parse tables
   ParseTables *tables;                  // (owner)
 
+  // number of threads constructLRItemSets may use; with 1 (the
+  // default) it runs the original serial algorithm; big grammars'
+  // derivability relations are also closed with this many
+  int numThreads;
+
+  // when true, constructLRItemSets builds the LR(0) item sets and then
+  // computes the LALR(1) lookaheads with DeRemer and Pennello's
+  // relations, instead of propagating lookaheads during construction
+  bool relationalLookaheads;
+
+  // when true, constructLRItemSets builds the canonical LR(1) item
+  // sets and merges them only where that adds no conflicts, so the
+  // tables have LR(1)'s conflicts with close to LALR(1)'s states;
+  // overrides 'relationalLookaheads' and 'numThreads'
+  bool minimalLR1;
+
+  // how computeParseTables compresses and encodes the tables, as
+  // TableLayout bits (see parsetables.h)
+  int tableLayout;
+
+  // when not empty, runAnalyses first looks in this directory for
+  // the tables and reports of a grammar with the same key (see
+  // 'cacheKey'), and stores its own there when there are none
+  string cacheDir;
+
+  // settings outside the grammar that change what the analysis
+  // prints, such as the trace flags; part of the cache key
+  string cacheSalt;
+
+  // when not empty, constructLRItemSets builds the LR(0) item sets
+  // (then computes lookaheads as with 'relationalLookaheads'), reusing
+  // whatever the grammar changes left intact in the item sets saved
+  // in this file by an earlier run, and then saves its own there
+  string automatonFname;
+
+  // when not empty, a ParseProfile (parseprof.h) of these tables as
+  // they are numbered without it; renumberStates then orders the
+  // states so that those used together are next to each other
+  string profileFname;
+
 private:    // funcs
   class Finished;
   // ---- analyis init ----
@@ -482,7 +521,18 @@ private:    // funcs
                              ItemSet const *itemSet);
   static bool itemSetsEqual(ItemSet const *is1, ItemSet const *is2);
 
+  // the kernels reached from one item set, by symbol
+  typedef std::vector<std::pair<Symbol const*, ItemSet*>> Moves;
+  void moveDotAllSymbols(ItemSet const *source, Moves &moves,
+                         std::vector<DottedProduction const*> &array);
+
   void constructLRItemSets();
+  void constructLRItemSetsSerial();
+  void constructLRItemSetsParallel();
+  void constructLRItemSetsIncremental();
+  void computeRelationalLookaheads();
+  void constructCanonicalLR1ItemSets(std::vector<ItemSet*> &states);
+  void mergeLR1ItemSets(std::vector<ItemSet*> &lr1);
   void lrParse(char const *input);
 
   void handleShiftReduceConflict(
@@ -505,6 +555,7 @@ private:    // funcs
     ProductionList &reductions); // list to try to cut down
 
   void renumberStates();
+  void profileStateOrder();
   static int renumberStatesDiff
     (ItemSet const *left, ItemSet const *right, void *vgramanl);
   static int arbitraryProductionOrder
@@ -514,6 +565,11 @@ private:    // funcs
 
   void computeBFSTree();
 
+  // ---- analysis cache ----
+  void analyze(char const *setsFname);
+  bool loadCachedAnalyses(rostring base);
+  void saveCachedAnalyses(rostring base, rostring report) const;
+
   // misc
   void computePredictiveParsingTable();
     // non-const because have to add productions to lists
@@ -539,6 +595,7 @@ private:    // funcs
 
   void singleItemClosure(Finished &finished,
                          sm::stack<LRItem*> &worklist,
+                         std::vector<LRItem*> &onWorklist,
                          LRItem const *item, TerminalSet &scratchSet);
 
 public:	    // funcs
@@ -575,6 +632,11 @@ public:	    // funcs
   // sets to the given file (or don't, if NULL)
   void runAnalyses(char const *setsFname);
 
+  // hash of what determines the tables and the analysis reports:
+  // the symbols, productions, precedence, conflict expectations and
+  // 'cacheSalt', but none of the action code
+  uint64_t cacheKey() const;
+
   // print the item sets to a stream (optionally include nonkernel items)
   void printItemSets(std::ostream &os, bool nonkernel) const;
 
@@ -598,6 +660,12 @@ public:	    // funcs
 
   // ---- moved out of private ----
   void itemSetClosure(ItemSet &itemSet);
+
+  // same, but with caller-supplied scratch: 'onWorklist' maps a
+  // production index to the item for its dot-0 dprod while that item
+  // is on the closure worklist; it must have 'numProds' entries, all
+  // NULL, and is left that way, so one thread can reuse it
+  void itemSetClosure(ItemSet &itemSet, std::vector<LRItem*> &onWorklist);
   DottedProduction const *getDProdIndex(int prodIndex, int posn) const;
 };
 
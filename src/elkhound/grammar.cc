@@ -11,11 +11,20 @@
 #include "flatutil.h"  // various xfer helpers
 
 #include <algorithm>   // std::max
+#include <utility>     // std::move
+#include <string.h>    // memcpy, memset, memcmp
 #include <stdarg.h>    // variable-args stuff
 #include <stdio.h>     // FILE, etc.
 #include <ctype.h>     // isupper
 #include <stdlib.h>    // atoi
 
+#ifdef __AVX2__
+  #include <immintrin.h> // _mm256_*
+#endif
+#if defined(_MSC_VER) && defined(_M_X64)
+  #include <intrin.h>    // __popcnt64
+#endif
+
 
 // print a variable value
 #define PVAL(var) os << " " << #var "=" << var;
@@ -324,120 +333,266 @@ bool Nonterminal::anyDDM() const
 STATICDEF Terminal const *TerminalSet::suppressExcept = NULL;
 
 TerminalSet::TerminalSet(int numTerms)
+  : words(inlineWords), numWords(0), numBytes(0)
 {
   reset(numTerms);
 }
 
+TerminalSet::TerminalSet(TerminalSet const &obj)
+  : words(inlineWords), numWords(0), numBytes(0)
+{
+  *this = obj;
+}
+
+TerminalSet::TerminalSet(TerminalSet &&obj)
+  : words(inlineWords), numWords(0), numBytes(0)
+{
+  *this = std::move(obj);
+}
+
+TerminalSet& TerminalSet::operator= (TerminalSet const &obj)
+{
+  if (this != &obj) {
+    allocate(obj.numBytes);
+    memcpy(words, obj.words, numWords * sizeof(Word));
+  }
+  return *this;
+}
+
+TerminalSet& TerminalSet::operator= (TerminalSet &&obj)
+{
+  if (obj.words == obj.inlineWords) {
+    return *this = obj;
+  }
+  if (this != &obj) {
+    // take the heap array
+    deallocate();
+    words = obj.words;
+    numWords = obj.numWords;
+    numBytes = obj.numBytes;
+    obj.words = obj.inlineWords;
+    obj.numWords = obj.numBytes = 0;
+  }
+  return *this;
+}
+
+
+// make room for 'bytes' bytes of bitmap, contents unspecified
+void TerminalSet::allocate(int bytes)
+{
+  int len = (bytes + sizeof(Word) - 1) / sizeof(Word);
+  if (len != numWords) {
+    deallocate();
+    if (len > INLINE_WORDS) {
+      words = new Word[len];
+    }
+    numWords = len;
+  }
+  numBytes = bytes;
+}
+
+void TerminalSet::deallocate()
+{
+  if (words != inlineWords) {
+    delete[] words;
+    words = inlineWords;
+  }
+  numWords = numBytes = 0;
+}
+
+
 void TerminalSet::reset(int numTerms)
 {
   // numTerms can be zero
   // allocate enough space for one bit per terminal; I assume
   // 8 bits per byte
-  int bitmapLen = (numTerms + 7) / 8;
-  bitmap.resize(0);
-  bitmap.resize(bitmapLen);
+  allocate((numTerms + 7) / 8);
+  clear();
 }
 
 
 TerminalSet::TerminalSet(Flatten&)
+  : words(inlineWords), numWords(0), numBytes(0)
 {}
 
 void TerminalSet::xfer(Flatten &flat)
 {
-  int bitmapLen = bitmap.size();
+  // written as a byte bitmap, lsb of byte 0 is index 0, so the
+  // format does not depend on the word size or byte order
+  int bitmapLen = numBytes;
   flat.xferInt(bitmapLen);
 
-  if (!bitmap.empty()) {
-    if (flat.reading()) {
-      bitmap.resize(bitmapLen);
+  if (bitmapLen) {
+    std::vector<unsigned char> bitmap(bitmapLen);
+    if (flat.writing()) {
+      for (int i=0; i < bitmapLen; i++) {
+        bitmap[i] = (unsigned char)(words[i / sizeof(Word)] >> (8 * (i % sizeof(Word))));
+      }
     }
     flat.xferSimple(bitmap.data(), bitmapLen);
+    if (flat.reading()) {
+      reset(bitmapLen * 8);
+      for (int i=0; i < bitmapLen; i++) {
+        words[i / sizeof(Word)] |= (Word)bitmap[i] << (8 * (i % sizeof(Word)));
+      }
+    }
   }
 }
 
-static inline constexpr int getBit(int terminalId)
+
+bool TerminalSet::isEqual(TerminalSet const &obj) const
 {
-  return ((unsigned)terminalId % 8);
+  xassert(obj.numBytes == numBytes);
+  return 0==memcmp(words, obj.words, numWords * sizeof(Word));
 }
 
-unsigned char *TerminalSet::getByte(int id) const
-{
-  int offset = (unsigned)id / 8;
-  xassert(offset < bitmap.size());
 
-  return const_cast<unsigned char*>(&bitmap[offset]);
+static inline int popcount(TerminalSet::Word w)
+{
+  #if defined(__GNUC__)
+    return __builtin_popcountll(w);
+  #elif defined(_MSC_VER) && defined(_M_X64)
+    return (int)__popcnt64(w);
+  #else
+    int ct = 0;
+    for (; w; w &= w-1) {
+      ct++;
+    }
+    return ct;
+  #endif
 }
 
-
-bool TerminalSet::contains(int id) const
+int TerminalSet::count() const
 {
-  unsigned char *p = getByte(id);
-  return ((*p >> getBit(id)) & 1) == 1;
+  int ct = 0;
+  for (int i=0; i < numWords; i++) {
+    ct += popcount(words[i]);
+  }
+  return ct;
 }
 
 
-bool TerminalSet::isEqual(TerminalSet const &obj) const
+size_t TerminalSet::hash() const
 {
-  xassert(obj.bitmap.size() == bitmap.size());
-  return 0==memcmp(bitmap.data(), obj.bitmap.data(), bitmap.size());
+  // multiplicative mixing, one word at a time
+  uint64_t h = numWords;
+  for (int i=0; i < numWords; i++) {
+    h = (h ^ words[i]) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+  }
+  return (size_t)h;
 }
 
 
 void TerminalSet::add(int id)
 {
-  unsigned char *p = getByte(id);
-  *p |= (unsigned char)(1 << getBit(id));
+  xassert((unsigned)id < (unsigned)numBytes * 8);
+  words[(unsigned)id / WORD_BITS] |= (Word)1 << ((unsigned)id % WORD_BITS);
 }
 
 
 void TerminalSet::remove(int id)
 {
-  unsigned char *p = getByte(id);
-  *p &= (unsigned char)(~(1 << getBit(id)));
+  xassert((unsigned)id < (unsigned)numBytes * 8);
+  words[(unsigned)id / WORD_BITS] &= ~((Word)1 << ((unsigned)id % WORD_BITS));
 }
 
 
 void TerminalSet::clear()
 {
-  memset(bitmap.data(), 0, bitmap.size());
+  memset(words, 0, numWords * sizeof(Word));
 }
 
 
 void TerminalSet::copy(TerminalSet const &obj)
 {
-  xassert(obj.bitmap.size() == bitmap.size());
-  memcpy(bitmap.data(), obj.bitmap.data(), bitmap.size());
+  xassert(obj.numBytes == numBytes);
+  memcpy(words, obj.words, numWords * sizeof(Word));
 }
 
 
+// The three updating operations below compute 'after' from 'before'
+// word by word and accumulate the bits they changed, rather than
+// comparing each word, so the loops have no branches; with AVX2 they
+// do four words at a time.
 bool TerminalSet::merge(TerminalSet const &obj)
 {
-  bool changed = false;
-  for (int i=0; i<bitmap.size(); i++) {
-    unsigned before = bitmap[i];
-    unsigned after = before | obj.bitmap[i];
-    if (after != before) {
-      changed = true;
-      bitmap[i] = after;
+  xassertdb(obj.numBytes == numBytes);
+  Word changed = 0;
+  int i = 0;
+
+  #ifdef __AVX2__
+    __m256i any = _mm256_setzero_si256();
+    for (; i+4 <= numWords; i += 4) {
+      __m256i before = _mm256_loadu_si256((__m256i const*)(words+i));
+      __m256i other = _mm256_loadu_si256((__m256i const*)(obj.words+i));
+      any = _mm256_or_si256(any, _mm256_andnot_si256(before, other));
+      _mm256_storeu_si256((__m256i*)(words+i), _mm256_or_si256(before, other));
     }
+    changed = !_mm256_testz_si256(any, any);
+  #endif
+
+  for (; i < numWords; i++) {
+    Word before = words[i];
+    changed |= obj.words[i] & ~before;
+    words[i] = before | obj.words[i];
   }
-  return changed;
+  return changed != 0;
 }
 
 
 bool TerminalSet::removeSet(TerminalSet const &obj)
 {
-  xassertdb(obj.bitmap.size() == bitmap.size());
-  bool changed = false;
-  for (int i=0; i<bitmap.size(); i++) {
-    unsigned before = bitmap[i];
-    unsigned after = before & ~(obj.bitmap[i]);
-    if (after != before) {
-      changed = true;
-      bitmap[i] = after;
+  xassertdb(obj.numBytes == numBytes);
+  Word changed = 0;
+  int i = 0;
+
+  #ifdef __AVX2__
+    __m256i any = _mm256_setzero_si256();
+    for (; i+4 <= numWords; i += 4) {
+      __m256i before = _mm256_loadu_si256((__m256i const*)(words+i));
+      __m256i other = _mm256_loadu_si256((__m256i const*)(obj.words+i));
+      any = _mm256_or_si256(any, _mm256_and_si256(before, other));
+      _mm256_storeu_si256((__m256i*)(words+i), _mm256_andnot_si256(other, before));
+    }
+    changed = !_mm256_testz_si256(any, any);
+  #endif
+
+  for (; i < numWords; i++) {
+    Word before = words[i];
+    changed |= before & obj.words[i];
+    words[i] = before & ~obj.words[i];
+  }
+  return changed != 0;
+}
+
+
+bool TerminalSet::mergeExcept(TerminalSet const &obj, TerminalSet const &mask)
+{
+  xassertdb(obj.numBytes == numBytes && mask.numBytes == numBytes);
+  Word changed = 0;
+  int i = 0;
+
+  #ifdef __AVX2__
+    __m256i any = _mm256_setzero_si256();
+    for (; i+4 <= numWords; i += 4) {
+      __m256i before = _mm256_loadu_si256((__m256i const*)(words+i));
+      __m256i other = _mm256_andnot_si256(
+        _mm256_loadu_si256((__m256i const*)(mask.words+i)),
+        _mm256_loadu_si256((__m256i const*)(obj.words+i)));
+      any = _mm256_or_si256(any, _mm256_andnot_si256(before, other));
+      _mm256_storeu_si256((__m256i*)(words+i), _mm256_or_si256(before, other));
     }
+    changed = !_mm256_testz_si256(any, any);
+  #endif
+
+  for (; i < numWords; i++) {
+    Word before = words[i];
+    Word other = obj.words[i] & ~mask.words[i];
+    changed |= other & ~before;
+    words[i] = before | other;
   }
-  return changed;
+  return changed != 0;
 }
 
 
@@ -25,11 +25,14 @@
 #include <iostream>      // std::ostream
 #include <list>          // std::list
 #include <vector>        // std::vector
+#include <stddef.h>      // size_t
+#include <stdint.h>      // uint64_t
 
 #include "str.h"         // string
 #include "util.h"        // OSTREAM_OPERATOR, INTLOOP
 #include "locstr.h"      // LocString, StringRef
 #include "asockind.h"    // AssocKind
+#include "xassert.h"     // xassert, xassertdb
 
 class StrtokParse;       // strtokp.h
 
@@ -204,10 +207,26 @@ string terminalSequenceToString(TerminalList const &list);
 // used for the lookahead sets of LR items, and for the First()
 // sets of production RHSs
 class TerminalSet {
+public:     // types
+  // the bitmap is kept in words of this size, so the set operations
+  // handle 64 terminals per step
+  typedef uint64_t Word;
+  enum {
+    WORD_BITS = 64,
+    INLINE_WORDS = 4,     // sets for up to 256 terminals need no heap
+  };
+
 private:    // data
-  // This is not std::vector<bool> because it's super slow in debug builds.
-  // bitmap of terminals, indexed by terminal id; lsb of byte 0 is index 0
-  std::vector<unsigned char> bitmap;
+  // bitmap of terminals, indexed by terminal id; bit 0 of word 0 is
+  // index 0, and bits past the last terminal are always 0; points at
+  // 'inlineWords' or, for big sets, a heap array (owner)
+  Word *words;
+  int numWords;
+
+  // size of the set as a byte bitmap, which is what 'xfer' writes
+  int numBytes;
+
+  Word inlineWords[INLINE_WORDS];
 
 public:     // data
   // printing customization: when non-NULL only print tokens if
@@ -215,12 +234,17 @@ public:     // data
   static Terminal const *suppressExcept;
 
 private:    // funcs
-  unsigned char *getByte(int terminalId) const;
+  void allocate(int numBytes);
+  void deallocate();
 
 public:     // funcs
-  TerminalSet() = default;
+  TerminalSet() : words(inlineWords), numWords(0), numBytes(0) {}
   explicit TerminalSet(int numTerms);
-  // C++-provided copy & move operations are OK
+  TerminalSet(TerminalSet const &obj);
+  TerminalSet(TerminalSet &&obj);
+  TerminalSet& operator= (TerminalSet const &obj);
+  TerminalSet& operator= (TerminalSet &&obj);
+  ~TerminalSet() { deallocate(); }
 
   TerminalSet(Flatten&);
   void xfer(Flatten &flat);
@@ -229,14 +253,25 @@ public:     // funcs
   void reset(int numTerms);
 
   // true when the # of symbols is 0; an unfinished state
-  bool empty() const { return bitmap.empty(); }
+  bool empty() const { return numBytes == 0; }
 
-  bool contains(int terminalId) const;
+  bool contains(int terminalId) const
+  {
+    xassert((unsigned)terminalId < (unsigned)numBytes * 8);
+    return (words[(unsigned)terminalId / WORD_BITS] >>
+            ((unsigned)terminalId % WORD_BITS)) & 1;
+  }
 
   // NOTE: can only compare dotted productions which have the
   // same number of symbols (assertion fail otherwise)
   bool isEqual(TerminalSet const &obj) const;
 
+  // # of terminals in the set
+  int count() const;
+
+  // hash of the contents, consistent with 'isEqual'
+  size_t hash() const;
+
   void add(int terminalId);
   void remove(int terminalId);
   void clear();
@@ -245,6 +280,10 @@ public:     // funcs
   bool merge(TerminalSet const &obj);     // union; returns true if merging changed set
   bool removeSet(TerminalSet const &obj); // intersect with complement; returns true if this changed set
 
+  // union with 'obj' minus 'mask', in one pass; returns true if
+  // this changed set
+  bool mergeExcept(TerminalSet const &obj, TerminalSet const &mask);
+
   void print(std::ostream &os, Grammar const &g, char const *lead = ", ") const;
 };
 
@@ -22,6 +22,13 @@ public:     // types
   // likely to be used as a legitimate sval for EOF.
   enum { DEFAULT_UNPRIMED_SVAL = 0x34D9423E };
 
+  // one token of a batch; see 'bufNext', below
+  struct BufferedToken {
+    int type;
+    SemanticValue sval;
+    SourceLoc loc;
+  };
+
 public:     // data
   // NOTE: All of these fields are *written* by the lexer, and
   // *read* by the parser.
@@ -42,11 +49,28 @@ public:     // data
   // parser has been compiled to automatically propagate it
   SourceLoc loc;
 
+  // Optionally, the lexer can hand over tokens in batches: the
+  // tokens following the current one are laid out contiguously in
+  // [bufNext, bufEnd), in a buffer the lexer owns, and the parser
+  // takes them from there (see 'takePending') without calling
+  // 'nextToken'.  This saves the indirect call per token, not the
+  // copy: 'takePending' still copies each token into the fields
+  // above, and the lexer has usually copied it into the buffer in
+  // the first place.  Only when the batch is used up does the parser
+  // call 'nextToken', which should deliver the next token as usual
+  // and may stage another batch.  Lexers that don't batch leave both
+  // pointers NULL.  'nextToken' must also work for clients that
+  // ignore the batch, by delivering the token at 'bufNext'.
+  BufferedToken const *bufNext;
+  BufferedToken const *bufEnd;
+
 public:     // funcs
   LexerInterface()
     : type(0),
       sval((SemanticValue)DEFAULT_UNPRIMED_SVAL),
-      loc(SL_UNKNOWN)
+      loc(SL_UNKNOWN),
+      bufNext(NULL),
+      bufEnd(NULL)
   {}
   virtual ~LexerInterface() {}
 
@@ -67,6 +91,20 @@ public:     // funcs
   // the result of a method lookup this wouldn't be necessary.
   virtual NextTokenFunc getTokenFunc() const=0;
 
+  // if a batched token is pending, copy it into 'type', 'sval' and
+  // 'loc' and return true; otherwise the caller must call 'nextToken'
+  bool takePending()
+  {
+    if (bufNext == bufEnd) {
+      return false;
+    }
+    type = bufNext->type;
+    sval = bufNext->sval;
+    loc = bufNext->loc;
+    bufNext++;
+    return true;
+  }
+
 
   // The following functions are called to help create diagnostic
   // reports.  They should describe the current token (the one
@@ -0,0 +1,70 @@
+// mtparse.cc            see license.txt for copyright and terms of use
+// code for mtparse.h
+
+#include "mtparse.h"       // this module
+#include "glr.h"           // GLR
+#include "xassert.h"       // xassert
+
+#include <atomic>          // std::atomic
+#include <exception>       // std::exception_ptr
+#include <mutex>           // std::mutex
+#include <thread>          // std::thread
+#include <vector>          // std::vector
+
+
+ParallelParseJobs::~ParallelParseJobs()
+{}
+
+
+int parallelGlrParse(ParseTables const *tables, ParallelParseJobs &jobs,
+                     int numJobs, int numThreads)
+{
+  xassert(numThreads >= 1);
+
+  // workers claim jobs in order from this counter, so a thread that
+  // draws short inputs just runs more of them
+  std::atomic<int> nextJob(0);
+  std::atomic<int> failures(0);
+
+  std::mutex excMutex;
+  std::exception_ptr firstExc;
+
+  auto worker = [&]() {
+    GLR glr(NULL /*userAct*/, tables);
+
+    for (int i = nextJob++; i < numJobs; i = nextJob++) {
+      try {
+        if (!jobs.parseJob(glr, i)) {
+          failures++;
+        }
+      }
+      catch (...) {
+        failures++;
+        std::lock_guard<std::mutex> lock(excMutex);
+        if (!firstExc) {
+          firstExc = std::current_exception();
+        }
+        break;      // 'glr' is not usable after an exception
+      }
+      glr.userAct = NULL;
+    }
+  };
+
+  // the calling thread does its share of the work too
+  std::vector<std::thread> threads;
+  for (int t=1; t < numThreads; t++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &th : threads) {
+    th.join();
+  }
+
+  if (firstExc) {
+    std::rethrow_exception(firstExc);
+  }
+  return failures;
+}
+
+
+// EOF
@@ -0,0 +1,43 @@
+// mtparse.h            see license.txt for copyright and terms of use
+// run many independent GLR parses concurrently over one ParseTables
+
+// The parse tables are read-only after construction, so every
+// thread can use the same ParseTables object.  Everything else that
+// a parse mutates must be private to that parse:
+//   - the GLR object itself (one per worker thread, reused for
+//     every job that thread runs)
+//   - the user actions (one per job; these generally carry parse
+//     state, e.g. the C parser's scope stack)
+//   - the lexer and whatever it writes into (e.g. a string table)
+// The job object is responsible for the last two.
+
+#ifndef MTPARSE_H
+#define MTPARSE_H
+
+class GLR;                 // glr.h
+class ParseTables;         // parsetables.h
+
+
+// a numbered collection of parse jobs
+class ParallelParseJobs {
+public:
+  virtual ~ParallelParseJobs();
+
+  // parse job 'i' with 'glr', which the caller has already bound to
+  // the shared tables; the job must set 'glr.userAct' to user actions
+  // of its own, and supply a lexer of its own; this may be called on
+  // any thread, but never concurrently for the same 'i' or the same
+  // 'glr'; return false on a parse error
+  virtual bool parseJob(GLR &glr, int i) = 0;
+};
+
+
+// run jobs 0 .. numJobs-1 on 'numThreads' worker threads, each with
+// its own GLR over 'tables'; return the number of jobs that failed;
+// if any job throws, the first exception is rethrown here after all
+// the workers have finished
+int parallelGlrParse(ParseTables const *tables, ParallelParseJobs &jobs,
+                     int numJobs, int numThreads);
+
+
+#endif // MTPARSE_H
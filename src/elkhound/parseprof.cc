@@ -0,0 +1,164 @@
+// parseprof.cc            see license.txt for copyright and terms of use
+// code for parseprof.h
+
+#include "parseprof.h"     // this module
+#include "crc.h"           // crc32
+#include "exc.h"           // xformat, throw_XOpen
+#include "syserr.h"        // xsyserror
+#include "macros.h"        // STATICDEF
+
+#include <fmt/core.h>      // fmt::format
+#include <fstream>         // std::ifstream, std::ofstream
+#include <string>          // std::string
+
+
+// bump this whenever the file format changes
+enum { PROFILE_VERSION = 1 };
+static char const profileMagic[] = "elkhound-profile";
+
+
+ParseProfile::ParseProfile(ParseTables const &tables)
+  : numStates(tables.getNumStates()),
+    numTerms(tables.getNumTerms()),
+    numNonterms(tables.getNumNonterms()),
+    symbolsCRC(0),
+    actionCounts((size_t)numStates * numTerms, 0),
+    gotoCounts((size_t)numStates * numNonterms, 0)
+{
+  std::vector<SymbolId> symbols(numStates);
+  for (int s=0; s < numStates; s++) {
+    symbols[s] = tables.getStateSymbol((StateId)s);
+  }
+  symbolsCRC = stateSymbolsCRC(symbols);
+}
+
+
+// The file is text, so profiles can be looked at and compared:
+//
+//   elkhound-profile <version>
+//   <numStates> <numTerms> <numNonterms> <symbolsCRC>
+//   a <state> <termId> <count>        (one per nonzero action count)
+//   g <state> <nontermId> <count>     (one per nonzero goto count)
+ParseProfile::ParseProfile(char const *fname)
+  : numStates(0),
+    numTerms(0),
+    numNonterms(0),
+    symbolsCRC(0),
+    actionCounts(),
+    gotoCounts()
+{
+  std::ifstream in(fname);
+  if (!in) {
+    throw_XOpen(fname);
+  }
+
+  std::string magic;
+  int version = 0;
+  in >> magic >> version;
+  if (!in || magic != profileMagic) {
+    xformat(fmt::format("{}: not a parse profile", fname));
+  }
+  if (version != PROFILE_VERSION) {
+    xformat(fmt::format("{}: parse profile version is {}, but this "
+                        "program reads version {}",
+                        fname, version, (int)PROFILE_VERSION));
+  }
+
+  in >> numStates >> numTerms >> numNonterms >> symbolsCRC;
+  if (!in || numStates < 0 || numTerms < 0 || numNonterms < 0) {
+    xformat(fmt::format("{}: bad parse profile header", fname));
+  }
+  actionCounts.assign((size_t)numStates * numTerms, 0);
+  gotoCounts.assign((size_t)numStates * numNonterms, 0);
+
+  std::string kind;
+  int state, sym;
+  uint64_t count;
+  while (in >> kind >> state >> sym >> count) {
+    if (kind == "a" && 0 <= state && state < numStates &&
+        0 <= sym && sym < numTerms) {
+      actionCounts[(size_t)state * numTerms + sym] += count;
+    }
+    else if (kind == "g" && 0 <= state && state < numStates &&
+             0 <= sym && sym < numNonterms) {
+      gotoCounts[(size_t)state * numNonterms + sym] += count;
+    }
+    else {
+      xformat(fmt::format("{}: bad parse profile entry: {} {} {} {}",
+                          fname, kind, state, sym, count));
+    }
+  }
+  if (!in.eof()) {
+    xformat(fmt::format("{}: bad parse profile entry", fname));
+  }
+}
+
+
+void ParseProfile::add(ParseProfile const &other)
+{
+  xassert(numStates == other.numStates &&
+          numTerms == other.numTerms &&
+          numNonterms == other.numNonterms &&
+          symbolsCRC == other.symbolsCRC);
+
+  for (size_t i=0; i < actionCounts.size(); i++) {
+    actionCounts[i] += other.actionCounts[i];
+  }
+  for (size_t i=0; i < gotoCounts.size(); i++) {
+    gotoCounts[i] += other.gotoCounts[i];
+  }
+}
+
+
+uint64_t ParseProfile::stateCount(StateId state) const
+{
+  uint64_t ret = 0;
+  for (int t=0; t < numTerms; t++) {
+    ret += actionCounts[(size_t)state * numTerms + t];
+  }
+  for (int nt=0; nt < numNonterms; nt++) {
+    ret += gotoCounts[(size_t)state * numNonterms + nt];
+  }
+  return ret;
+}
+
+
+void ParseProfile::writeFile(char const *fname) const
+{
+  std::ofstream out(fname);
+  if (!out) {
+    throw_XOpen(fname);
+  }
+
+  out << profileMagic << " " << (int)PROFILE_VERSION << "\n"
+      << numStates << " " << numTerms << " " << numNonterms << " "
+      << symbolsCRC << "\n";
+
+  for (int s=0; s < numStates; s++) {
+    for (int t=0; t < numTerms; t++) {
+      if (uint64_t c = actionCounts[(size_t)s * numTerms + t]) {
+        out << "a " << s << " " << t << " " << c << "\n";
+      }
+    }
+    for (int nt=0; nt < numNonterms; nt++) {
+      if (uint64_t c = gotoCounts[(size_t)s * numNonterms + nt]) {
+        out << "g " << s << " " << nt << " " << c << "\n";
+      }
+    }
+  }
+
+  out.close();
+  if (!out) {
+    xsyserror("write", fname);
+  }
+}
+
+
+STATICDEF uint32_t ParseProfile::stateSymbolsCRC(std::vector<SymbolId> const &symbols)
+{
+  return crc32((unsigned char const*)symbols.data(),
+               symbols.size() * sizeof(SymbolId));
+}
+
+
+// EOF
@@ -0,0 +1,69 @@
+// parseprof.h            see license.txt for copyright and terms of use
+// ParseProfile, counts of the parse table lookups a GLR parser makes
+
+// A profile is collected by pointing GLR::profile at one while
+// parsing a corpus, and is then given to 'elkhound -profile', which
+// numbers the states so the rows the parser uses most are next to
+// each other in the tables (see GrammarAnalysis::profileStateOrder).
+//
+// The counts are kept by state id, so a profile only makes sense for
+// tables whose states are numbered the same way as the tables elkhound
+// makes without -profile; the file records a checksum of the states'
+// symbols so that elkhound can tell.
+
+#ifndef PARSEPROF_H
+#define PARSEPROF_H
+
+#include "parsetables.h"   // ParseTables, StateId
+
+#include <vector>          // std::vector
+#include <stdint.h>        // uint32_t, uint64_t
+
+
+class ParseProfile {
+public:     // data
+  // dimensions of the tables profiled
+  int numStates;
+  int numTerms;
+  int numNonterms;
+
+  // crc32 of the tables' state -> symbol map (see 'stateSymbolsCRC')
+  uint32_t symbolsCRC;
+
+  // times each action table cell was looked up, indexed by
+  // (state*numTerms + termId)
+  std::vector<uint64_t> actionCounts;
+
+  // times each goto table cell was looked up, indexed by
+  // (state*numNonterms + nontermId)
+  std::vector<uint64_t> gotoCounts;
+
+public:     // funcs
+  // all counts zero, for the given tables
+  explicit ParseProfile(ParseTables const &tables);
+
+  // read a profile written by 'writeFile'; throws XOpen if the file
+  // can't be read, and xFormat if it isn't a profile
+  explicit ParseProfile(char const *fname);
+
+  void countAction(StateId state, int termId)
+    { actionCounts[state*numTerms + termId]++; }
+  void countGoto(StateId state, int nontermId)
+    { gotoCounts[state*numNonterms + nontermId]++; }
+
+  // add the counts of 'other', a profile of the same tables (for
+  // combining the profiles of parsers running on several threads)
+  void add(ParseProfile const &other);
+
+  // total lookups made in 'state'
+  uint64_t stateCount(StateId state) const;
+
+  // write the nonzero counts to 'fname', as text
+  void writeFile(char const *fname) const;
+
+  // the checksum of a state -> symbol map, for 'symbolsCRC'
+  static uint32_t stateSymbolsCRC(std::vector<SymbolId> const &symbols);
+};
+
+
+#endif // PARSEPROF_H
@@ -7,9 +7,21 @@
 #include "crc.h"            // crc32
 #include "emitcode.h"       // EmitCode
 #include "bit2d.h"          // Bit2d
+#include "syserr.h"         // xsyserror, xformat, throw_XOpenEx
+#include "autofile.h"       // AutoFILE
+#include "macros.h"         // STATICDEF
 
 #include <fmt/core.h>       // fmt::format
-#include <string.h>         // memset
+#include <algorithm>        // std::sort, std::stable_sort, std::max
+#include <memory>           // std::unique_ptr
+#include <type_traits>      // std::remove_reference_t
+#include <string.h>         // memset, memcpy, memcmp, strerror
+#include <errno.h>          // errno
+#include <stdint.h>         // uint32_t, int32_t
+#include <fcntl.h>          // open
+#include <sys/mman.h>       // mmap, munmap
+#include <sys/stat.h>       // fstat
+#include <unistd.h>         // close
 
 
 // array index code
@@ -22,9 +34,10 @@ void printTable(EltType const *table, int size, int rowLength,
                 rostring typeName, rostring tableName);
 
 
-ParseTables::ParseTables(int t, int nt, int s, int p, StateId start, int final)
+ParseTables::ParseTables(int t, int nt, int s, int p, StateId start, int final,
+                         bool crs)
 {
-  alloc(t, nt, s, p, start, final);
+  alloc(t, nt, s, p, start, final, crs);
 }
 
 template <class T>
@@ -43,16 +56,20 @@ void allocZeroArray(T *&arr, int size)
   memset(arr, 0, sizeof(arr[0]) * size);
 }
 
-void ParseTables::alloc(int t, int nt, int s, int p, StateId start, int final)
+void ParseTables::alloc(int t, int nt, int s, int p, StateId start, int final,
+                        bool crs)
 {
   owning = true;
 
   temp = new TempData(s);
+  mapping = NULL;
+  mappingSize = 0;
 
   numTerms = t;
   numNonterms = nt;
   numStates = s;
   numProds = p;
+  checksum = 0;      // set by 'finishTables'
 
   actionCols = numTerms;
   actionRows = numStates;
@@ -79,7 +96,12 @@ void ParseTables::alloc(int t, int nt, int s, int p, StateId start, int final)
 
   allocZeroArray(nontermOrder, nontermOrderSize());
 
-  if (ENABLE_CRS_COMPRESSION) {
+  // the per-state lists are made by 'finishTables'
+  bigProductionListSize = 0;
+  bigProductionList = NULL;
+  productionsForState = NULL;
+  ambigStateTable = NULL;
+  if (crs) {
     allocZeroArray(firstWithTerminal, numTerms);
     allocZeroArray(firstWithNonterminal, numNonterms);
   }
@@ -88,22 +110,6 @@ void ParseTables::alloc(int t, int nt, int s, int p, StateId start, int final)
     firstWithNonterminal = NULL;
   }
 
-  bigProductionListSize = 0;
-  bigProductionList = NULL;
-  if (ENABLE_CRS_COMPRESSION) {
-    allocZeroArray(productionsForState, numStates);
-  }
-  else {
-    productionsForState = NULL;
-  }
-
-  if (ENABLE_CRS_COMPRESSION) {
-    allocZeroArray(ambigStateTable, numStates);
-  }
-  else {
-    ambigStateTable = NULL;
-  }
-
   // # of bytes, but rounded up to nearest 32-bit boundary
   errorBitsRowSize = ((numTerms+31) >> 5) * 4;
 
@@ -117,6 +123,13 @@ void ParseTables::alloc(int t, int nt, int s, int p, StateId start, int final)
 
   gotoIndexMap = NULL;
   gotoRowPointers = NULL;
+
+  actionRowBase = NULL;
+  actionCheck = NULL;
+  gotoRowBase = NULL;
+  gotoCheck = NULL;
+
+  tableLayout = computeLayout();
 }
 
 
@@ -158,6 +171,19 @@ ParseTables::~ParseTables()
     if (gotoIndexMap) {
       delete[] gotoIndexMap;
     }
+
+    if (actionRowBase) {
+      delete[] actionRowBase;
+    }
+    if (actionCheck) {
+      delete[] actionCheck;
+    }
+    if (gotoRowBase) {
+      delete[] gotoRowBase;
+    }
+    if (gotoCheck) {
+      delete[] gotoCheck;
+    }
   }
 
   // these are always owned
@@ -176,6 +202,10 @@ ParseTables::~ParseTables()
   if (gotoRowPointers) {
     delete[] gotoRowPointers;
   }
+
+  if (mapping) {
+    munmap(mapping, mappingSize);
+  }
 }
 
 
@@ -213,57 +243,94 @@ GotoEntry ParseTables::validateGoto(int code) const
 }
 
 
-// doesn't init anything; for use by emitConstructionCode's emitted code
+// makes empty tables, with all the arrays NULL; for use by
+// emitConstructionCode's emitted code, and by loadBinary
 ParseTables::ParseTables(bool o)
   : owning(o),
-    temp(NULL)
+    temp(NULL),
+    mapping(NULL),
+    mappingSize(0),
+    numTerms(0),
+    numNonterms(0),
+    numStates(0),
+    numProds(0),
+    checksum(0),
+    tableLayout(0),
+    actionCols(0),
+    actionTable(NULL),
+    gotoCols(0),
+    gotoTable(NULL),
+    prodInfo(NULL),
+    stateSymbol(NULL),
+    ambigTableSize(0),
+    ambigTable(NULL),
+    nontermOrder(NULL),
+    firstWithTerminal(NULL),
+    firstWithNonterminal(NULL),
+    bigProductionListSize(0),
+    bigProductionList(NULL),
+    productionsForState(NULL),
+    ambigStateTable(NULL),
+    errorBitsRowSize(0),
+    uniqueErrorRows(0),
+    errorBits(NULL),
+    errorBitsPointers(NULL),
+    actionIndexMap(NULL),
+    actionRows(0),
+    actionRowPointers(NULL),
+    gotoIndexMap(NULL),
+    gotoRows(0),
+    gotoRowPointers(NULL),
+    actionRowBase(NULL),
+    actionCheck(NULL),
+    gotoRowBase(NULL),
+    gotoCheck(NULL),
+    startState(STATE_INVALID),
+    finalProductionIndex(0)
 {
   xassert(owning == false);
 }
 
 
-#if ENABLE_CRS_COMPRESSION
 ActionEntry makeAE(ActionEntryKind k, int index)
 {
-  // must fit into 6 bits for my encoding
-  if ((unsigned)index <= AE_MAXINDEX) {
-    // ok
-  }
-  else {
-    xfailure(stringc << "index " << index << " truncated!");
+  // must fit into 14 bits for my encoding
+  if ((unsigned)index > AE_MAXINDEX) {
+    xfailure("CRS index {} is more than {}; the grammar is too big "
+             "for the Code Reduction Scheme", index, (int)AE_MAXINDEX);
   }
 
   if (k == AE_ERROR) {
     xassert(index == 0);
   }
 
-  return k | index;
+  // the kinds with the top bit set wrap around to negative entries
+  return (ActionEntry)(k | index);
 }
-#endif
 
 
 ActionEntry ParseTables::encodeShift(StateId destState, int shiftedTermId)
 {
-  #if ENABLE_CRS_COMPRESSION
+  if (crs_enabled()) {
     int delta = destState - firstWithTerminal[shiftedTermId];
     return makeAE(AE_SHIFT, delta);
-  #else
-    (void)shiftedTermId;
+  }
+  else {
     return validateAction(+destState+1);
-  #endif
+  }
 }
 
 
 ActionEntry ParseTables::encodeReduce(int prodId, StateId inWhatState)
 {
-  #if ENABLE_CRS_COMPRESSION
+  if (crs_enabled()) {
     int begin = temp->productionsForState[inWhatState];
-    int end = temp->bigProductionList.length();
+    int end = temp->bigProductionList.size();
     if (begin == UNASSIGNED) {
       // starting a new set of per-state productions
       temp->productionsForState[inWhatState] = end;
-      temp->bigProductionList.push(prodId);
-      return AE_REDUCE | 0 /*first in set*/;
+      temp->bigProductionList.push_back(prodId);
+      return makeAE(AE_REDUCE, 0 /*first in set*/);
     }
     else {
       // continuing a set; search for existing 'prodId' in that set
@@ -277,26 +344,25 @@ ActionEntry ParseTables::encodeReduce(int prodId, StateId inWhatState)
       }
 
       // not found: add another production id to this set
-      temp->bigProductionList.push(prodId);
+      temp->bigProductionList.push_back(prodId);
       delta = end-begin;
 
     encode:
       return makeAE(AE_REDUCE, delta);
     }
-
-  #else
-    (void)inWhatState;
+  }
+  else {
     return validateAction(-prodId-1);
-  #endif
+  }
 }
 
 
 ActionEntry ParseTables::encodeAmbig
   (sm::stack<ActionEntry> const &set, StateId inWhatState)
 {
-  #if ENABLE_CRS_COMPRESSION
+  if (crs_enabled()) {
     int begin = temp->ambigStateTable[inWhatState];
-    int end = temp->ambigTable.length();
+    int end = temp->ambigTable.size();
     if (begin == UNASSIGNED) {
       // starting a new set of per-state ambiguous actions
       temp->ambigStateTable[inWhatState] = end;
@@ -309,8 +375,7 @@ ActionEntry ParseTables::encodeAmbig
       // sets are constructed, their representation is canonical.
       // This is important because some grammars (cc2) have many
       // ambiguous entries, but they're all the same set of actions;
-      // were we to not consolidate like this, the 6-bit cell encoding
-      // would not be enough.
+      // consolidating them keeps the indices small.
 
       // # of big-table entries that will be used
       int encodeLen = set.size()+1;
@@ -326,13 +391,12 @@ ActionEntry ParseTables::encodeAmbig
       appendAmbig(set);
       return makeAE(AE_AMBIGUOUS, end-begin /*delta*/);
     }
-
-  #else
-    (void)inWhatState;
+  }
+  else {
     int end = temp->ambigTable.size();
     appendAmbig(set);
     return validateAction(numStates+end+1);
-  #endif
+  }
 }
 
 
@@ -356,6 +420,7 @@ bool ParseTables::compareAmbig(sm::stack<ActionEntry> const &set,
     if (temp->ambigTable[startIndex+1+j] != *e) {
       return false;         // mismatch in j+2nd entry
     }
+    j++;
   }
   return true;              // match!
 }
@@ -363,24 +428,21 @@ bool ParseTables::compareAmbig(sm::stack<ActionEntry> const &set,
 
 ActionEntry ParseTables::encodeError() const
 {
-  #if ENABLE_CRS_COMPRESSION
-    return makeAE(AE_ERROR, 0);
-  #else
-    return validateAction(0);
-  #endif
+  // the same in both encodings
+  return validateAction(errorActionEntry);
 }
 
 
 GotoEntry ParseTables::encodeGoto(StateId destState, int shiftedNontermId) const
 {
-  #if ENABLE_CRS_COMPRESSION
+  if (crs_enabled()) {
     xassert(0 <= shiftedNontermId && shiftedNontermId < numNonterms);
     int delta = destState - firstWithNonterminal[shiftedNontermId];
     return validateGoto(delta);
-  #else
-    (void)shiftedNontermId;
+  }
+  else {
     return validateGoto(destState);
-  #endif
+  }
 }
 
 
@@ -411,10 +473,14 @@ void copyIndexPtrArray(int len, T **&dest, T *base, std::vector<int> const &src)
 
 void ParseTables::finishTables()
 {
+  if (!temp) {
+    return;      // already finished, or loaded by 'loadBinary'
+  }
+
   // copy the ambiguous actions
   copyArray(ambigTableSize, ambigTable, temp->ambigTable);
 
-  if (ENABLE_CRS_COMPRESSION) {
+  if (crs_enabled()) {
     // transfer bigProductionList
     copyArray(bigProductionListSize, bigProductionList, temp->bigProductionList);
 
@@ -429,10 +495,87 @@ void ParseTables::finishTables()
 
   delete temp;
   temp = NULL;
+
+  checksum = computeChecksum();
+}
+
+
+uint32_t ParseTables::computeChecksum() const
+{
+  // the entries as the parser looks them up, so the row sharing and
+  // packing of the compressed layouts count too; the layout itself
+  // goes first, since it decides what the entries mean
+  std::vector<unsigned char> data;
+  auto put = [&](auto value) {
+    unsigned char const *p = (unsigned char const*)&value;
+    data.insert(data.end(), p, p + sizeof(value));
+  };
+
+  put((int32_t)layout());
+  for (int s=0; s < numStates; s++) {
+    for (int t=0; t < numTerms; t++) {
+      put(getActionEntry((StateId)s, t));
+    }
+    for (int nt=0; nt < numNonterms; nt++) {
+      put(getGotoEntry((StateId)s, nt));
+    }
+  }
+
+  // field by field, to leave out the padding
+  for (int p=0; p < numProds; p++) {
+    put(prodInfo[p].rhsLen);
+    put(prodInfo[p].lhsIndex);
+  }
+
+  for (int i=0; i < ambigTableSize; i++) {
+    put(ambigTable[i]);
+  }
+
+  return crc32(data.data(), data.size());
+}
+
+
+int ParseTables::computeLayout() const
+{
+  return (eef_enabled()? TL_EEF : 0) | (gcs_enabled()? TL_GCS : 0) |
+         (gcsc_enabled()? TL_GCSC : 0) | (crs_enabled()? TL_CRS : 0) |
+         (rds_enabled()? TL_RDS : 0);
 }
 
 
 // -------------------- table compression --------------------
+void ParseTables::compress(int layout)
+{
+  // see TableLayout
+  xassert(!(layout & TL_GCS) || (layout & TL_EEF));
+  xassert(!(layout & TL_GCSC) || (layout & TL_GCS));
+  xassert(!((layout & TL_GCS) && (layout & TL_RDS)));
+
+  if (layout & TL_EEF) {
+    computeErrorBits();
+  }
+
+  if (layout & TL_GCS) {
+    if (layout & TL_GCSC) {
+      mergeActionColumns();
+    }
+    mergeActionRows();
+
+    if (layout & TL_GCSC) {
+      mergeGotoColumns();
+    }
+    mergeGotoRows();
+  }
+
+  if (layout & TL_RDS) {
+    displaceActionRows();
+    displaceGotoRows();
+  }
+
+  tableLayout = computeLayout();
+}
+
+
 void ParseTables::computeErrorBits()
 {
   traceProgress() << "computing errorBits[]\n";
@@ -928,6 +1071,133 @@ void ParseTables::mergeGotoRows()
 }
 
 
+// Pack the 'rows' by 'cols' 'table' into one vector by row
+// displacement, regarding 'empty' entries as insignificant, and make
+// 'rowBase' and 'check' for it; 'table' becomes the packed vector, as
+// a single row.  This is the "first fit decreasing" method of Tarjan
+// and Yao (Storing a Sparse Table, CACM 22, 11 (1979) 606-611): the
+// rows are placed densest first, each at the lowest offset where its
+// significant entries land only on free cells.  Unlike the graph
+// coloring above, it never compares rows with each other, so it stays
+// fast on big grammars.
+template <class EltType>
+void ParseTables::displaceRows(EltType *&table, int &rows, int &cols,
+                               EltType empty, int *&rowBase,
+                               CheckEntry *&check, char const *name)
+{
+  traceProgress() << "displacing " << name << " rows\n";
+
+  // for now I assume the table is neither displaced nor merged
+  xassert(!rowBase && rows == numStates);
+
+  // the check vector has to be able to name every state
+  if (numStates >= emptyCheckEntry) {
+    xfailure("{} states are too many for RDS compression", numStates);
+  }
+
+  // columns of the significant entries of each row
+  std::vector<std::vector<int>> significant(rows);
+  for (int s=0; s < rows; s++) {
+    for (int c=0; c < cols; c++) {
+      if (table[s*cols + c] != empty) {
+        significant[s].push_back(c);
+      }
+    }
+  }
+
+  // densest first; ties are broken by state, so the result only
+  // depends on the table
+  std::vector<int> order(rows);
+  for (int s=0; s < rows; s++) {
+    order[s] = s;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return significant[a].size() > significant[b].size();
+  });
+
+  std::vector<int> base(rows, 0);
+  std::vector<bool> used;         // cell -> holds a significant entry
+  int firstFree = 0;              // all cells below this are used
+  int length = cols;              // every lookup stays below this
+  for (int s : order) {
+    std::vector<int> const &sig = significant[s];
+    if (sig.empty()) {
+      continue;                   // lookups miss wherever it goes
+    }
+
+    // the row's first entry can't go below 'firstFree'; from there,
+    // find the first offset at which none of its entries collide
+    int b = std::max(0, firstFree - sig.front());
+    for (;; b++) {
+      bool fits = true;
+      for (int c : sig) {
+        if (b+c < (int)used.size() && used[b+c]) {
+          fits = false;
+          break;
+        }
+      }
+      if (fits) {
+        break;
+      }
+    }
+
+    base[s] = b;
+    if ((int)used.size() < b + sig.back() + 1) {
+      used.resize(b + sig.back() + 1, false);
+    }
+    for (int c : sig) {
+      used[b+c] = true;
+    }
+    while (firstFree < (int)used.size() && used[firstFree]) {
+      firstFree++;
+    }
+    length = std::max(length, b + cols);
+  }
+
+  // build the packed vector and its check vector
+  EltType *newTable;
+  allocInitArray(newTable, length, empty);
+  allocInitArray(check, length, emptyCheckEntry);
+  rowBase = new int[rows];
+  for (int s=0; s < rows; s++) {
+    rowBase[s] = base[s];
+    for (int c : significant[s]) {
+      int i = base[s] + c;
+      xassert(check[i] == emptyCheckEntry);    // otherwise placement screwed up
+      newTable[i] = table[s*cols + c];
+      checkAssign(check[i], s);
+    }
+  }
+
+  trace("compression")
+    << name << " table: from " << (rows * cols * sizeof(EltType))
+    << " down to " << (length * (sizeof(EltType) + sizeof(CheckEntry)) +
+                       rows * sizeof(int))
+    << " bytes; " << (length - firstFree) << " of " << length
+    << " cells are above the first free one\n";
+
+  // replace the existing table with the packed one
+  delete[] table;
+  table = newTable;
+  rows = 1;
+  cols = length;
+}
+
+
+void ParseTables::displaceActionRows()
+{
+  displaceRows(actionTable, actionRows, actionCols, errorActionEntry,
+               actionRowBase, actionCheck, "action");
+}
+
+
+void ParseTables::displaceGotoRows()
+{
+  displaceRows(gotoTable, gotoRows, gotoCols, encodeGotoError(),
+               gotoRowBase, gotoCheck, "goto");
+}
+
+
 int ParseTables::colorTheGraph(int *color, Bit2d &graph)
 {
   int n = graph.Size().x;  // same as y
@@ -1070,9 +1340,7 @@ void emitTable(EmitCode &out, EltType const *table, int size, int rowLength,
     return;
   }
 
-  bool printHex = typeName == "ErrorBitsEntry" ||
-                  (ENABLE_CRS_COMPRESSION && typeName == "ActionEntry") ||
-                  (ENABLE_CRS_COMPRESSION && typeName == "GotoEntry") ;
+  bool printHex = typeName == "ErrorBitsEntry";
   bool needCast = typeName == "StateId";
 
   if (size * sizeof(*table) > 50) {    // suppress small ones
@@ -1245,6 +1513,8 @@ void ParseTables::emitConstructionCode(EmitCode &out,
   SET_VAR(numNonterms);
   SET_VAR(numStates);
   SET_VAR(numProds);
+  out << "  checksum = " << checksum << "u;\n";
+  SET_VAR(tableLayout);
   SET_VAR(actionCols);
   SET_VAR(actionRows);
   SET_VAR(gotoCols);
@@ -1258,12 +1528,15 @@ void ParseTables::emitConstructionCode(EmitCode &out,
   #undef SET_VAR
   out << "\n";
 
-  // action table, one row per state
-  emitTable2(out, actionTable, actionTableSize(), actionCols,
+  // action table, one row per state (or, with RDS, the packed
+  // vector, broken into lines as wide as a row would be)
+  emitTable2(out, actionTable, actionTableSize(),
+             rds_enabled()? numTerms : actionCols,
              "ActionEntry", "actionTable");
 
   // goto table, one row per state
-  emitTable2(out, gotoTable, gotoTableSize(), gotoCols,
+  emitTable2(out, gotoTable, gotoTableSize(),
+             rds_enabled()? numNonterms : gotoCols,
              "GotoEntry", "gotoTable");
 
   // production info, arbitrarily 16 per row
@@ -1302,7 +1575,15 @@ void ParseTables::emitConstructionCode(EmitCode &out,
   emitOffsetTable(out, gotoRowPointers, gotoTable, numStates,
                   "GotoEntry*", "gotoRowPointers", "gotoTable");
 
-  if (ENABLE_CRS_COMPRESSION) {
+  // RDS row offsets and check vectors
+  emitTable2(out, actionRowBase, numStates, 16, "int", "actionRowBase");
+  emitTable2(out, actionCheck, actionTableSize(), numTerms,
+             "CheckEntry", "actionCheck");
+  emitTable2(out, gotoRowBase, numStates, 16, "int", "gotoRowBase");
+  emitTable2(out, gotoCheck, gotoTableSize(), numNonterms,
+             "CheckEntry", "gotoCheck");
+
+  if (crs_enabled()) {
     emitTable2(out, firstWithTerminal, numTerms, 16,
                "StateId", "firstWithTerminal");
 
@@ -1339,4 +1620,356 @@ void ParseTables::emitConstructionCode(EmitCode &out,
 }
 
 
+// --------------------- binary table files -------------------
+// A tables file is a BinaryTablesHeader followed by the arrays, each
+// at an 8-byte aligned offset from the start of the file, so the file
+// works wherever it is mapped.  The arrays are stored just as they are
+// in memory, except that the arrays of row pointers are stored as
+// element offsets from the start of the array they point into (-1
+// for NULL), like emitOffsetTable does.  Since the entries are stored
+// raw, the header records the byte order and the entry sizes, and
+// loadBinary refuses files where those differ.
+
+// bump this whenever the layout of the file or of any table changes
+enum { BINARY_TABLES_VERSION = 3 };
+
+static char const binaryTablesMagic[8] = { 'e','l','k','t','a','b','l','e' };
+
+enum BinarySection {
+  BS_ACTION_TABLE,
+  BS_GOTO_TABLE,
+  BS_PROD_INFO,
+  BS_STATE_SYMBOL,
+  BS_AMBIG_TABLE,
+  BS_NONTERM_ORDER,
+  BS_ERROR_BITS,
+  BS_ERROR_BITS_POINTERS,
+  BS_ACTION_INDEX_MAP,
+  BS_ACTION_ROW_POINTERS,
+  BS_GOTO_INDEX_MAP,
+  BS_GOTO_ROW_POINTERS,
+  BS_FIRST_WITH_TERMINAL,
+  BS_FIRST_WITH_NONTERMINAL,
+  BS_BIG_PRODUCTION_LIST,
+  BS_PRODUCTIONS_FOR_STATE,
+  BS_AMBIG_STATE_TABLE,
+  BS_ACTION_ROW_BASE,
+  BS_ACTION_CHECK,
+  BS_GOTO_ROW_BASE,
+  BS_GOTO_CHECK,
+  NUM_BINARY_SECTIONS
+};
+
+struct BinaryTablesHeader {
+  char magic[8];                   // binaryTablesMagic
+  uint32_t version;                // BINARY_TABLES_VERSION
+  uint32_t byteOrder;              // 0x01020304, as the writer stores it
+  uint32_t typeSizes;              // binaryTypeSizes()
+  uint32_t compression;            // layout()
+
+  // the scalar members of ParseTables
+  int32_t numTerms, numNonterms, numStates, numProds;
+  int32_t actionCols, actionRows, gotoCols, gotoRows;
+  int32_t ambigTableSize, bigProductionListSize;
+  int32_t errorBitsRowSize, uniqueErrorRows;
+  int32_t startState, finalProductionIndex;
+  uint32_t checksum;
+
+  // file offset and size in bytes of each array; both are 0 for an
+  // array that is NULL
+  uint32_t sections[NUM_BINARY_SECTIONS][2];
+};
+
+
+// sizes of the table entry types, one per nibble
+static uint32_t binaryTypeSizes()
+{
+  return sizeof(ActionEntry)
+       | sizeof(GotoEntry) << 4
+       | sizeof(ParseTables::ProdInfo) << 8
+       | sizeof(StateId) << 12
+       | sizeof(SymbolId) << 16
+       | sizeof(TermIndex) << 20
+       | sizeof(NtIndex) << 24
+       | sizeof(ProdIndex) << 28;
+}
+
+void ParseTables::writeBinary(char const *fname) const
+{
+  // must have already called 'finishTables'
+  xassert(!temp);
+
+  BinaryTablesHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, binaryTablesMagic, sizeof(hdr.magic));
+  hdr.version = BINARY_TABLES_VERSION;
+  hdr.byteOrder = 0x01020304;
+  hdr.typeSizes = binaryTypeSizes();
+  hdr.compression = layout();
+
+  #define SET_VAR(var) hdr.var = var;
+  SET_VAR(numTerms);
+  SET_VAR(numNonterms);
+  SET_VAR(numStates);
+  SET_VAR(numProds);
+  SET_VAR(actionCols);
+  SET_VAR(actionRows);
+  SET_VAR(gotoCols);
+  SET_VAR(gotoRows);
+  SET_VAR(ambigTableSize);
+  SET_VAR(bigProductionListSize);
+  SET_VAR(errorBitsRowSize);
+  SET_VAR(uniqueErrorRows);
+  SET_VAR(startState);
+  SET_VAR(finalProductionIndex);
+  SET_VAR(checksum);
+  #undef SET_VAR
+
+  // build the whole file in memory; the header goes in last, once
+  // the section offsets are known
+  std::vector<char> image(sizeof(hdr));
+
+  // append 'size' elements at 'table' as section 'sec'
+  auto putTable = [&](BinarySection sec, auto const *table, int size) {
+    if (!table || size <= 0) {
+      return;
+    }
+    image.resize((image.size() + 7) & ~(size_t)7, 0);
+    char const *data = (char const*)table;
+    size_t bytes = size * sizeof(*table);
+    hdr.sections[sec][0] = image.size();
+    hdr.sections[sec][1] = bytes;
+    image.insert(image.end(), data, data + bytes);
+  };
+
+  // append the 'numStates' pointers at 'table' as offsets from 'base'
+  auto putPointers = [&](BinarySection sec, auto const *table, auto const *base) {
+    if (!table) {
+      return;
+    }
+    std::vector<int32_t> offsets(numStates, UNASSIGNED);
+    for (int i=0; i < numStates; i++) {
+      if (table[i]) {
+        offsets[i] = table[i] - base;
+      }
+    }
+    putTable(sec, offsets.data(), numStates);
+  };
+
+  putTable(BS_ACTION_TABLE, actionTable, actionTableSize());
+  putTable(BS_GOTO_TABLE, gotoTable, gotoTableSize());
+  putTable(BS_PROD_INFO, prodInfo, numProds);
+  putTable(BS_STATE_SYMBOL, stateSymbol, numStates);
+  putTable(BS_AMBIG_TABLE, ambigTable, ambigTableSize);
+  putTable(BS_NONTERM_ORDER, nontermOrder, nontermOrderSize());
+  putTable(BS_ERROR_BITS, errorBits, uniqueErrorRows * errorBitsRowSize);
+  putPointers(BS_ERROR_BITS_POINTERS, errorBitsPointers, errorBits);
+  putTable(BS_ACTION_INDEX_MAP, actionIndexMap, numTerms);
+  putPointers(BS_ACTION_ROW_POINTERS, actionRowPointers, actionTable);
+  putTable(BS_GOTO_INDEX_MAP, gotoIndexMap, numNonterms);
+  putPointers(BS_GOTO_ROW_POINTERS, gotoRowPointers, gotoTable);
+  putTable(BS_FIRST_WITH_TERMINAL, firstWithTerminal, numTerms);
+  putTable(BS_FIRST_WITH_NONTERMINAL, firstWithNonterminal, numNonterms);
+  putTable(BS_BIG_PRODUCTION_LIST, bigProductionList, bigProductionListSize);
+  putPointers(BS_PRODUCTIONS_FOR_STATE, productionsForState, bigProductionList);
+  putPointers(BS_AMBIG_STATE_TABLE, ambigStateTable, ambigTable);
+  putTable(BS_ACTION_ROW_BASE, actionRowBase, numStates);
+  putTable(BS_ACTION_CHECK, actionCheck, actionTableSize());
+  putTable(BS_GOTO_ROW_BASE, gotoRowBase, numStates);
+  putTable(BS_GOTO_CHECK, gotoCheck, gotoTableSize());
+
+  memcpy(image.data(), &hdr, sizeof(hdr));
+
+  AutoFILE fp(fname, "wb");
+  if (fwrite(image.data(), 1, image.size(), fp) != image.size()) {
+    xsyserror("fwrite", fname);
+  }
+}
+
+
+// turn the offsets at 'offsets' (if any) into 'numStates' pointers
+// into 'base', which has 'baseSize' elements
+template <class T>
+static T **mapPointers(int32_t const *offsets, int numStates,
+                       T *base, int baseSize, char const *fname)
+{
+  if (!offsets) {
+    return NULL;
+  }
+
+  T **ret = new T* [numStates];
+  for (int i=0; i < numStates; i++) {
+    if (offsets[i] == UNASSIGNED) {
+      ret[i] = NULL;
+    }
+    else if (base && 0 <= offsets[i] && offsets[i] < baseSize) {
+      ret[i] = base + offsets[i];
+    }
+    else {
+      delete[] ret;
+      xformat(fmt::format("{}: bad row offset in parse tables", fname));
+    }
+  }
+  return ret;
+}
+
+
+STATICDEF ParseTables *ParseTables::loadBinary(char const *fname)
+{
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    throw_XOpenEx(fname, "r", strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    xsyserror("fstat", fname);
+  }
+  size_t size = st.st_size;
+  if (size < sizeof(BinaryTablesHeader)) {
+    close(fd);
+    xformat(fmt::format("{}: not a parse tables file", fname));
+  }
+
+  // shared and read-only, so every process using the file uses the
+  // same pages
+  void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    xsyserror("mmap", fname);
+  }
+
+  // from here on, 'ret' unmaps the file if anything goes wrong
+  std::unique_ptr<ParseTables> ret(new ParseTables(false /*owning*/));
+  ret->mapping = base;
+  ret->mappingSize = size;
+
+  BinaryTablesHeader const &hdr = *(BinaryTablesHeader const*)base;
+  if (0!=memcmp(hdr.magic, binaryTablesMagic, sizeof(hdr.magic))) {
+    xformat(fmt::format("{}: not a parse tables file", fname));
+  }
+  if (hdr.version != BINARY_TABLES_VERSION) {
+    xformat(fmt::format("{}: parse tables file version is {}, but this "
+                        "program reads version {}",
+                        fname, hdr.version, (int)BINARY_TABLES_VERSION));
+  }
+  if (hdr.byteOrder != 0x01020304 || hdr.typeSizes != binaryTypeSizes()) {
+    xformat(fmt::format("{}: parse tables were written with a different "
+                        "byte order or table entry types", fname));
+  }
+
+  #define GET_VAR(var) ret->var = hdr.var;
+  GET_VAR(numTerms);
+  GET_VAR(numNonterms);
+  GET_VAR(numStates);
+  GET_VAR(numProds);
+  GET_VAR(actionCols);
+  GET_VAR(actionRows);
+  GET_VAR(gotoCols);
+  GET_VAR(gotoRows);
+  GET_VAR(ambigTableSize);
+  GET_VAR(bigProductionListSize);
+  GET_VAR(errorBitsRowSize);
+  GET_VAR(uniqueErrorRows);
+  GET_VAR(finalProductionIndex);
+  GET_VAR(checksum);
+  #undef GET_VAR
+  ret->startState = (StateId)hdr.startState;
+
+  // point 'table' at section 'sec', which must be absent or hold
+  // exactly 'count' elements
+  auto getTable = [&](BinarySection sec, auto *&table, long count) {
+    uint32_t ofs = hdr.sections[sec][0];
+    uint32_t bytes = hdr.sections[sec][1];
+    if (bytes == 0) {
+      table = NULL;
+      return;
+    }
+    if (ofs % 8 != 0 || ofs > size || bytes > size - ofs ||
+        count < 0 || bytes != count * sizeof(*table)) {
+      xformat(fmt::format("{}: bad parse tables section {}", fname, (int)sec));
+    }
+    table = (std::remove_reference_t<decltype(table)>)((char*)base + ofs);
+  };
+
+  int32_t *offsets;    // row pointer sections
+  getTable(BS_ACTION_TABLE, ret->actionTable, ret->actionTableSize());
+  getTable(BS_GOTO_TABLE, ret->gotoTable, ret->gotoTableSize());
+  getTable(BS_PROD_INFO, ret->prodInfo, ret->numProds);
+  getTable(BS_STATE_SYMBOL, ret->stateSymbol, ret->numStates);
+  getTable(BS_AMBIG_TABLE, ret->ambigTable, ret->ambigTableSize);
+  getTable(BS_NONTERM_ORDER, ret->nontermOrder, ret->nontermOrderSize());
+  getTable(BS_ERROR_BITS, ret->errorBits,
+           (long)ret->uniqueErrorRows * ret->errorBitsRowSize);
+  getTable(BS_ERROR_BITS_POINTERS, offsets, ret->numStates);
+  ret->errorBitsPointers = mapPointers(offsets, ret->numStates, ret->errorBits,
+    ret->uniqueErrorRows * ret->errorBitsRowSize, fname);
+  getTable(BS_ACTION_INDEX_MAP, ret->actionIndexMap, ret->numTerms);
+  getTable(BS_ACTION_ROW_POINTERS, offsets, ret->numStates);
+  ret->actionRowPointers = mapPointers(offsets, ret->numStates, ret->actionTable,
+    ret->actionTableSize(), fname);
+  getTable(BS_GOTO_INDEX_MAP, ret->gotoIndexMap, ret->numNonterms);
+  getTable(BS_GOTO_ROW_POINTERS, offsets, ret->numStates);
+  ret->gotoRowPointers = mapPointers(offsets, ret->numStates, ret->gotoTable,
+    ret->gotoTableSize(), fname);
+  getTable(BS_FIRST_WITH_TERMINAL, ret->firstWithTerminal, ret->numTerms);
+  getTable(BS_FIRST_WITH_NONTERMINAL, ret->firstWithNonterminal, ret->numNonterms);
+  getTable(BS_BIG_PRODUCTION_LIST, ret->bigProductionList,
+           ret->bigProductionListSize);
+  getTable(BS_PRODUCTIONS_FOR_STATE, offsets, ret->numStates);
+  ret->productionsForState = mapPointers(offsets, ret->numStates,
+    ret->bigProductionList, ret->bigProductionListSize, fname);
+  getTable(BS_AMBIG_STATE_TABLE, offsets, ret->numStates);
+  ret->ambigStateTable = mapPointers(offsets, ret->numStates, ret->ambigTable,
+    ret->ambigTableSize, fname);
+  getTable(BS_ACTION_ROW_BASE, ret->actionRowBase, ret->numStates);
+  getTable(BS_ACTION_CHECK, ret->actionCheck, ret->actionTableSize());
+  getTable(BS_GOTO_ROW_BASE, ret->gotoRowBase, ret->numStates);
+  getTable(BS_GOTO_CHECK, ret->gotoCheck, ret->gotoTableSize());
+
+  // the layout decides which tables the lookups use, so each one
+  // must have all of its tables, and be a combination the lookups
+  // know (see TableLayout)
+  ret->tableLayout = ret->computeLayout();
+  int layout = ret->layout();
+  if (hdr.compression != (uint32_t)layout ||
+      !ret->errorBits != !ret->errorBitsPointers ||
+      !ret->actionRowPointers != !ret->gotoRowPointers ||
+      !ret->actionIndexMap != !ret->gotoIndexMap ||
+      !ret->firstWithTerminal != !ret->firstWithNonterminal ||
+      !ret->firstWithTerminal != !ret->productionsForState ||
+      !ret->firstWithTerminal != !ret->ambigStateTable ||
+      !ret->actionRowBase != !ret->actionCheck ||
+      !ret->gotoRowBase != !ret->gotoCheck ||
+      !ret->actionRowBase != !ret->gotoRowBase) {
+    xformat(fmt::format("{}: parse tables file is missing tables", fname));
+  }
+  if (((layout & TL_GCS) && !(layout & TL_EEF)) ||
+      ((layout & TL_GCSC) && !(layout & TL_GCS)) ||
+      ((layout & TL_GCS) && (layout & TL_RDS))) {
+    xformat(fmt::format("{}: parse tables have an unknown compression "
+                        "layout {:#x}", fname, layout));
+  }
+
+  // every RDS lookup must stay inside the packed vectors
+  for (int s=0; ret->actionRowBase && s < ret->numStates; s++) {
+    if (ret->actionRowBase[s] < 0 ||
+        ret->actionRowBase[s] > ret->actionTableSize() - ret->numTerms ||
+        ret->gotoRowBase[s] < 0 ||
+        ret->gotoRowBase[s] > ret->gotoTableSize() - ret->numNonterms) {
+      xformat(fmt::format("{}: bad row offset in parse tables", fname));
+    }
+  }
+
+  // the arrays every ParseTables has
+  if (!ret->actionTable || !ret->gotoTable || !ret->prodInfo ||
+      !ret->stateSymbol || !ret->nontermOrder) {
+    xformat(fmt::format("{}: parse tables file is missing tables", fname));
+  }
+
+  return ret.release();
+}
+
+
 // EOF
@@ -5,13 +5,15 @@
 #ifndef PARSETABLES_H
 #define PARSETABLES_H
 
-#include "glrconfig.h"    // compression options
+#include "glrconfig.h"    // checks for the retired compression options
 #include "str.h"          // string
 #include "stack.h"        // sm::stack
 #include "xassert.h"      // xassert
 
 #include <iostream>       // std::ostream
 #include <vector>         // std::vector
+#include <stddef.h>       // size_t
+#include <stdint.h>       // uint32_t
 
 class Flatten;            // flatten.h
 class EmitCode;           // emitcode.h
@@ -28,55 +30,66 @@ inline std::ostream& operator<< (std::ostream &os, StateId id)
 
 
 // encodes an action in 'action' table; see 'actionTable'
-#if ENABLE_CRS_COMPRESSION
-  // high bits encoding
-  enum ActionEntryKind {
-    AE_MASK      = 0xC0,    // selection mask
-    AE_SHIFT     = 0x00,    // 00 = shift
-    AE_REDUCE    = 0x40,    // 01 = reduce
-    AE_AMBIGUOUS = 0x80,    // 10 = ambiguous
-    AE_ERROR     = 0xC0,    // 11 = error (if EEF is off)
-    AE_MAXINDEX  = 63       // maximum value of lower bits
-  };
+//
+// Unless the tables use the Code Reduction Scheme (CRS, see below),
+// each entry is one of:
+//   +N+1, 0 <= N < numStates:         shift, and go to state N
+//   -N-1, 0 <= N < numProds:          reduce using production N
+//   numStates+N+1, 0 <= N < numAmbig: ambiguous, use ambigAction N
+//   0:                                error
+// (there is no 'accept', acceptance is handled outside this table)
+typedef signed short ActionEntry;
+#define errorActionEntry ((ActionEntry)0)
+
+// With CRS, the high two bits of an entry say what it is, and the
+// other 14 are an index whose meaning depends on the kind:
+//
+//   shift: destination state, encoded as an offset from the
+//   first state that that terminal can reach
+//
+//   reduce: production, encoded as an index into a per-state
+//   array of distinct production indices
+//
+//   ambiguous: for each state, have an array of ActionEntries.
+//   ambiguous entries index into this array.  first indexed
+//   entry is the count of how many actions follow
+//
+// Error is 0 in both encodings, so the tables start out all errors
+// and the compression schemes need not know the encoding.
+enum ActionEntryKind {
+  AE_MASK      = 0xC000,  // selection mask
+  AE_ERROR     = 0x0000,  // 00 = error (if EEF is off; index is 0)
+  AE_SHIFT     = 0x4000,  // 01 = shift
+  AE_REDUCE    = 0x8000,  // 10 = reduce
+  AE_AMBIGUOUS = 0xC000,  // 11 = ambiguous
+  AE_MAXINDEX  = 0x3FFF   // maximum value of lower bits
+};
+ActionEntry makeAE(ActionEntryKind k, int index);
 
-  // remaining 6 bits:
-  //
-  //   shift: desination state, encoded as an offset from the
-  //   first state that that terminal can reach
-  //
-  //   reduce: production, encoded as an index into a per-state
-  //   array of distinct production indices
-  //
-  //   ambiguous: for each state, have an array of ActionEntries.
-  //   ambiguous entries index into this array.  first indexed
-  //   entry is the count of how many actions follow
-  typedef unsigned char ActionEntry;
-  ActionEntry makeAE(ActionEntryKind k, int index);
-  #define errorActionEntry ((ActionEntry)AE_ERROR)
-#else
-  // each entry is one of:
-  //   +N+1, 0 <= N < numStates:         shift, and go to state N
-  //   -N-1, 0 <= N < numProds:          reduce using production N
-  //   numStates+N+1, 0 <= N < numAmbig: ambiguous, use ambigAction N
-  //   0:                                error
-  // (there is no 'accept', acceptance is handled outside this table)
-  typedef signed short ActionEntry;
-  #define errorActionEntry ((ActionEntry)0)
-#endif
-
-
-// encodes a destination state in 'gotoTable'
-#if ENABLE_CRS_COMPRESSION
-  // entry is an offset from the first state that can be reached
-  // by shifting the nonterminal
-  typedef unsigned char GotoEntry;
-#else
-  // entry is the to go to after shifting the nonterminal
-  typedef unsigned short GotoEntry;
-#endif
+
+// encodes a destination state in 'gotoTable': the state to go to
+// after shifting the nonterminal, or with CRS, its offset from the
+// first state that can be reached by shifting the nonterminal
+typedef unsigned short GotoEntry;
 #define errorGotoEntry ((GotoEntry)~0)
 
 
+// the compression and encoding a ParseTables was made with, as bits
+// (see "table compression" in ParseTables); code that reads the tables
+// in its inner loop takes the layout as a template argument, and is
+// instantiated once per layout.  GCS needs EEF, GCSC needs GCS, and
+// RDS can't be combined with GCS.
+enum TableLayout {
+  TL_EEF  = 0x01,       // Error Entry Factoring
+  TL_GCS  = 0x02,       // Graph Coloring Scheme, rows
+  TL_GCSC = 0x04,       // Graph Coloring Scheme, columns too
+  TL_CRS  = 0x08,       // Code Reduction Scheme entry encoding
+  TL_RDS  = 0x10,       // Row Displacement Scheme
+
+  TL_DYNAMIC = -1       // not known at compile time: ask the tables
+};
+
+
 // name a terminal using an index
 typedef unsigned char TermIndex;
 
@@ -89,6 +102,11 @@ typedef unsigned short ProdIndex;
 // an addressed cell in the 'errorBits' table
 typedef unsigned char ErrorBitsEntry;
 
+// a cell in the RDS check vectors: the state whose entry the cell
+// holds, or 'emptyCheckEntry'
+typedef unsigned short CheckEntry;
+#define emptyCheckEntry ((CheckEntry)~0)
+
 
 // encodes either terminal index N (as N+1) or
 // nonterminal index N (as -N-1), or 0 for no-symbol
@@ -153,6 +171,11 @@ protected:  // data
   // non-NULL during construction
   TempData *temp;                        // (nullable owner)
 
+  // when the tables were made by 'loadBinary', the mapped file,
+  // which the tables point into
+  void *mapping;                         // (nullable owner)
+  size_t mappingSize;
+
   // # terminals, nonterminals in grammar
   int numTerms;
   int numNonterms;
@@ -163,6 +186,17 @@ protected:  // data
   // # of productions in the grammar
   int numProds;
 
+  // crc32 of what the action, goto, production info and ambiguous
+  // action tables hold, as 'finishTables' found them; code made for
+  // one set of tables (the directly-coded parser) checks this to
+  // tell whether it is being used with those tables
+  uint32_t checksum;
+
+  // computeLayout(), kept here so the TL_DYNAMIC lookups test one
+  // int rather than five pointers; whatever changes which tables are
+  // present updates it
+  int tableLayout;
+
   // action table, indexed by (state*actionCols + lookahead)
   int actionCols;
   ActionEntry *actionTable;              // (owner*)
@@ -212,6 +246,10 @@ protected:  // data
 
   // Code Reduction Scheme (CRS):
   //
+  // The tables use CRS when they are made with 'crs' true (elkhound
+  // -crs); then the entries are encoded as described at ActionEntry,
+  // and these arrays are not NULL.
+  //
   // Part (a):  The states are numbered such that all states that
   // are reached by transitions on a given symbol are contiguous.
   // See gramanl.cc, GrammarAnalysis::renumberStates().  Then, we
@@ -269,6 +307,21 @@ protected:  // data
   int gotoRows;
   GotoEntry **gotoRowPointers;           // (nullable owner ptr to serfs)
 
+  // Row Displacement Scheme (RDS):
+  //
+  // Overlay all the rows of the action table in one vector, each row
+  // shifted ("displaced") so that its significant entries fall on
+  // cells that no other row uses, and record in a parallel check
+  // vector which state each cell belongs to.  A lookup is then
+  //   i = actionRowBase[state] + lookahead;
+  //   actionCheck[i] == state? actionTable[i] : error
+  // The goto table is packed the same way.  Once packed, 'actionTable'
+  // and 'gotoTable' are the packed vectors, as one row each.
+  int *actionRowBase;                    // (nullable owner*) state -> offset in actionTable
+  CheckEntry *actionCheck;               // (nullable owner*) parallel to actionTable
+  int *gotoRowBase;                      // (nullable owner*) state -> offset in gotoTable
+  CheckEntry *gotoCheck;                 // (nullable owner*) parallel to gotoTable
+
 public:     // data
   // These are public because if they weren't, I'd just have a stupid
   // getter/setter pattern that exposes them anyway.
@@ -282,16 +335,20 @@ public:     // data
 
 private:    // funcs
   void alloc(int numTerms, int numNonterms, int numStates, int numProds,
-             StateId start, int finalProd);
+             StateId start, int finalProd, bool crs);
 
   // index tables
   ActionEntry &actionEntry(StateId stateId, int termId)
     { return actionTable[stateId*actionCols + termId]; }
+  ActionEntry actionEntry(StateId stateId, int termId) const
+    { return actionTable[stateId*actionCols + termId]; }
   int actionTableSize() const
     { return actionRows * actionCols; }
 
   GotoEntry &gotoEntry(StateId stateId, int nontermId)
     { return gotoTable[stateId*gotoCols + nontermId]; }
+  GotoEntry gotoEntry(StateId stateId, int nontermId) const
+    { return gotoTable[stateId*gotoCols + nontermId]; }
   int gotoTableSize() const
     { return gotoRows * gotoCols; }
 
@@ -299,8 +356,14 @@ private:    // funcs
   bool compareAmbig(sm::stack<ActionEntry> const &set, int startIndex);
 
   void fillInErrorBits(bool setPointers);
+  uint32_t computeChecksum() const;
+  int computeLayout() const;
   int colorTheGraph(int *color, Bit2d &graph);
 
+  template <class EltType>
+  void displaceRows(EltType *&table, int &rows, int &cols, EltType empty,
+                    int *&rowBase, CheckEntry *&check, char const *name);
+
 protected:  // funcs
   // the idea is that 'emitConstructionCode' will emit code that
   // defines a subclass of 'ParseTables'; that's why so many of the
@@ -310,8 +373,13 @@ protected:  // funcs
   ParseTables(bool owning);    // only legal when owning==false
 
 public:     // funcs
+  // when 'crs' is true, the entries are encoded with the Code
+  // Reduction Scheme, which needs the states numbered so that those
+  // reached on the same symbol are consecutive (renumberStates does);
+  // the other compression is done after the tables are filled in
+  // (see 'compress')
   ParseTables(int numTerms, int numNonterms, int numStates, int numProds,
-              StateId start, int finalProd);
+              StateId start, int finalProd, bool crs = false);
   ~ParseTables();
 
   // simple queries
@@ -319,8 +387,10 @@ public:     // funcs
   int getNumNonterms() const { return numNonterms; }
   int getNumStates() const { return numStates; }
   int getNumProds() const { return numProds; }
+  uint32_t getChecksum() const { return checksum; }
 
-  // finish construction; do this before emitting code
+  // finish construction, and compute the checksum; do this before
+  // emitting code (calling it again does nothing)
   void finishTables();
 
   // write the tables out as C++ source that can be compiled into
@@ -330,6 +400,16 @@ public:     // funcs
   // this does the same thing for ML, and is implemented in genml.cc
   void emitMLConstructionCode(EmitCode &out, rostring className, rostring funcName);
 
+  // write the finished tables to a file that 'loadBinary' can map
+  void writeBinary(char const *fname) const;
+
+  // map a file written by 'writeBinary' and return tables that use
+  // its pages in place (only the row pointers of the compressed
+  // tables are built); throws XOpen or xSysError if the file can't
+  // be mapped, and xFormat if it isn't a tables file of the current
+  // version with the table types this program was compiled with
+  static ParseTables *loadBinary(char const *fname);
+
 
   // -------------------- table construction ------------------------
   // CRS dest-state origin tables
@@ -375,115 +455,170 @@ public:     // funcs
     return nontermOrder;
   }
 
+  // compress the filled-in tables as the TableLayout bits in
+  // 'layout' say, by calling the compressors below in order (TL_CRS
+  // is ignored here; it's the constructor's 'crs')
+  void compress(int layout);
+
   // table compressors
   void computeErrorBits();
   void mergeActionColumns();
   void mergeActionRows();
   void mergeGotoColumns();
   void mergeGotoRows();
+  void displaceActionRows();
+  void displaceGotoRows();
 
 
   // -------------------- table queries ---------------------------
+  // All of the queries are const: once 'finishTables' has run, the
+  // tables are never written again, so a single ParseTables object
+  // may be shared by any number of GLR parsers, including parsers
+  // running concurrently on different threads.
+
+  // The queries that depend on the layout take it as the template
+  // argument 'L'.  The parser core, nondeterministic parts included,
+  // is instantiated for each layout, so there its lookups compile to
+  // just what the layout needs, with no branches on it; everywhere
+  // else, the default TL_DYNAMIC looks at the tables instead.
+
+  // true if layout 'L' includes 'BIT'
+  template <int L, int BIT>
+  bool uses() const {
+    if constexpr (L == TL_DYNAMIC) {
+      return (layout() & BIT) != 0;
+    }
+    else {
+      return (L & BIT) != 0;
+    }
+  }
+
   // return true if the action is an error
-  bool actionEntryIsError(StateId stateId, int termId) {
-    #if ENABLE_EEF_COMPRESSION
+  template <int L = TL_DYNAMIC>
+  bool actionEntryIsError(StateId stateId, int termId) const {
+    if (uses<L, TL_EEF>()) {
       // check with the error table
       return ( errorBitsPointers[stateId][termId >> 3]
                  >> (termId & 7) ) & 1;
-    #else
-      return isErrorAction(actionEntry(stateId, termId));
-    #endif
+    }
+    else {
+      return isErrorAction(getActionEntry_noError<L>(stateId, termId));
+    }
   }
 
   // query action table, without checking the error bitmap
-  ActionEntry getActionEntry_noError(StateId stateId, int termId) {
-    #if ENABLE_GCS_COMPRESSION
-      #if ENABLE_GCS_COLUMN_COMPRESSION
-        return actionRowPointers[stateId][actionIndexMap[termId]];
-      #else
-        return actionRowPointers[stateId][termId];
-      #endif
-    #else
+  template <int L = TL_DYNAMIC>
+  ActionEntry getActionEntry_noError(StateId stateId, int termId) const {
+    if (uses<L, TL_GCSC>()) {
+      return actionRowPointers[stateId][actionIndexMap[termId]];
+    }
+    else if (uses<L, TL_GCS>()) {
+      return actionRowPointers[stateId][termId];
+    }
+    else if (uses<L, TL_RDS>()) {
+      // the check picks one of two values, which compiles to a
+      // conditional move rather than a branch
+      int i = actionRowBase[stateId] + termId;
+      return actionCheck[i] == (int)stateId? actionTable[i] : errorActionEntry;
+    }
+    else {
       return actionEntry(stateId, termId);
-    #endif
+    }
   }
 
   // query the action table, yielding an action that might be
   // an error action
-  ActionEntry getActionEntry(StateId stateId, int termId) {
-    #if ENABLE_EEF_COMPRESSION
-      if (actionEntryIsError(stateId, termId)) {
-        return errorActionEntry;
-      }
-    #endif
-
-    return getActionEntry_noError(stateId, termId);
+  template <int L = TL_DYNAMIC>
+  ActionEntry getActionEntry(StateId stateId, int termId) const {
+    if (uses<L, TL_EEF>() && actionEntryIsError<L>(stateId, termId)) {
+      return errorActionEntry;
+    }
+
+    return getActionEntry_noError<L>(stateId, termId);
   }
 
   // decode actions
-  #if !ENABLE_CRS_COMPRESSION
-    bool isShiftAction(ActionEntry code) const
-      { return code > 0 && code <= numStates; }
-    static StateId decodeShift(ActionEntry code, int /*shiftedTerminal*/)
-      { return (StateId)(code-1); }
-    static bool isReduceAction(ActionEntry code)
-      { return code < 0; }
-    static int decodeReduce(ActionEntry code, StateId /*inState*/)
-      { return -(code+1); }
-    static bool isErrorAction(ActionEntry code)
-      { return code == 0; }
-
-    // ambigAction is only other choice; this yields a pointer to
-    // an array of actions, the first of which says how many actions
-    // there are
-    ActionEntry *decodeAmbigAction(ActionEntry code, StateId /*inState*/) const
-      { return ambigTable + (code-1-numStates); }
-
-  #else
-    static bool isShiftAction(ActionEntry code) {
+  template <int L = TL_DYNAMIC>
+  bool isShiftAction(ActionEntry code) const {
+    if (uses<L, TL_CRS>()) {
       return (code & AE_MASK) == AE_SHIFT;
     }
-    StateId decodeShift(ActionEntry code, int shiftedTerminal) {
+    else {
+      return code > 0 && code <= numStates;
+    }
+  }
+  template <int L = TL_DYNAMIC>
+  StateId decodeShift(ActionEntry code, int shiftedTerminal) const {
+    if (uses<L, TL_CRS>()) {
       return (StateId)(firstWithTerminal[shiftedTerminal] + (code & AE_MAXINDEX));
     }
-    static bool isReduceAction(ActionEntry code) {
+    else {
+      return (StateId)(code-1);
+    }
+  }
+  template <int L = TL_DYNAMIC>
+  bool isReduceAction(ActionEntry code) const {
+    if (uses<L, TL_CRS>()) {
       return (code & AE_MASK) == AE_REDUCE;
     }
-    int decodeReduce(ActionEntry code, StateId inState) {
+    else {
+      return code < 0;
+    }
+  }
+  template <int L = TL_DYNAMIC>
+  int decodeReduce(ActionEntry code, StateId inState) const {
+    if (uses<L, TL_CRS>()) {
       return productionsForState[inState][code & AE_MAXINDEX];
     }
-    static bool isErrorAction(ActionEntry code) {
-      return code == AE_ERROR;
+    else {
+      return -(code+1);
     }
-
-    ActionEntry *decodeAmbigAction(ActionEntry code, StateId inState) const {
+  }
+  static bool isErrorAction(ActionEntry code)
+    { return code == errorActionEntry; }
+
+  // ambigAction is only other choice; this yields a pointer to
+  // an array of actions, the first of which says how many actions
+  // there are
+  template <int L = TL_DYNAMIC>
+  ActionEntry const *decodeAmbigAction(ActionEntry code, StateId inState) const {
+    if (uses<L, TL_CRS>()) {
       return ambigStateTable[inState] + (code & AE_MAXINDEX);
     }
-  #endif
+    else {
+      return ambigTable + (code-1-numStates);
+    }
+  }
 
   // decode gotos
-  GotoEntry getGotoEntry(StateId stateId, int nontermId) {
-    #if ENABLE_GCS_COMPRESSION
-      #if ENABLE_GCS_COLUMN_COMPRESSION
-        return gotoRowPointers[stateId][gotoIndexMap[nontermId]];
-      #else
-        return gotoRowPointers[stateId][nontermId];
-      #endif
-    #else
+  template <int L = TL_DYNAMIC>
+  GotoEntry getGotoEntry(StateId stateId, int nontermId) const {
+    if (uses<L, TL_GCSC>()) {
+      return gotoRowPointers[stateId][gotoIndexMap[nontermId]];
+    }
+    else if (uses<L, TL_GCS>()) {
+      return gotoRowPointers[stateId][nontermId];
+    }
+    else if (uses<L, TL_RDS>()) {
+      int i = gotoRowBase[stateId] + nontermId;
+      return gotoCheck[i] == (int)stateId? gotoTable[i] : errorGotoEntry;
+    }
+    else {
       return gotoEntry(stateId, nontermId);
-    #endif
+    }
   }
 
-  bool isErrorGoto(GotoEntry code)
+  bool isErrorGoto(GotoEntry code) const
     { return code == errorGotoEntry; }
 
-  StateId decodeGoto(GotoEntry code, int shiftedNonterminal) {
-    #if ENABLE_CRS_COMPRESSION
+  template <int L = TL_DYNAMIC>
+  StateId decodeGoto(GotoEntry code, int shiftedNonterminal) const {
+    if (uses<L, TL_CRS>()) {
       return (StateId)(firstWithNonterminal[shiftedNonterminal] + code);
-    #else
-      (void)shiftedNonterminal;
+    }
+    else {
       return (StateId)code;
-    #endif
+    }
   }
 
   // nonterminal order
@@ -498,9 +633,7 @@ public:     // funcs
   int getStateSymbol(StateId id) const
     { return stateSymbol[id]; }
 
-  // query compression options based on which fields are not NULL; do
-  // *not* use the compile-time flags, because we're trying to detect
-  // mismatch between compiler flags used at different times
+  // query compression options based on which fields are not NULL
   bool eef_enabled() const
     { return !!errorBits; }
   bool gcs_enabled() const
@@ -509,15 +642,23 @@ public:     // funcs
     { return !!actionIndexMap; }
   bool crs_enabled() const
     { return !!firstWithTerminal; }
+  bool rds_enabled() const
+    { return !!actionRowBase; }
+
+  // all of the above, as TableLayout bits
+  int layout() const
+    { return tableLayout; }
 };
 
 
 // NOTE: At one point (before 7/27/03), I had the ability to read and
 // write parse tables to files, *not* using the C++ compiler to store
 // tables as static data.  I removed it because I wasn't using it, and
-// it was hindering table evolution.  But as the tables stabilize
-// again, if the need arises, one could go get (from CVS) the code
-// that did it and fix it up to work again.
+// it was hindering table evolution.  'writeBinary' and 'loadBinary'
+// bring that back, but as a raw image of the arrays rather than a
+// serialization, so there is nothing to maintain per field beyond
+// the section list in parsetables.cc; bump BINARY_TABLES_VERSION
+// there whenever the representation changes.
 
 
 #endif // PARSETABLES_H
@@ -8,8 +8,8 @@
 
 #include <string.h>         // strchr
 
-int PTreeNode::allocCount = 0;
-int PTreeNode::alternativeCount = 0;
+std::atomic<int> PTreeNode::allocCount(0);
+std::atomic<int> PTreeNode::alternativeCount(0);
 
 
 void PTreeNode::init()
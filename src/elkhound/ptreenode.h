@@ -9,6 +9,7 @@
 #include <stddef.h>     // NULL
 #include <stdint.h>     // uintmax_t
 #include <iostream>     // std::ostream
+#include <atomic>       // std::atomic
 
 typedef uintmax_t TreeCount;
 
@@ -49,11 +50,12 @@ public:    // data
 
   // count of # of allocated nodes; useful for identifying when
   // we're making too many
-  static int allocCount;
+  // (atomic since parses may run on several threads at once)
+  static std::atomic<int> allocCount;
 
   // count # of times addAlternative is called; this will tell
   // the total number of local ambiguities that need to be resolved
-  static int alternativeCount;
+  static std::atomic<int> alternativeCount;
 
 private:     // funcs
   // init fields which don't depend on ctor args
@@ -14,13 +14,18 @@ void trivialLexer(char const *fname, Lexer2 &dest)
   }
   SourceLoc loc = SourceLocManager::instance()->encodeBegin(fname);
 
-  int ch;
-  while ((ch = fgetc(fp)) != EOF) {
-    // abuse Lexer2 to hold chars, add it to list
-    dest.addToken((Lexer2TokenType)ch, loc);
-
-    char aChar = ch;
-    loc = SourceLocManager::instance()->advText(loc, &aChar, 1);
+  // read in blocks rather than a character at a time; the parser
+  // gets the tokens in batches from 'dest' anyway
+  char block[4096];
+  size_t len;
+  while ((len = fread(block, 1, sizeof(block), fp)) > 0) {
+    for (size_t i=0; i < len; i++) {
+      // abuse Lexer2 to hold chars, add it to list
+      dest.addToken((Lexer2TokenType)(unsigned char)block[i], loc);
+      loc = SourceLocManager::instance()->advText(loc, block+i, 1);
+    }
   }
+  fclose(fp);
+
   dest.addEOFToken();
 }
@@ -18,7 +18,8 @@
 #include "exc.h"       // throw_XOpen
 
 #include <string.h>    // strcmp
-#include <stdlib.h>    // exit
+#include <stdlib.h>    // exit, atoi
+#include <chrono>      // std::chrono
 
 // no bison-parser present, so need to define this
 Lexer2Token const *yylval = NULL;
@@ -97,7 +98,7 @@ void entry(int argc, char *argv[])
   TRACE_ARGS();
 
   if (argc < 2) {
-    printf("usage: %s [-tr flags] [-count] input-file\n", progName);
+    printf("usage: %s [-tr flags] [-count] [-bench iters] input-file\n", progName);
     return;
   }
 
@@ -108,6 +109,14 @@ void entry(int argc, char *argv[])
     argc--;
   }
 
+  // parse the input 'benchIters' times, and report the time per parse
+  int benchIters = 0;
+  if (argc >= 3 && 0==strcmp(argv[1], "-bench")) {
+    benchIters = atoi(argv[2]);
+    argv += 2;    // shift
+    argc -= 2;
+  }
+
   char const *inputFname = argv[1];
 
   // see how long the input is
@@ -142,6 +151,25 @@ void entry(int argc, char *argv[])
   // make the parser object
   GLR glr(user, tables);
 
+  if (benchIters > 0) {
+    // one GLR session for all the parses; only the parser is timed
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    for (int i=0; i < benchIters; i++) {
+      lexer.beginReading();
+      SemanticValue treeTop;
+      if (!glr.glrParse(lexer, treeTop)) {
+        exit(2);
+      }
+    }
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    int tokens = lexer.tokens.size();
+    printf("%d tokens, %d parses: %.2f us/parse, %.3f us/token\n",
+           tokens, benchIters, us / benchIters, us / benchIters / tokens);
+    return;
+  }
+
   // parse input
   SemanticValue treeTop;
   if (!glr.glrParse(lexer, treeTop)) {
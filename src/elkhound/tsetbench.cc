@@ -0,0 +1,167 @@
+// tsetbench.cc            see license.txt for copyright and terms of use
+// time TerminalSet on the kind of work grammar analysis does with it,
+// against the byte-at-a-time bitmap it used to be, for growing
+// numbers of terminals; exits nonzero if the two disagree
+
+#include "grammar.h"       // TerminalSet
+#include "test.h"          // ARGS_MAIN
+
+#include <stdio.h>         // printf
+#include <stdlib.h>        // atoi, exit
+#include <string.h>        // memcmp
+#include <chrono>          // std::chrono
+#include <random>          // std::mt19937
+#include <utility>         // std::pair, std::move
+#include <vector>          // std::vector
+
+
+typedef std::chrono::steady_clock Clock;
+
+// the former TerminalSet representation and algorithms
+class ByteSet {
+public:
+  std::vector<unsigned char> bitmap;
+
+public:
+  ByteSet(int numTerms) : bitmap((numTerms + 7) / 8) {}
+
+  bool contains(int id) const
+    { return ((bitmap[(unsigned)id / 8] >> ((unsigned)id % 8)) & 1) == 1; }
+  void add(int id)
+    { bitmap[(unsigned)id / 8] |= (unsigned char)(1 << ((unsigned)id % 8)); }
+  bool isEqual(ByteSet const &obj) const
+    { return 0==memcmp(bitmap.data(), obj.bitmap.data(), bitmap.size()); }
+
+  bool merge(ByteSet const &obj)
+  {
+    bool changed = false;
+    for (size_t i=0; i<bitmap.size(); i++) {
+      unsigned before = bitmap[i];
+      unsigned after = before | obj.bitmap[i];
+      if (after != before) {
+        changed = true;
+        bitmap[i] = after;
+      }
+    }
+    return changed;
+  }
+};
+
+
+// one First/Follow-like problem: 'numSets' sets over 'numTerms'
+// terminals, each seeded with a few terminals, and edges along which
+// sets flow into each other until nothing changes
+struct Problem {
+  int numTerms;
+  std::vector<std::vector<int>> seeds;                // per set
+  std::vector<std::pair<int,int>> edges;              // (dest, src)
+
+  Problem(int terms, int numSets, unsigned seed);
+};
+
+Problem::Problem(int terms, int numSets, unsigned seed)
+  : numTerms(terms), seeds(numSets), edges()
+{
+  std::mt19937 rng(seed);
+  for (auto &s : seeds) {
+    for (int i=0; i < 3; i++) {
+      s.push_back(rng() % terms);
+    }
+  }
+  for (int i=0; i < numSets * 4; i++) {
+    edges.push_back(std::make_pair(rng() % numSets, rng() % numSets));
+  }
+}
+
+
+// solve 'p' with sets of type SET, then probe the results the way the
+// table construction does; returns microseconds, and the solution in
+// 'out' (as one 'contains' result per set and terminal)
+template <class SET>
+double solve(Problem const &p, int iters, std::vector<bool> &out)
+{
+  Clock::time_point start = Clock::now();
+  long probes = 0;
+  for (int it=0; it < iters; it++) {
+    std::vector<SET> sets(p.seeds.size(), SET(p.numTerms));
+    for (size_t s=0; s < sets.size(); s++) {
+      for (int t : p.seeds[s]) {
+        sets[s].add(t);
+      }
+    }
+
+    // iterate to a fixpoint, like computeFollow
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (auto const &e : p.edges) {
+        if (sets[e.first].merge(sets[e.second])) {
+          changed = true;
+        }
+      }
+    }
+
+    // compare neighbours, like the item set lookups, and scan for
+    // members, like the table construction
+    for (size_t s=1; s < sets.size(); s++) {
+      probes += sets[s].isEqual(sets[s-1]);
+    }
+    out.clear();
+    for (SET const &set : sets) {
+      for (int t=0; t < p.numTerms; t++) {
+        out.push_back(set.contains(t));
+      }
+    }
+  }
+  if (probes < 0) {
+    printf("impossible\n");     // keep the comparisons
+  }
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+
+void entry(int argc, char *argv[])
+{
+  int iters = argc >= 2? atoi(argv[1]) : 20;
+  if (iters < 1) {
+    printf("usage: %s [iters]\n", argv[0]);
+    exit(2);
+  }
+
+  printf("%7s %12s %12s %8s\n", "terms", "bytes us", "words us", "speedup");
+  bool ok = true;
+  for (int terms = 64; terms <= 8192; terms *= 4) {
+    Problem p(terms, 400, terms);
+    std::vector<bool> expect, actual;
+    double byteUS = solve<ByteSet>(p, iters, expect);
+    double wordUS = solve<TerminalSet>(p, iters, actual);
+    if (expect != actual) {
+      printf("%d terminals: results differ\n", terms);
+      ok = false;
+    }
+    printf("%7d %12.0f %12.0f %7.1fx\n", terms, byteUS / iters,
+           wordUS / iters, byteUS / wordUS);
+  }
+
+  // the rest of the interface, on a set bigger than the inline words
+  TerminalSet a(300), b(300);
+  a.add(1);
+  a.add(299);
+  b.add(299);
+  b.add(64);
+  TerminalSet c(a);
+  ok = ok && c.mergeExcept(b, a) && c.count() == 3 &&
+       !c.mergeExcept(b, a) && c.removeSet(b) && c.count() == 1 &&
+       c.contains(1) && !c.contains(299);
+  c = std::move(b);
+  ok = ok && c.count() == 2 && c.hash() != a.hash() &&
+       TerminalSet(c).isEqual(c) && TerminalSet(c).hash() == c.hash();
+
+  if (!ok) {
+    printf("tsetbench failed\n");
+    exit(4);
+  }
+}
+
+
+ARGS_MAIN
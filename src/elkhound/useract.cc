@@ -17,6 +17,12 @@ ParseTables *UserActions::makeTables()
 }
 
 
+UserActions::DirectParseFunc UserActions::getDirectParser(ParseTables const *)
+{
+  return NULL;
+}
+
+
 // ----------------- TrivialUserActions --------------------
 UserActions::ReductionActionFunc TrivialUserActions::getReductionAction()
 {
@@ -16,6 +16,8 @@
 #include "srcloc.h"        // SourceLoc
 
 class ParseTables;         // parsetables.h
+class LexerInterface;      // lexerint.h
+class DirectLRStack;       // directlr.h
 
 // user-supplied semantic values:
 //  - Semantic values are an arbitrary word, that the user can then
@@ -132,6 +134,23 @@ public:
   // get the parse tables for this grammar; the default action
   // complains that no tables are defined
   virtual ParseTables *makeTables();
+
+  // directly-coded parser (see directlr.h):
+  //  - it starts in the state atop 'stack', with the current token
+  //    in 'lexer' not yet reclassified, and runs until the parse is
+  //    done or it cannot go on deterministically
+  //  - it returns a DirectParseResult, leaving 'stack' and 'lexer'
+  //    describing where it stopped
+  typedef int (*DirectParseFunc)(
+    UserActions *context,
+    DirectLRStack &stack,
+    LexerInterface &lexer,
+    SemanticValue &treeTop);
+
+  // get the directly-coded parser that works with 'tables', or NULL
+  // if there isn't one; the default has none, and elkhound provides
+  // one when run with -direct
+  virtual DirectParseFunc getDirectParser(ParseTables const *tables);
 };
 
 
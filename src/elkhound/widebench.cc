@@ -0,0 +1,139 @@
+// widebench.cc            see license.txt for copyright and terms of use
+// time the GLR parser per token as the number of simultaneous
+// parsers grows; the grammar comes from scripts/make-wide-grammar
+
+#include "wide.gr.gen.h"   // Wide
+#include "glr.h"           // GLR
+#include "lexerint.h"      // LexerInterface
+#include "useract.h"       // TrivialUserActions
+#include "trace.h"         // TRACE_ARGS
+#include "test.h"          // ARGS_MAIN
+
+#include <stdio.h>         // printf
+#include <stdlib.h>        // atoi, exit
+#include <chrono>          // std::chrono
+#include <vector>          // std::vector
+
+
+typedef std::chrono::steady_clock Clock;
+
+// yields "a" 'length' times, then EOF, and notes the time at which
+// the parser asks for each token, and how many nondeterministic
+// reductions it had done by then
+class WideLexer : public LexerInterface {
+public:
+  int length;
+  int next = 0;
+  GLR const *glr = NULL;
+  std::vector<Clock::time_point> stamps;
+  std::vector<int> reductions;
+
+public:
+  WideLexer(int len) : length(len)
+    { stamps.reserve(len+1); reductions.reserve(len+1); }
+
+  // position at the first token, ready for another parse
+  void rewind();
+
+  static void nextToken(WideLexer *ths);
+
+  // LexerInterface functions
+  virtual NextTokenFunc getTokenFunc() const
+    { return (NextTokenFunc)&WideLexer::nextToken; }
+  virtual string tokenDesc() const
+    { return tokenKindDesc(type); }
+  virtual string tokenKindDesc(int kind) const
+    { return kind? "a" : "EOF"; }
+};
+
+void WideLexer::rewind()
+{
+  next = 0;
+  stamps.clear();
+  reductions.clear();
+  nextToken(this);
+}
+
+/*static*/ void WideLexer::nextToken(WideLexer *ths)
+{
+  ths->stamps.push_back(Clock::now());
+  ths->reductions.push_back(ths->glr->nondetReduce);
+  ths->type = ths->next++ < ths->length? 1 /*a*/ : 0 /*EOF*/;
+  ths->sval = 0;
+}
+
+
+void entry(int argc, char *argv[])
+{
+  char const *progName = argv[0];
+  TRACE_ARGS();
+
+  if (argc < 3) {
+    printf("usage: %s [-tr flags] depth width [tokens [iters]]\n"
+           "  depth, width: as passed to make-wide-grammar\n"
+           "  tokens: input length (default: 4*depth)\n"
+           "  iters: parses to average over (default: 5)\n",
+           progName);
+    exit(2);
+  }
+  int depth = atoi(argv[1]);
+  int width = atoi(argv[2]);
+  int tokens = argc >= 4? atoi(argv[3]) : 4*depth;
+  int iters = argc >= 5? atoi(argv[4]) : 5;
+
+  Wide wide;
+  ParseTables *tables = wide.makeTables();
+  TrivialUserActions triv;
+
+  WideLexer lexer(tokens);
+  std::vector<double> perToken(tokens, 0.0);    // total us, per token
+  std::vector<int> reductions(tokens, 0);       // per token, in one parse
+
+  GLR glr(&triv, tables);
+  lexer.glr = &glr;
+  for (int it=0; it < iters; it++) {
+    lexer.rewind();
+    SemanticValue treeTop;
+    if (!glr.glrParse(lexer, treeTop)) {
+      exit(2);
+    }
+
+    // the parser asks for token k+1 when it is done with token k
+    for (int k=0; k < tokens; k++) {
+      perToken[k] += std::chrono::duration<double, std::micro>
+                       (lexer.stamps[k+1] - lexer.stamps[k]).count();
+      reductions[k] = lexer.reductions[k+1] - lexer.reductions[k];
+    }
+  }
+
+  // after token k (counting from 1), every production 'S -> a^i X_m'
+  // with i <= k is alive, each in its own state; those are the
+  // parsers that do the work of token k+1; each of them reduces
+  // 'X_m -> X_m a', and all those reductions are queued at once
+  printf("%7s %9s %11s %12s\n", "token", "parsers", "reductions", "us/token");
+  double steadySum = 0;
+  long steadyReductions = 0;
+  int steadyCount = 0;
+  for (int k=1; k <= tokens; k++) {
+    double us = perToken[k-1] / iters;
+    if (k <= depth+1) {
+      printf("%7d %9d %11d %12.2f\n", k, k==1? 1 : width * (k-1),
+             reductions[k-1], us);
+    }
+    else {
+      steadySum += us;
+      steadyReductions += reductions[k-1];
+      steadyCount++;
+    }
+  }
+  if (steadyCount) {
+    printf("%7s %9d %11ld %12.2f   (mean of tokens %d..%d)\n",
+           "rest", width * depth, steadyReductions / steadyCount,
+           steadySum / steadyCount, depth+2, tokens);
+  }
+
+  delete tables;
+}
+
+
+ARGS_MAIN
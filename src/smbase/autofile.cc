@@ -3,9 +3,14 @@
 
 #include "autofile.h"     // this module
 #include "exc.h"          // throw_XOpen
+#include "syserr.h"       // xsyserror
 
 #include <errno.h>        // errno
 #include <string.h>       // strerror
+#include <fcntl.h>        // open
+#include <sys/mman.h>     // mmap, munmap
+#include <sys/stat.h>     // fstat
+#include <unistd.h>       // close
 
 
 FILE *xfopen(char const *fname, char const *mode)
@@ -29,6 +34,42 @@ AutoFILE::~AutoFILE()
 }
 
 
+MappedFile::MappedFile(char const *fname)
+  : base(NULL),
+    size(0)
+{
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    throw_XOpenEx(fname, "r", strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    xsyserror("fstat", fname);
+  }
+
+  // mmap won't map nothing
+  if (st.st_size > 0) {
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      xsyserror("mmap", fname);
+    }
+    base = p;
+    size = st.st_size;
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (base) {
+    munmap(base, size);
+  }
+}
+
+
 // -------------------- test code -------------------
 // really this code is to test XOpenEx and strerror
 #ifdef TEST_AUTOFILE
@@ -8,7 +8,7 @@
 #define AUTOFILE_H
 
 #include <stdio.h>      // FILE
-#include "str.h"        // rostring
+#include "str.h"        // rostring, string_view
 
 
 // fopen, but throw an XOpen exception (see exc.h) on failure instead
@@ -48,4 +48,25 @@ public:
 };
 
 
+// a file mapped read-only into memory, for the life of the object
+class MappedFile {
+private:       // data
+  void *base;           // NULL for an empty file
+  size_t size;
+
+private:       // disallowed
+  MappedFile(MappedFile&);
+  void operator=(MappedFile&);
+
+public:
+  // map the file, throwing an XOpen exception if it can't be opened
+  explicit MappedFile(char const *fname);
+  ~MappedFile();
+
+  // the file's contents
+  string_view text() const
+    { return string_view((char const*)base, size); }
+};
+
+
 #endif // AUTOFILE_H
@@ -75,6 +75,32 @@ void Bit2d::setall(int val)
 }
 
 
+bool Bit2d::orRow(int dest, int src)
+{
+  xassert(0 <= dest && dest < size.y && 0 <= src && src < size.y);
+  uint8_t *d = data + dest * stride;
+  uint8_t const *s = data + src * stride;
+
+  // rows needn't be aligned, hence the memcpys, which compile to
+  // plain loads and stores
+  uint64_t changed = 0;
+  int i = 0;
+  for (; i+8 <= stride; i += 8) {
+    uint64_t dw, sw;
+    memcpy(&dw, d+i, 8);
+    memcpy(&sw, s+i, 8);
+    changed |= sw & ~dw;
+    dw |= sw;
+    memcpy(d+i, &dw, 8);
+  }
+  for (; i < stride; i++) {
+    changed |= s[i] & ~d[i];
+    d[i] |= s[i];
+  }
+  return changed != 0;
+}
+
+
 int Bit2d::get(point const &p) const
 {
   xassert(okpt(p));
@@ -196,6 +222,26 @@ int main()
   bits.toggle(point(3,2));
   xassert(bits.get(point(3,2)));
 
+  // rows: 0 has {2}, 1 has {9}, 2 has {3,16}
+  xassert(bits.orRow(1, 0));
+  xassert(bits.get(point(2,1)) && bits.get(point(9,1)));
+  xassert(!bits.orRow(1, 0));
+  xassert(bits.orRow(0, 2));
+  xassert(bits.get(point(16,0)) && !bits.get(point(9,0)));
+
+  // rows longer than a word
+  {
+    Bit2d wide(point(200,2));
+    wide.setall(0);
+    wide.set(point(3,0));
+    wide.set(point(130,0));
+    wide.set(point(199,0));
+    xassert(wide.orRow(1, 0));
+    xassert(wide.get(point(3,1)) && wide.get(point(130,1)) &&
+            wide.get(point(199,1)) && !wide.get(point(4,1)));
+    xassert(!wide.orRow(1, 0));
+  }
+
   bits.print();
 
   // test read/write
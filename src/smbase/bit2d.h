@@ -55,6 +55,10 @@ public:      // funcs
   // set everything
   void setall(int val);
 
+  // or row 'src' into row 'dest' (rows are the 'y' coordinate), eight
+  // bytes at a time; returns true if 'dest' changed
+  bool orRow(int dest, int src);
+
   // debugging
   void print() const;
 
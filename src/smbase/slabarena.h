@@ -0,0 +1,175 @@
+// slabarena.h            see license.txt for copyright and terms of use
+// custom allocator: objects are carved in order out of fixed-size
+// slabs, and a slab is taken back as a whole once all of its
+// objects have died
+
+// This suits objects that tend to die in roughly the order they
+// were made, such as the sibling links of a GLR parse stack, which
+// belong to one token frontier after another.  Allocation is a
+// pointer bump; freeing an object only decrements its slab's live
+// count, and when that reaches zero the slab goes back on the free
+// list in one step.  Individual objects are never recycled, so a
+// single long-lived object keeps its whole slab alive.
+
+#ifndef SLABARENA_H
+#define SLABARENA_H
+
+#include <cassert>    // assert (instead of xassert that throws)
+#include <cstddef>    // offsetof
+#include <new>        // placement new
+#include <utility>    // std::forward
+#include <vector>     // std::vector
+
+template <class T>
+class SlabArena {
+private:     // types
+  struct Slab;
+
+  // one object, plus the slab it came from
+  struct Block {
+    Slab *slab;
+    alignas(T) unsigned char value[sizeof(T)];
+  };
+
+  struct Slab {
+    Block *blocks;              // (owner) array of 'slabSize' blocks
+    int live = 0;               // # of blocks allocated and not yet freed
+    Slab *nextFree = nullptr;   // link in 'freeSlabs'
+  };
+
+private:     // data
+  // every slab ever obtained, whether in use or free
+  std::vector<Slab *> slabs;
+
+  // slabs whose objects have all been freed; NULL when empty
+  Slab *freeSlabs = nullptr;
+
+  // slab being carved up, and how many of its blocks have been
+  // handed out so far
+  Slab *current = nullptr;
+  int currentUsed = 0;
+
+  // # of objects per slab
+  int const slabSize;
+
+  // # of objects allocated and not yet freed
+  int numLive = 0;
+
+  // # of times a whole slab has been returned to the free list
+  long numReclaimed = 0;
+
+private:     // funcs
+  void nextSlab();
+  static Block *blockOf(T *obj)
+    { return reinterpret_cast<Block*>(reinterpret_cast<unsigned char*>(obj)
+                                      - offsetof(Block, value)); }
+
+public:      // funcs
+  explicit SlabArena(int slabSize);
+  ~SlabArena();
+
+  SlabArena(SlabArena const &) = delete;
+  SlabArena &operator=(SlabArena const &) = delete;
+
+  // construct a new object from 'args'; this might obtain another
+  // slab (but previously allocated objects do *not* move)
+  template <class... Args>
+  inline T *alloc(Args&&... args);
+
+  // destroy an object made by 'alloc'
+  inline void dealloc(T *obj);
+
+  // available for diagnostic purposes
+  int numSlabs() const { return slabs.size(); }
+  int size() const { return numLive; }
+  long reclaimedSlabs() const { return numReclaimed; }
+};
+
+
+template <class T>
+SlabArena<T>::SlabArena(int ss)
+  : slabSize(ss)
+{
+  assert(slabSize > 0);
+}
+
+template <class T>
+SlabArena<T>::~SlabArena()
+{
+  // like ObjectPool, objects still alive at this point are not
+  // destroyed, just deallocated
+  for (Slab *slab : slabs) {
+    delete[] slab->blocks;
+    delete slab;
+  }
+}
+
+
+template <class T>
+template <class... Args>
+inline T *SlabArena<T>::alloc(Args&&... args)
+{
+  if (!current || currentUsed == slabSize) {
+    nextSlab();
+  }
+
+  Block *blk = &current->blocks[currentUsed++];
+  blk->slab = current;
+  current->live++;
+  numLive++;
+
+  return new (blk->value) T(std::forward<Args>(args)...);
+}
+
+
+// pulled out of 'alloc' so alloc can be inlined
+template <class T>
+void SlabArena<T>::nextSlab()
+{
+  if (current && current->live == 0) {
+    // everything in the full slab is already dead, so just
+    // start over at its beginning
+    currentUsed = 0;
+    return;
+  }
+
+  // the full slab (if any) is left to its live objects; the last
+  // one to go will put it on the free list
+  if (freeSlabs) {
+    current = freeSlabs;
+    freeSlabs = freeSlabs->nextFree;
+  }
+  else {
+    current = new Slab;
+    current->blocks = new Block[slabSize];
+    slabs.push_back(current);
+  }
+  current->nextFree = nullptr;
+  currentUsed = 0;
+}
+
+
+template <class T>
+inline void SlabArena<T>::dealloc(T *obj)
+{
+  Slab *slab = blockOf(obj)->slab;
+  assert(slab->live > 0);
+
+  obj->~T();
+  numLive--;
+
+  if (--slab->live == 0) {
+    if (slab == current) {
+      // nothing in it is alive; rewind the bump pointer
+      currentUsed = 0;
+    }
+    else {
+      slab->nextFree = freeSlabs;
+      freeSlabs = slab;
+      numReclaimed++;
+    }
+  }
+}
+
+
+#endif // SLABARENA_H
@@ -6,8 +6,13 @@
 #include "syserr.h"     // xsyserror
 #include "trace.h"      // traceProgress
 #include "hashline.h"   // HashLineMap
+#include "macros.h"     // STATICDEF
 
 #include <fmt/core.h>   // fmt::
+#include <algorithm>    // std::upper_bound
+#include <limits.h>     // INT_MAX
+#include <string.h>     // memchr
+#include <sys/stat.h>   // stat
 
 
 // this parameter controls the frequency of Markers in
@@ -30,14 +35,143 @@ void addLineLength(std::vector<unsigned char> &lengths, int len)
 }
 
 
-SourceLocManager::File::File(char const *n, SourceLoc aStartLoc)
+SourceLocManager::LineScanner::LineScanner(File *f)
+  : file(f),
+    lineLengths(),
+    index(),
+    indexDelay(MARKER_PERIOD),
+    charOffset(0),
+    lineNum(1),
+    lineLen(0)
+{
+  // put a marker at the start for uniformity
+  index.push_back(Marker(0, 1, 0));
+}
+
+
+void SourceLocManager::LineScanner::scan(char const *buf, int len)
+{
+  // the code that follows can be seen as abstracting the data
+  // contained in buf[start] through buf[end-1] and adding that
+  // information to the summary variables
+  char const *start = buf;      // beginning of unaccounted-for chars
+  char const *p = buf;          // scan pointer
+  char const *end = buf+len;    // end of unaccounted-for chars
+
+  // loop over the lines in 'buf'
+  while (start < end) {
+    // scan to the next newline
+    p = (char const*)memchr(p, '\n', end-p);
+    if (!p) {
+      p = end;
+      break;
+    }
+    xassert(*p == '\n');
+
+    // account for [start,p)
+    charOffset += p-start;
+    lineLen += p-start;
+    start = p;
+
+    // account for the newline at '*p'
+    addLineLength(lineLengths, lineLen);
+    charOffset++;
+    lineNum++;
+    lineLen = 0;
+
+    p++;
+    start++;
+
+    if (--indexDelay == 0) {
+      // insert a marker to remember this location
+      index.push_back(Marker(charOffset, lineNum, lineLengths.size()));
+      indexDelay = MARKER_PERIOD;
+    }
+  }
+
+  // move [start,p) into 'lineLen'
+  charOffset += p-start;
+  lineLen += p-start;
+  start = p;
+  xassert(start == end);
+}
+
+
+void SourceLocManager::LineScanner::end()
+{
+  // handle the last line; in the usual case, where a newline is
+  // the last character, the final line will have 0 length, but
+  // we encode that anyway since it helps the decode phase below;
+  // 'scan' has already counted its chars in 'charOffset'
+  addLineLength(lineLengths, lineLen);
+}
+
+
+void SourceLocManager::LineScanner::finish()
+{
+  end();
+
+  std::lock_guard<std::mutex> lock(file->mutex);
+  file->takeIndex(*this);
+}
+
+
+void SourceLocManager::File::takeIndex(LineScanner &scanner)
+{
+  if (indexed ||
+      (numChars >= 0 && numChars != scanner.charOffset)) {
+    return;
+  }
+
+  // move computed information into 'this'; the size only changes
+  // while the constructor reads a file the file system can't size,
+  // since other threads read it without holding 'mutex'
+  if (numChars < 0) {
+    numChars = scanner.charOffset;
+  }
+  numLines = scanner.lineNum-1;
+  if (numLines == 0) {
+    // a file with no newlines
+    avgCharsPerLine = numChars;
+  }
+  else {
+    avgCharsPerLine = numChars / numLines;
+  }
+
+  lineLengths = std::move(scanner.lineLengths);
+  index = std::move(scanner.index);
+  indexed = true;
+}
+
+
+SourceLocManager::File::File(char const *n)
   : name(n),
-    startLoc(aStartLoc),     // assigned by SourceLocManager
+    startLoc(SL_UNKNOWN),    // assigned by SourceLocManager
+    numChars(-1),            // not known yet
     hashLines(NULL),
+    indexed(false),
+    numLines(0),
+    avgCharsPerLine(0),
 
     // valid marker/col for the first char in the file
     marker(0, 1, 0),
     markerCol(1)
+{
+  // the size is all that's needed to encode locations in the file,
+  // and that the file system can usually say without reading it
+  struct stat st;
+  if (stat(name.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+      st.st_size <= INT_MAX) {
+    numChars = (int)st.st_size;
+  }
+  else {
+    // read it now, which also reports a file that can't be opened
+    readIndex();
+  }
+}
+
+
+void SourceLocManager::File::readIndex()
 {
   // open in binary mode since it's too unpredictable whether
   // the lower level (e.g. cygwin) will do CRLF translation,
@@ -50,25 +184,8 @@ SourceLocManager::File::File(char const *n, SourceLoc aStartLoc)
   // system it can be commented-out)
   setbuf(fp, NULL);
 
-  // These are growable versions of the indexes.  They will be
-  // discarded after the file has been read.  They keep track of their
-  // own 'next index' values.  I chose to use a growable array instead
-  // of making two passes over the file to reduce i/o.
-  std::vector<unsigned char> lineLengths;
-  std::vector<Marker> index;
-
-  // put a marker at the start for uniformity
-  index.push_back(Marker(0, 1, 0));
-
-  // how many lines to go before I insert the next marker
-  int indexDelay = MARKER_PERIOD;
-
-  // where I am in the file
-  int charOffset = 0;
-  int lineNum = 1;
-  int lineLen = 0;       // length of current line, so far
-
   // read the file, computing information about line lengths
+  LineScanner scanner(this);
   enum { BUFLEN=8192 };
   char buf[BUFLEN];
   for (;;) {
@@ -80,73 +197,18 @@ SourceLocManager::File::File(char const *n, SourceLoc aStartLoc)
     if (len==0) {
       break;
     }
-
-    // the code that follows can be seen as abstracting the data
-    // contained in buf[start] through buf[end-1] and adding that
-    // information to the summary variables above
-    char const *start = buf;      // beginning of unaccounted-for chars
-    char const *p = buf;          // scan pointer
-    char const *end = buf+len;    // end of unaccounted-for chars
-
-    // loop over the lines in 'buf'
-    while (start < end) {
-      // scan to the next newline
-      while (p<end && *p!='\n') {
-        p++;
-      }
-      if (p==end) {
-        break;
-      }
-      xassert(*p == '\n');
-
-      // account for [start,p)
-      charOffset += p-start;
-      lineLen += p-start;
-      start = p;
-
-      // account for the newline at '*p'
-      addLineLength(lineLengths, lineLen);
-      charOffset++;
-      lineNum++;
-      lineLen = 0;
-
-      p++;
-      start++;
-
-      if (--indexDelay == 0) {
-        // insert a marker to remember this location
-        index.push_back(Marker(charOffset, lineNum, lineLengths.size()));
-        indexDelay = MARKER_PERIOD;
-      }
-    }
-
-    // move [start,p) into 'lineLen'
-    charOffset += p-start;
-    lineLen += p-start;
-    start = p;
-    xassert(start == end);
+    scanner.scan(buf, len);
   }
-
-  // handle the last line; in the usual case, where a newline is
-  // the last character, the final line will have 0 length, but
-  // we encode that anyway since it helps the decode phase below
-  addLineLength(lineLengths, lineLen);
-  charOffset += lineLen;
-
-  // move computed information into 'this'
-  this->numChars = charOffset;
-  this->numLines = lineNum-1;
-  if (numLines == 0) {
-    // a file with no newlines
-    this->avgCharsPerLine = numChars;
-  }
-  else {
-    this->avgCharsPerLine = numChars / numLines;
+  scanner.end();
+  takeIndex(scanner);
+
+  if (!indexed) {
+    // the locations already handed out were computed from a size
+    // the file no longer has
+    xformat(fmt::format("{}: file changed size while its source "
+                        "locations were in use", name));
   }
 
-  this->lineLengths = std::move(lineLengths);
-  this->index = std::move(index);
-
   // 'fp' closed by the AutoFILE
 }
 
@@ -187,14 +249,28 @@ inline void SourceLocManager::File::advanceMarker()
 }
 
 
+int SourceLocManager::File::getNumLines()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ensureIndex();
+  return numLines;
+}
+
+
 int SourceLocManager::File::lineToChar(int lineNum)
 {
-  if (lineNum == numLines+1) {
-    // end of file location
-    return numChars;
-  }
+  std::lock_guard<std::mutex> lock(mutex);
+  return innerLineToChar(lineNum);
+}
+
+
+int SourceLocManager::File::innerLineToChar(int lineNum)
+{
+  ensureIndex();
 
-  xassert(1 <= lineNum && lineNum <= numLines);
+  // numLines+1 is the line after the last newline, which is empty
+  // unless the file doesn't end with one
+  xassert(1 <= lineNum && lineNum <= numLines+1);
 
   // check to see if the marker is already close
   if (marker.lineOffset <= lineNum &&
@@ -242,8 +318,10 @@ int SourceLocManager::File::lineToChar(int lineNum)
 
 int SourceLocManager::File::lineColToChar(int lineNum, int col)
 {
+  std::lock_guard<std::mutex> lock(mutex);
+
   // use the above function first
-  int offset = lineToChar(lineNum);
+  int offset = innerLineToChar(lineNum);
 
   // now, we use an property established by the previous function:
   // the marker points at the line of interest, possibly offset from
@@ -294,14 +372,11 @@ int SourceLocManager::File::lineColToChar(int lineNum, int col)
 
 void SourceLocManager::File::charToLineCol(int offset, int &line, int &col)
 {
-  if (offset == numChars) {
-    // end of file location
-    line = numLines+1;
-    col = 1;
-    return;
-  }
+  std::lock_guard<std::mutex> lock(mutex);
+  ensureIndex();
 
-  xassert(0 <= offset && offset < numChars);
+  // the end of file location is on the last line like any other
+  xassert(0 <= offset && offset <= numChars);
 
   // check if the marker is close enough
   if (marker.charOffset <= offset &&
@@ -367,16 +442,20 @@ void SourceLocManager::File::doneAdding()
 
 
 // ----------------------- SourceLocManager -------------------
-int SourceLocManager::shortLineCount = 0;
+std::atomic<int> SourceLocManager::shortLineCount(0);
+thread_local SourceLocManager::File *SourceLocManager::recent = NULL;
 
 SourceLocManager::SourceLocManager()
-  : files(),
-    recent(NULL),
+  : filesMutex(),
+    files(),
+    fileNames(),
+    staticsMutex(),
     statics(),
-    nextLoc(toLoc(1)),
+    nextLoc(1),
     nextStaticLoc(toLoc(0)),
     maxStaticLocs(100),
-    useHashLines(true)
+    useHashLines(true),
+    acceptLineScans(true)
 {
   // slightly clever: treat SL_UNKNOWN as a static
   SourceLoc u = encodeStatic(StaticLoc("<noloc>", 0,1,1));
@@ -394,6 +473,14 @@ SourceLocManager::~SourceLocManager()
 }
 
 
+// comparison for searching 'files' by location
+STATICDEF bool SourceLocManager::startsAfter(SourceLoc loc,
+                                             std::unique_ptr<File> const &file)
+{
+  return loc < file->startLoc;
+}
+
+
 // find it, or return NULL
 SourceLocManager::File *SourceLocManager::findFile(char const *name)
 {
@@ -401,10 +488,10 @@ SourceLocManager::File *SourceLocManager::findFile(char const *name)
     return recent;
   }
 
-  for (auto& file : files) {
-    if (file.name == name) {
-      return (recent = &file);
-    }
+  std::shared_lock<std::shared_mutex> lock(filesMutex);
+  auto it = fileNames.find(name);
+  if (it != fileNames.end()) {
+    return (recent = it->second);
   }
 
   return NULL;
@@ -414,16 +501,30 @@ SourceLocManager::File *SourceLocManager::findFile(char const *name)
 SourceLocManager::File *SourceLocManager::getFile(char const *name)
 {
   File *f = findFile(name);
-  if (!f) {
-    // read the file
-    files.emplace_back(name, nextLoc);
-    f = &files.back();
+  if (f) {
+    return f;
+  }
 
-    // bump 'nextLoc' according to how long that file was,
-    // plus 1 so it can own the position equal to its length
-    nextLoc = toLoc(f->startLoc + f->numChars + 1);
+  // find the size, without holding any lock, then reserve a range
+  // of locations that long, plus 1 so it can own the position equal
+  // to its length
+  std::unique_ptr<File> made(new File(name));
+  made->startLoc = toLoc(nextLoc.fetch_add(made->numChars + 1));
+
+  std::unique_lock<std::shared_mutex> lock(filesMutex);
+  auto it = fileNames.find(name);
+  if (it != fileNames.end()) {
+    // another thread added it meanwhile; 'made' and its range of
+    // locations go unused
+    return (recent = it->second);
   }
 
+  // ranges are reserved in order, but not necessarily added in order
+  auto pos = std::upper_bound(files.begin(), files.end(), made->startLoc,
+                              startsAfter);
+  f = files.insert(pos, std::move(made))->get();
+  fileNames.emplace(f->name, f);
+
   return recent = f;
 }
 
@@ -458,8 +559,25 @@ SourceLoc SourceLocManager::encodeLineCol(
 }
 
 
+std::unique_ptr<SourceLocManager::LineScanner>
+  SourceLocManager::scanLines(SourceLoc loc)
+{
+  if (!acceptLineScans || isStatic(loc)) {
+    return nullptr;
+  }
+
+  File *f = findFileWithLoc(loc);
+  if (f->isIndexed()) {
+    return nullptr;
+  }
+  return std::unique_ptr<LineScanner>(new LineScanner(f));
+}
+
+
 SourceLoc SourceLocManager::encodeStatic(StaticLoc const &obj)
 {
+  std::lock_guard<std::mutex> lock(staticsMutex);
+
   if (-toInt(nextStaticLoc) == maxStaticLocs) {
     // Each distinct static location should correspond to a single
     // place in the source code.  If one place in the source is creating
@@ -493,11 +611,11 @@ SourceLocManager::File *SourceLocManager::findFileWithLoc(SourceLoc loc)
     return recent;
   }
 
-  // iterative walk
-  for (auto& file : files) {
-    if (file.hasLoc(loc)) {
-      return (recent = &file);
-    }
+  // binary search for the last file starting at or before 'loc'
+  std::shared_lock<std::shared_mutex> lock(filesMutex);
+  auto it = std::upper_bound(files.begin(), files.end(), loc, startsAfter);
+  if (it != files.begin() && (*--it)->hasLoc(loc)) {
+    return (recent = it->get());
   }
 
   // the user gave me a value that I never made!
@@ -509,6 +627,10 @@ SourceLocManager::File *SourceLocManager::findFileWithLoc(SourceLoc loc)
 SourceLocManager::StaticLoc const *SourceLocManager::getStatic(SourceLoc loc)
 {
   int index = -toInt(loc);
+
+  // the StaticLoc itself doesn't change, and std::deque doesn't move
+  // its elements, so it can be used after the lock is released
+  std::lock_guard<std::mutex> lock(staticsMutex);
   return &statics[index];
 }
 
@@ -659,6 +781,7 @@ void fromXml(SourceLoc &out, string) {
 #include "strtokp.h"     // StrtokParse
 
 #include <stdlib.h>      // rand, exit, system
+#include <algorithm>     // std::min
 
 int longestLen=0;
 
@@ -855,7 +978,7 @@ void testHashMap()
   }
 
   // similar for last few lines
-  for (ppLine = pp->numLines - 4; ppLine <= pp->numLines; ppLine++) {
+  for (ppLine = pp->getNumLines() - 4; ppLine <= pp->getNumLines(); ppLine++) {
     SourceLoc loc =
       SourceLocManager::instance()->encodeLineCol("srcloc.tmp", ppLine, 1);
     std::cout << "ppLine " << ppLine << ": " << toString(loc) << std::endl;
@@ -905,7 +1028,7 @@ void testHashMap2()
   int expanderLine=0;
   buildHashMap(pp, "srcloc.test2.cc", expanderLine);
 
-  for (int ppLine = 1; ppLine <= pp->numLines; ppLine++) {
+  for (int ppLine = 1; ppLine <= pp->getNumLines(); ppLine++) {
     SourceLoc loc =
       SourceLocManager::instance()->encodeLineCol("srcloc.test2.cc",
                                                   ppLine, 1);
@@ -914,6 +1037,77 @@ void testHashMap2()
 }
 
 
+// build a file's index by feeding its text to a LineScanner in small
+// pieces, and check every location decodes the same as counting the
+// newlines directly
+void testScanLines(char const *fname)
+{
+  SourceLocManager *mgr = SourceLocManager::instance();
+  SourceLoc start = mgr->encodeBegin(fname);
+
+  string text;
+  {
+    AutoFILE fp(fname, "rb");
+    char buf[256];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      text.append(buf, len);
+    }
+  }
+
+  std::unique_ptr<SourceLocManager::LineScanner> scanner =
+    mgr->scanLines(start);
+  xassert(scanner);
+  for (size_t i=0; i < text.length(); i += 7) {
+    scanner->scan(text.data() + i, std::min<size_t>(7, text.length() - i));
+  }
+  scanner->finish();
+
+  SourceLocManager::File *f = mgr->getInternalFile(fname);
+  xassert(f->isIndexed());
+  xassert(!mgr->scanLines(start));
+
+  int line = 1, col = 1;
+  for (int i=0; i <= (int)text.length(); i++) {
+    char const *dummy;
+    int L, c;
+    mgr->decodeLineCol(advText(start, NULL, i), dummy, L, c);
+    xassert(L == line && c == col);
+    testRoundTrip(advText(start, NULL, i));
+
+    if (i < (int)text.length() && text[i] == '\n') {
+      line++;
+      col = 1;
+    }
+    else {
+      col++;
+    }
+  }
+  std::cout << "scanned " << fname << ": " << f->getNumLines()
+            << " lines\n";
+}
+
+
+// a scan that stops short of the end isn't taken, and the file is
+// read instead when it's decoded
+void testShortScan(char const *fname)
+{
+  SourceLocManager *mgr = SourceLocManager::instance();
+  SourceLoc start = mgr->encodeBegin(fname);
+
+  std::unique_ptr<SourceLocManager::LineScanner> scanner =
+    mgr->scanLines(start);
+  xassert(scanner);
+  scanner->scan("x\n", 2);
+  scanner->finish();
+
+  SourceLocManager::File *f = mgr->getInternalFile(fname);
+  xassert(!f->isIndexed());
+  xassert(f->getNumLines() > 1);
+  xassert(f->isIndexed());
+}
+
+
 void entry(int argc, char ** /*argv*/)
 {
   xBase::logExceptions = false;
@@ -947,6 +1141,17 @@ void entry(int argc, char ** /*argv*/)
   std::cout << "invalid: " << toString(SL_UNKNOWN) << std::endl;
   std::cout << "here: " << toString(HERE_SOURCELOC) << std::endl;
 
+  // a file that doesn't end with a newline
+  {
+    AutoFILE fp("srcloc.nonl.tmp", "wb");
+    fputs("first line\nsecond line, no newline", fp);
+  }
+  testFile("srcloc.nonl.tmp");
+
+  // the hash map test decodes in these as well
+  testScanLines("srcloc.test.cc");
+  testShortScan("srcloc.test2.cc");
+
   std::cout << std::endl;
   testHashMap();
   testHashMap2();
@@ -11,13 +11,21 @@
 // the data structures include caches to make accesses to nearby
 // locations fast.
 //
-// No attempt is made to fold creation of SourceLocs into other
-// file-processing activities, such as traditional lexical analysis.
-// The complexity of doing that would be substantial, with little gain
-// in efficiency, due to the large buffer caches in modern OSes.  The
-// main drawback is the inability to work with non-seekable inputs
-// (like pipes) because we consume the whole input when its line
-// counts are computed.
+// Several threads can encode and decode at once, e.g. to parse several
+// files concurrently.  Each file reserves its range of locations with
+// an atomic add, the files are found by binary search over their
+// ranges under a reader/writer lock, the cache of the most recent file
+// is per thread, and each file's index and cursor have their own lock.
+// The #line maps (see File::addHashLine) are the exception: they must
+// be complete before other threads decode in their files.
+//
+// Encoding only needs a file's size, which comes from the file
+// system; the line index needed to decode is built when a location in
+// the file is first decoded.  A lexer that is reading the file anyway
+// can hand what it reads to a LineScanner (see 'scanLines'), and then
+// the file is never read for its index at all.  Otherwise it is read
+// again, which is the reason non-seekable inputs (like pipes) can't
+// be worked with: by then the lexer has consumed them.
 
 // This module mostly uses 'char const *' for filenames instead of
 // 'rostring' because performance is important here; the lexer is
@@ -27,13 +35,19 @@
 #ifndef SRCLOC_H
 #define SRCLOC_H
 
-#include "str.h"      // string
-#include "xassert.h"  // xassert
+#include "str.h"          // string
+#include "xassert.h"      // xassert
 
-#include <deque>      // std::deque
-#include <vector>     // std::vector
+#include <atomic>         // std::atomic
+#include <deque>          // std::deque
+#include <functional>     // std::less
+#include <map>            // std::map
+#include <memory>         // std::unique_ptr
+#include <mutex>          // std::mutex
+#include <shared_mutex>   // std::shared_mutex
+#include <vector>         // std::vector
 
-class HashLineMap;    // hashline.h
+class HashLineMap;        // hashline.h
 
 
 // This is a source location.  It's interpreted as an integer
@@ -85,6 +99,49 @@ private:     // types
   };
 
 public:      // types
+  class File;
+
+  // computes a File's line lengths and index from the file's text,
+  // which is passed to 'scan' a piece at a time, starting at the
+  // beginning of the file
+  class LineScanner {
+  private:   // data
+    friend class SourceLocManager::File;
+
+    // the file whose text this is
+    File *file;                        // (serf)
+
+    // growable versions of the File's indexes, moved into it by
+    // 'finish'
+    std::vector<unsigned char> lineLengths;
+    std::vector<Marker> index;
+
+    // how many lines to go before the next marker
+    int indexDelay;
+
+    // where the scan is in the file
+    int charOffset;
+    int lineNum;
+    int lineLen;         // length of current line, so far
+
+  private:   // funcs
+    // account for the last line
+    void end();
+
+  public:    // funcs
+    explicit LineScanner(File *file);
+
+    // account for the next 'len' chars of the file
+    void scan(char const *buf, int len);
+
+    // call at the end of the file; the File takes the index unless
+    // it already has one, or the text scanned doesn't have the size
+    // the file had when it was encoded (e.g. because the caller read
+    // it in text mode and that translated line endings), in which
+    // case the File will still read the file itself
+    void finish();
+  };
+
   // describes a file we know about
   class File {
   public:    // data
@@ -93,12 +150,26 @@ public:      // types
     // see if their names happen to be aliases in the filesystem
     string name;
 
-    // start offset in the SourceLoc space
+    // start offset in the SourceLoc space; assigned by the
+    // SourceLocManager once the size is known
     SourceLoc startLoc;
 
     // number of chars in the file
     int numChars;
 
+    // known #line directives for this file; NULL if none are known
+    HashLineMap *hashLines;          // (nullable owner)
+
+  private:   // data
+    // held while computing the members below and while moving the
+    // marker, since decoding in different threads shares them
+    std::mutex mutex;
+
+    // true once the members below have been computed, either from
+    // a LineScanner or by reading the file; it's only set with
+    // 'mutex' held, but can be read without it
+    std::atomic<bool> indexed;
+
     // number of lines in the file
     int numLines;
 
@@ -107,10 +178,6 @@ public:      // types
     // it's stored instead of computed to save a division)
     int avgCharsPerLine;
 
-    // known #line directives for this file; NULL if none are known
-    HashLineMap *hashLines;          // (nullable owner)
-
-  private:   // data
     // an array of line lengths; to handle lines longer than 255
     // chars, we use runs of '\xFF' chars to (in unary) encode
     // multiples of 254 (one less than 255) chars, plus the final
@@ -128,16 +195,35 @@ public:      // types
     std::vector<Marker> index;
 
   private:   // funcs
+    friend class SourceLocManager::LineScanner;
+
     File(File &) = delete;
     File &operator=(File &) = delete;
+
+    // these need 'mutex' to be held, unless the File isn't shared
+    // yet because it is still being constructed
     void resetMarker();
     void advanceMarker();
+    void readIndex();             // read the file to build the index
+    void ensureIndex()
+      { if (!indexed) { readIndex(); } }
+    void takeIndex(LineScanner &scanner);
+    int innerLineToChar(int lineNum);
 
   public:    // funcs
-    // this builds both the array and the index
-    File(char const *name, SourceLoc startLoc);
+    // this only finds the file's size, unless the file system
+    // doesn't know it, in which case it reads the file and builds
+    // the array and the index
+    explicit File(char const *name);
     ~File();
 
+    // true if the line index has been built
+    bool isIndexed() const
+      { return indexed; }
+
+    // number of lines in the file
+    int getNumLines();
+
     // line number to character offset
     int lineToChar(int lineNum);
 
@@ -174,25 +260,38 @@ public:      // types
   };
 
 private:     // data
-  // list of files; it would be possible to use a data structure
-  // that is faster to search, but the cache ought to exploit
-  // query locality to the extent that it doesn't matter
-  std::deque<File> files;
+  // held shared while looking up 'files' and 'fileNames', and
+  // exclusively while adding to them
+  std::shared_mutex filesMutex;
+
+  // the files, in order of their 'startLoc', so the one containing a
+  // location can be found by binary search
+  std::vector<std::unique_ptr<File>> files;
+
+  // the same files, by name
+  std::map<string, File*, std::less<>> fileNames;       // (serfs)
 
-  // most-recently accessed File; this is a cache
-  File *recent;                      // (serf)
+  // most-recently accessed File in this thread; this is a cache
+  static thread_local File *recent;                      // (serf)
+
+  // held while using 'statics' and 'nextStaticLoc'
+  std::mutex staticsMutex;
 
   // list of StaticLocs; any SourceLoc less than 0 is interpreted
   // as an index into this list
   std::deque<StaticLoc> statics;
 
-  // next source location to assign
-  SourceLoc nextLoc;
+  // next source location to assign; a new file reserves its range of
+  // locations by advancing this, without taking 'filesMutex'
+  std::atomic<int> nextLoc;
 
   // next static (negative) location
   SourceLoc nextStaticLoc;
 
 public:      // data
+  // these settings are read without locking, so they should be set
+  // before other threads use the manager
+
   // number of static locations at which we print a warning message;
   // defaults to 100
   int maxStaticLocs;
@@ -202,12 +301,18 @@ public:      // data
   // not necessarily inverses of each other
   bool useHashLines;
 
+  // when true, 'scanLines' hands out LineScanners, so a lexer that
+  // offers to build a file's index as it reads the file does; when
+  // false, files are always read again for their indexes; defaults
+  // to true
+  bool acceptLineScans;
+
   // count the # of times we had to truncate a char offset because
   // the #line map pointed at a line shorter than the column number
   // we expected to use; this is initially 0; calling code can use
   // this to tell if the offset information across a given call or
   // sequence of calls is perfect or truncated
-  static int shortLineCount;
+  static std::atomic<int> shortLineCount;
 
 private:     // funcs
   // let File know about these functions
@@ -224,6 +329,7 @@ private:     // funcs
   }
   static int toInt(SourceLoc loc) { return (int)loc; }
 
+  static bool startsAfter(SourceLoc loc, std::unique_ptr<File> const &file);
   File *findFile(char const *name);
   File *getFile(char const *name);
 
@@ -282,6 +388,11 @@ public:
   int getLine(SourceLoc loc);
   int getCol(SourceLoc loc);
 
+  // for the file containing 'loc', which the caller is about to read
+  // from its beginning, a LineScanner to pass what it reads to, or
+  // NULL if the file's index has already been built
+  std::unique_ptr<LineScanner> scanLines(SourceLoc loc);
+
   // get access to the File itself, for adding #line directives
   File *getInternalFile(char const *fname)
     { return getFile(fname); }
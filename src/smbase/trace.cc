@@ -15,9 +15,10 @@
 // list of active tracers, initially empty
 std::unordered_set<string> tracers;
 
-// stream connected to /dev/null
-std::ofstream devNullObj("/dev/null");
-static std::ostream *devNull = &devNullObj;
+// stream connected to /dev/null; one per thread, since writing to
+// a shared stream (even one that discards everything) is a data race
+// when several parsers trace concurrently
+static thread_local std::ofstream devNull("/dev/null");
 
 
 void traceAddSys(char const *sysName)
@@ -56,7 +57,7 @@ std::ostream &trace(char const *sysName)
     return std::cout;
   }
   else {
-    return *devNull;
+    return devNull;
   }
 }
 
@@ -76,7 +77,7 @@ std::ostream &traceProgress(int level)
     return trace("progress") << (getMilliseconds() - progStart) << "ms: ";
   }
   else {
-    return *devNull;
+    return devNull;
   }
 }
 
@@ -0,0 +1,98 @@
+// tslabarena.cc            see license.txt for copyright and terms of use
+// test SlabArena
+
+#include "slabarena.h"   // SlabArena
+#include "xassert.h"     // xassert
+
+#include <stdlib.h>      // rand
+#include <iostream>      // std::cout
+
+
+// class we're going to allocate; it counts its live instances so we
+// can check that the arena runs the ctors and dtors
+class Foo {
+public:
+  static int numLive;
+  int x, y, z;
+
+public:
+  Foo(int index) : x(index), y(index+1), z(index+2) { numLive++; }
+  ~Foo() { numLive--; }
+  void checkInvariant(int index) const;
+};
+
+int Foo::numLive = 0;
+
+void Foo::checkInvariant(int index) const
+{
+  xassert(x == index);
+  xassert(y == x+1);
+  xassert(z == y+1);
+}
+
+
+enum { SLAB=30, BIG=100, ITERS=10000, WINDOW=20 };
+
+int main()
+{
+  SlabArena<Foo> arena(SLAB);
+
+  int i;
+  Foo **allocated = new Foo*[BIG];
+  for (i=0; i<BIG; i++) {
+    allocated[i] = NULL;
+  }
+
+  // random allocation and deallocation
+  std::cout << "allocating/deallocating " << ITERS << " times..\n";
+  for (i=0; i<ITERS; i++) {
+    int index = rand()%BIG;
+    Foo *&f = allocated[index];
+
+    if (f) {
+      f->checkInvariant(index);
+      arena.dealloc(f);
+      f = NULL;
+    }
+    else {
+      f = arena.alloc(index);
+    }
+    xassert(arena.size() == Foo::numLive);
+  }
+
+  std::cout << "freeing remaining " << arena.size() << " stragglers\n";
+  for (i=0; i<BIG; i++) {
+    if (allocated[i]) {
+      allocated[i]->checkInvariant(i);
+      arena.dealloc(allocated[i]);
+      allocated[i] = NULL;
+    }
+  }
+  xassert(arena.size() == 0);
+  xassert(Foo::numLive == 0);
+
+  // objects that die in the order they were made (here, in a sliding
+  // window) should be served by a couple of slabs, reclaimed whole
+  int slabsBefore = arena.numSlabs();
+  long reclaimedBefore = arena.reclaimedSlabs();
+  for (i=0; i<ITERS; i++) {
+    Foo *&f = allocated[i % WINDOW];
+    if (f) {
+      arena.dealloc(f);
+    }
+    f = arena.alloc(i % WINDOW);
+  }
+  for (i=0; i<WINDOW; i++) {
+    arena.dealloc(allocated[i]);
+  }
+  xassert(arena.size() == 0);
+  xassert(arena.numSlabs() - slabsBefore <= 2);
+  xassert(arena.reclaimedSlabs() - reclaimedBefore >= ITERS/SLAB - 2);
+
+  std::cout << "slabs at end: " << arena.numSlabs()
+            << ", reclaimed: " << arena.reclaimedSlabs() << std::endl;
+  std::cout << "tslabarena works!\n";
+
+  delete[] allocated;
+  return 0;
+}
@@ -0,0 +1,228 @@
+// tsrcloc.cc            see license.txt for copyright and terms of use
+// test SourceLocManager from several threads at once: encode and
+// decode in a set of generated files concurrently, checking every
+// result, then time encoding and decoding with growing numbers of
+// threads; exits nonzero if any location decodes wrong
+
+#include "srcloc.h"        // SourceLocManager
+#include "autofile.h"      // AutoFILE
+#include "test.h"          // ARGS_MAIN
+
+#include <fmt/core.h>      // fmt::format
+#include <stdio.h>         // printf, fwrite, remove
+#include <stdlib.h>        // atoi, exit
+#include <algorithm>       // std::upper_bound, std::min
+#include <atomic>          // std::atomic
+#include <chrono>          // std::chrono
+#include <random>          // std::mt19937
+#include <thread>          // std::thread
+#include <vector>          // std::vector
+
+
+typedef std::chrono::steady_clock Clock;
+
+enum { NUMFILES=16, FILESIZE=200000, NUMSTATICS=5 };
+
+
+// a generated input file, and where its lines start
+struct TestFile {
+  string name;
+  string text;
+  std::vector<int> lineStarts;
+
+  TestFile(int n, unsigned seed);
+
+  // where 'offset' should decode to
+  void expect(int offset, int &line, int &col) const;
+};
+
+TestFile::TestFile(int n, unsigned seed)
+  : name(fmt::format("tsrcloc.{}.tmp", n)),
+    text(),
+    lineStarts()
+{
+  // lines of up to 600 chars, so some are longer than the 254-char
+  // pieces the line lengths are kept in; the last file doesn't end
+  // with a newline
+  std::mt19937 rng(seed);
+  while ((int)text.length() < FILESIZE) {
+    text.append(rng() % 600, 'x');
+    text += '\n';
+  }
+  if (n == NUMFILES-1) {
+    text += "no newline";
+  }
+
+  lineStarts.push_back(0);
+  for (int i=0; i < (int)text.length(); i++) {
+    if (text[i] == '\n') {
+      lineStarts.push_back(i+1);
+    }
+  }
+
+  AutoFILE fp(name, "wb");
+  fwrite(text.data(), 1, text.length(), fp);
+}
+
+void TestFile::expect(int offset, int &line, int &col) const
+{
+  line = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset)
+         - lineStarts.begin();
+  col = offset - lineStarts[line-1] + 1;
+}
+
+
+std::vector<TestFile*> files;
+std::atomic<int> failures(0);
+
+void fail(string const &msg)
+{
+  if (failures++ == 0) {
+    printf("%s\n", msg.c_str());
+  }
+}
+
+
+// encode, decode and re-encode 'iters' random locations, in runs in
+// the same file like a compiler's error reports; some threads first
+// feed a file's text to a LineScanner, racing the others that decode
+// in it; each thread also makes and checks a few static locations
+void stressThread(int id, int iters)
+{
+  SourceLocManager *mgr = SourceLocManager::instance();
+  std::mt19937 rng(id);
+
+  if (id % 2 == 0) {
+    TestFile const *f = files[id % NUMFILES];
+    std::unique_ptr<SourceLocManager::LineScanner> scanner =
+      mgr->scanLines(mgr->encodeBegin(f->name.c_str()));
+    if (scanner) {
+      for (size_t i=0; i < f->text.length(); i += 4096) {
+        scanner->scan(f->text.data() + i,
+                      (int)std::min<size_t>(4096, f->text.length() - i));
+      }
+      scanner->finish();
+    }
+  }
+
+  SourceLoc statics[NUMSTATICS];
+  for (int i=0; i < NUMSTATICS; i++) {
+    statics[i] = mgr->encodeStatic("static", id, i+1, 1);
+  }
+
+  TestFile const *f = NULL;
+  for (int i=0; i < iters; i++) {
+    if (i % 16 == 0) {
+      f = files[rng() % NUMFILES];
+    }
+    int offset = rng() % (f->text.length() + 1);
+
+    SourceLoc loc = mgr->encodeOffset(f->name.c_str(), offset);
+    char const *name;
+    int line, col, expLine, expCol;
+    mgr->decodeLineCol(loc, name, line, col);
+    f->expect(offset, expLine, expCol);
+    if (f->name != name || line != expLine || col != expCol) {
+      fail(fmt::format("{} offset {}: expected {}:{}, but got {}:{}:{}",
+                       f->name, offset, expLine, expCol, name, line, col));
+    }
+    if (mgr->encodeLineCol(f->name.c_str(), line, col) != loc) {
+      fail(fmt::format("{} offset {}: {}:{} encodes differently",
+                       f->name, offset, line, col));
+    }
+  }
+
+  for (int i=0; i < NUMSTATICS; i++) {
+    char const *name;
+    int offset;
+    mgr->decodeOffset(statics[i], name, offset);
+    if (offset != id || mgr->getLine(statics[i]) != i+1) {
+      fail(fmt::format("static {} of thread {} decodes wrong", i, id));
+    }
+  }
+}
+
+
+// run 'body(id)' on 'threads' threads, and return the seconds taken
+template <class BODY>
+double runThreads(int threads, BODY body)
+{
+  Clock::time_point start = Clock::now();
+  std::vector<std::thread> running;
+  for (int t=0; t < threads; t++) {
+    running.emplace_back(body, t);
+  }
+  for (std::thread &t : running) {
+    t.join();
+  }
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+void entry(int argc, char *argv[])
+{
+  int maxThreads = argc >= 2? atoi(argv[1]) : 8;
+  int iters = argc >= 3? atoi(argv[2]) : 100000;
+  if (maxThreads < 1 || iters < 1) {
+    printf("usage: %s [threads [iters]]\n", argv[0]);
+    exit(2);
+  }
+
+  for (int n=0; n < NUMFILES; n++) {
+    files.push_back(new TestFile(n, n+1));
+  }
+
+  SourceLocManager *mgr = SourceLocManager::instance();
+  mgr->maxStaticLocs = maxThreads * NUMSTATICS + 10;
+
+  // every thread starts by adding files, so they race to do that too
+  runThreads(maxThreads, [&](int id) { stressThread(id, iters); });
+  if (failures > 0) {
+    printf("%d failure(s)\n", (int)failures);
+    exit(2);
+  }
+  printf("%d threads: %d locations each are ok\n", maxThreads, iters);
+
+  // the same random locations for every thread count, encoded once
+  std::vector<std::vector<SourceLoc>> locs(maxThreads);
+  for (int t=0; t < maxThreads; t++) {
+    std::mt19937 rng(t);
+    TestFile const *f = NULL;
+    for (int i=0; i < iters; i++) {
+      if (i % 16 == 0) {
+        f = files[rng() % NUMFILES];
+      }
+      locs[t].push_back(mgr->encodeOffset(f->name.c_str(),
+                                          rng() % (f->text.length() + 1)));
+    }
+  }
+
+  for (int threads=1; threads <= maxThreads; threads *= 2) {
+    double encodeSecs = runThreads(threads, [&](int id) {
+      std::mt19937 rng(id);
+      for (int i=0; i < iters; i++) {
+        TestFile const *f = files[(i/16 + id) % NUMFILES];
+        mgr->encodeOffset(f->name.c_str(), rng() % (f->text.length() + 1));
+      }
+    });
+    double decodeSecs = runThreads(threads, [&](int id) {
+      char const *name;
+      int line, col;
+      for (SourceLoc loc : locs[id]) {
+        mgr->decodeLineCol(loc, name, line, col);
+      }
+    });
+
+    double ops = (double)threads * iters;
+    printf("%d thread(s): %.0f encodes/s, %.0f decodes/s\n",
+           threads, ops / encodeSecs, ops / decodeSecs);
+  }
+
+  for (TestFile *f : files) {
+    remove(f->name.c_str());
+    delete f;
+  }
+  printf("tsrcloc is ok\n");
+}
+
+ARGS_MAIN